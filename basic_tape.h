@@ -1,36 +1,57 @@
 #ifndef YADRO_TATLIN_TEST_TASK_BASIC_TAPE_H
 #define YADRO_TATLIN_TEST_TASK_BASIC_TAPE_H
 
+#include "tape_element.h"
+
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <optional>
+#include <span>
+
+/**
+ * Direction in which the head of a tape moves.
+ */
+enum class direction {
+    left,
+    right
+};
 
 /**
- * Interface that abstracts a tape.
- * const basic_tape means read-only tape.
+ * Numbers of bytes transferred between a tape and its storage.
+ */
+struct tape_bytes {
+    uint64_t read = 0;
+    uint64_t written = 0;
+};
+
+/**
+ * Interface that abstracts a tape of elements of type T.
+ * const typed_tape means read-only tape.
  * All methods can block.
  * Empty elements are allowed.
  */
-struct basic_tape {
+template <tape_element T>
+struct typed_tape {
     /**
      * Reads current element from the tape.
      * @return current element of the tape
      */
-    virtual int read() const = 0; // NOLINT(*-use-nodiscard)
+    virtual T read() const = 0; // NOLINT(*-use-nodiscard)
 
     /**
      * If current element is empty, the method returns null optional.
-     * Otherwise the method returns the same data as basic_tape::read(),
+     * Otherwise the method returns the same data as typed_tape::read(),
      * but (usually) works slower.
      * @return optionally returns current element of the tape
      */
-    virtual std::optional<int> read_safe() const = 0; // NOLINT(*-use-nodiscard)
+    virtual std::optional<T> read_safe() const = 0; // NOLINT(*-use-nodiscard)
 
     /**
      * Writes `data` to the current position on the tape.
      * @param data data to write
      */
-    virtual void write(int data) = 0;
+    virtual void write(T data) = 0;
 
     /**
      * Moves left reading/writing head of the tape.
@@ -46,10 +67,80 @@ struct basic_tape {
      */
     virtual bool move_right() const = 0; // NOLINT(*-use-nodiscard)
 
+    /**
+     * Moves the head of the tape in the given direction.
+     * @return true the head of the tape was moved, false otherwise
+     */
+    bool move(direction dir) const { // NOLINT(*-use-nodiscard)
+        return dir == direction::left ? move_left() : move_right();
+    }
+
+    /**
+     * Reads consecutive elements starting from the current one.
+     * The head is moved in `dir` direction after each element except the last one,
+     * so it stays on the last read element (as if read() and move() were called in a loop).
+     * @param out where to store elements in order of reading
+     * @param dir direction in which to move the head
+     * @return number of elements read. It is less than out.size() iff the end of the tape was reached
+     */
+    virtual size_t read_n(std::span<T> out, direction dir) const { // NOLINT(*-use-nodiscard)
+        for (size_t i = 0; i < out.size(); ++i) {
+            out[i] = read();
+            if (i + 1 < out.size() && !move(dir)) {
+                return i + 1;
+            }
+        }
+        return out.size();
+    }
+
+    /**
+     * The same as typed_tape::read_n, but empty elements are read as null optionals.
+     * See typed_tape::read_safe.
+     */
+    virtual size_t read_safe_n(std::span<std::optional<T>> out, direction dir) const { // NOLINT(*-use-nodiscard)
+        for (size_t i = 0; i < out.size(); ++i) {
+            out[i] = read_safe();
+            if (i + 1 < out.size() && !move(dir)) {
+                return i + 1;
+            }
+        }
+        return out.size();
+    }
+
+    /**
+     * Writes consecutive elements starting from the current position.
+     * The head is moved in `dir` direction after each element except the last one,
+     * so it stays on the last written element (as if write() and move() were called in a loop).
+     * @param data elements to write in order of writing
+     * @param dir direction in which to move the head
+     * @return number of elements written. It is less than data.size() iff the end of the tape was reached
+     */
+    virtual size_t write_n(std::span<T const> data, direction dir) {
+        for (size_t i = 0; i < data.size(); ++i) {
+            write(data[i]);
+            if (i + 1 < data.size() && !move(dir)) {
+                return i + 1;
+            }
+        }
+        return data.size();
+    }
+
+    /**
+     * Moves the head `n` times in the given direction (or until the end of the tape).
+     * @return number of performed moves
+     */
+    virtual size_t move_n(size_t n, direction dir) const { // NOLINT(*-use-nodiscard)
+        size_t moved = 0;
+        while (moved < n && move(dir)) {
+            moved++;
+        }
+        return moved;
+    }
+
     /**
      * Destroys the tape. Frees resources.
      */
-    virtual ~basic_tape() = default;
+    virtual ~typed_tape() = default;
 
     /**
      * Sets the head of the tape in left-most position.
@@ -57,8 +148,30 @@ struct basic_tape {
     virtual void rewind() const {
         while (move_left());
     }
+
+    /**
+     * Writes all buffered data (if any) to the underlying storage.
+     * Does nothing by default.
+     */
+    virtual void flush() {}
+
+    /**
+     * @return numbers of bytes read from and written to the storage so far, if the tape counts them
+     * (a tape whose elements have no fixed width, see compressed_file_tape). Decorators pass it through.
+     */
+    [[nodiscard]] virtual std::optional<tape_bytes> bytes_transferred() const {
+        return std::nullopt;
+    }
 };
 
-using tape_factory = std::function<std::unique_ptr<basic_tape>(size_t)>;
+/**
+ * Tape of ints, the type of elements used by the program.
+ */
+using basic_tape = typed_tape<int>;
+
+template <tape_element T>
+using typed_tape_factory = std::function<std::unique_ptr<typed_tape<T>>(size_t)>;
+
+using tape_factory = typed_tape_factory<int>;
 
 #endif //YADRO_TATLIN_TEST_TASK_BASIC_TAPE_H
@@ -0,0 +1,297 @@
+#include <benchmark/benchmark.h>
+#include <filesystem>
+#include <random>
+#include <tape_algorithm.h>
+#include <tape_utils.h>
+#include <text_codec.h>
+#include <vector_tape.h>
+
+
+namespace {
+    /**
+     * Kinds of tapes, the first argument of most benchmarks.
+     */
+    enum tape_kind : int64_t {
+        VECTOR, TEXT, BINARY, MMAP, COMPRESSED
+    };
+
+    const std::vector<int64_t> ALL_KINDS = { VECTOR, TEXT, BINARY, MMAP, COMPRESSED };
+    const std::filesystem::path BENCHMARK_DIR = "benchmarks_tmp";
+    const std::string CONFIG_NAME = (BENCHMARK_DIR / "zero_timings.cfg").string();
+
+    std::string kind_name(int64_t kind) {
+        switch (kind) {
+            case VECTOR:
+                return "vector";
+            case TEXT:
+                return "text";
+            case BINARY:
+                return "binary";
+            case MMAP:
+                return "mmap";
+            default:
+                return "compressed";
+        }
+    }
+
+    /**
+     * Creates tapes of the given kind with zero delays. File tapes are stored in BENCHMARK_DIR
+     * under names which are reused after clear(), so the files don't pile up between iterations.
+     */
+    class tape_maker {
+    public:
+        explicit tape_maker(int64_t kind, std::string prefix = "tape") : kind(kind), prefix(std::move(prefix)) {
+            std::filesystem::create_directories(BENCHMARK_DIR);
+        }
+
+        std::unique_ptr<basic_tape> operator()(size_t size) {
+            if (kind == VECTOR) {
+                return std::make_unique<vector_tape>(size);
+            }
+            auto format = kind == TEXT ? tape_format::text : kind == BINARY ? tape_format::binary :
+                          kind == MMAP ? tape_format::mmap : tape_format::compressed;
+            auto path = BENCHMARK_DIR / (prefix + std::to_string(cnt++) + ".dat");
+            std::filesystem::remove(path);
+            return create_file_tape(path.string(), size, CONFIG_NAME, format);
+        }
+
+        tape_factory factory() {
+            return [this](size_t size) { return (*this)(size); };
+        }
+
+        /**
+         * Makes the next tapes reuse the files of the previous ones. The previous tapes must be destroyed.
+         */
+        void clear() {
+            cnt = 0;
+        }
+
+    private:
+        int64_t kind;
+        std::string prefix;
+        size_t cnt = 0;
+    };
+
+    std::vector<int> random_content(size_t size) {
+        std::mt19937 gen(42);
+        std::uniform_int_distribution<> distrib;
+        std::vector<int> content(size);
+        for (int& i : content) {
+            i = distrib(gen);
+        }
+        return content;
+    }
+
+    std::unique_ptr<basic_tape> make_filled_tape(tape_maker& make, size_t size) {
+        auto tape = make(size);
+        tape->write_n(random_content(size), direction::right);
+        tape->rewind();
+        return tape;
+    }
+
+    void set_throughput(benchmark::State& state, size_t elements_per_iteration) {
+        auto n = static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(elements_per_iteration);
+        state.SetItemsProcessed(n);
+        state.SetBytesProcessed(n * static_cast<int64_t>(sizeof(int)));
+        state.SetLabel(kind_name(state.range(0)));
+    }
+
+    // args: kind, count
+    void BM_read(benchmark::State& state) {
+        auto count = static_cast<size_t>(state.range(1));
+        auto make = tape_maker(state.range(0));
+        auto tape = make_filled_tape(make, count);
+        for (auto _ : state) {
+            tape->rewind();
+            for (size_t i = 0; i < count; ++i) {
+                benchmark::DoNotOptimize(tape->read());
+                tape->move_right();
+            }
+        }
+        set_throughput(state, count);
+    }
+
+    // args: kind, count
+    void BM_write(benchmark::State& state) {
+        auto count = static_cast<size_t>(state.range(1));
+        auto make = tape_maker(state.range(0));
+        auto tape = make(count);
+        for (auto _ : state) {
+            tape->rewind();
+            for (size_t i = 0; i < count; ++i) {
+                tape->write(static_cast<int>(i));
+                tape->move_right();
+            }
+        }
+        set_throughput(state, count);
+    }
+
+    // args: kind, count
+    void BM_move(benchmark::State& state) {
+        auto count = static_cast<size_t>(state.range(1));
+        auto make = tape_maker(state.range(0));
+        auto tape = make_filled_tape(make, count);
+        for (auto _ : state) {
+            for (size_t i = 1; i < count; ++i) {
+                tape->move_right();
+            }
+            for (size_t i = 1; i < count; ++i) {
+                tape->move_left();
+            }
+        }
+        set_throughput(state, 2 * (count - 1));
+    }
+
+    // args: kind, count
+    void BM_read_n(benchmark::State& state) {
+        auto count = static_cast<size_t>(state.range(1));
+        auto make = tape_maker(state.range(0));
+        auto tape = make_filled_tape(make, count);
+        auto buf = std::vector<int>(count);
+        for (auto _ : state) {
+            tape->rewind();
+            tape->read_n(buf, direction::right);
+            benchmark::DoNotOptimize(buf.data());
+        }
+        set_throughput(state, count);
+    }
+
+    // args: kind, count
+    void BM_write_n(benchmark::State& state) {
+        auto count = static_cast<size_t>(state.range(1));
+        auto make = tape_maker(state.range(0));
+        auto tape = make(count);
+        auto content = random_content(count);
+        for (auto _ : state) {
+            tape->rewind();
+            tape->write_n(content, direction::right);
+        }
+        set_throughput(state, count);
+    }
+
+    void BM_encode_field(benchmark::State& state) {
+        auto content = random_content(1 << 12);
+        char field[TEXT_FIELD_LEN];
+        for (auto _ : state) {
+            for (int value : content) {
+                encode_field(value, field);
+                benchmark::DoNotOptimize(field);
+            }
+        }
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * content.size()));
+    }
+
+    void BM_decode_field(benchmark::State& state) {
+        auto content = random_content(1 << 12);
+        auto text = std::string(content.size() * TEXT_FIELD_LEN, ' ');
+        for (size_t i = 0; i < content.size(); ++i) {
+            encode_field(content[i], text.data() + i * TEXT_FIELD_LEN);
+        }
+        for (auto _ : state) {
+            for (size_t i = 0; i < content.size(); ++i) {
+                benchmark::DoNotOptimize(decode_field(text.data() + i * TEXT_FIELD_LEN));
+            }
+        }
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * content.size()));
+    }
+
+    // args: kind, runs (see run_generation), count, cutoff
+    void BM_split(benchmark::State& state) {
+        auto count = static_cast<size_t>(state.range(2));
+        auto options = sort_options{ .cutoff = static_cast<size_t>(state.range(3)),
+                                     .runs = static_cast<run_generation>(state.range(1)) };
+        auto make = tape_maker(state.range(0));
+        auto src = make_filled_tape(make, count);
+        auto dst1 = make(count);
+        auto dst2 = make(count);
+        for (auto _ : state) {
+            src->rewind();
+            dst1->rewind();
+            dst2->rewind();
+            benchmark::DoNotOptimize(generate_runs(*src, count, options, { dst1.get(), dst2.get() }));
+        }
+        set_throughput(state, count);
+    }
+
+    // args: kind, k, count; runs of 1024 elements
+    void BM_merge(benchmark::State& state) {
+        auto k = static_cast<size_t>(state.range(1));
+        auto count = static_cast<size_t>(state.range(2));
+        auto make = tape_maker(state.range(0));
+        auto src = make_filled_tape(make, count);
+        auto owner = std::vector<std::unique_ptr<basic_tape>>();
+        auto group1 = std::vector<basic_tape*>();
+        auto group2 = std::vector<basic_tape*>();
+        for (size_t i = 0; i < 2 * k; ++i) {
+            owner.push_back(make(count));
+            (i < k ? group1 : group2).push_back(owner.back().get());
+        }
+        for (auto _ : state) {
+            state.PauseTiming();
+            src->rewind();
+            for (auto& tape : owner) {
+                tape->rewind();
+            }
+            auto runs = generate_runs(*src, count, { .cutoff = 1024 }, group1);
+            state.ResumeTiming();
+            benchmark::DoNotOptimize(merge_pass(runs, group1, group2, true));
+        }
+        set_throughput(state, count);
+    }
+
+    // args: kind, n_tapes, count, cutoff
+    void BM_sort(benchmark::State& state) {
+        auto count = static_cast<size_t>(state.range(2));
+        auto options = sort_options{ .cutoff = static_cast<size_t>(state.range(3)),
+                                     .n_tapes = static_cast<size_t>(state.range(1)) };
+        auto make = tape_maker(state.range(0));
+        auto src = make_filled_tape(make, count);
+        auto dst = make(count);
+        auto temp_make = tape_maker(state.range(0), "temp");
+        auto factory = temp_make.factory();
+        for (auto _ : state) {
+            src->rewind();
+            dst->rewind();
+            temp_make.clear();
+            sort(*src, count, *dst, options, factory);
+        }
+        set_throughput(state, count);
+    }
+
+    // args: kind, count, cutoff
+    void BM_distribution_sort(benchmark::State& state) {
+        auto count = static_cast<size_t>(state.range(1));
+        auto options = sort_options{ .cutoff = static_cast<size_t>(state.range(2)),
+                                     .engine = sort_engine::distribution };
+        auto make = tape_maker(state.range(0));
+        auto src = make_filled_tape(make, count);
+        auto dst = make(count);
+        auto temp_make = tape_maker(state.range(0), "temp");
+        auto factory = temp_make.factory();
+        for (auto _ : state) {
+            src->rewind();
+            dst->rewind();
+            temp_make.clear();
+            sort(*src, count, *dst, options, factory);
+        }
+        set_throughput(state, count);
+    }
+}
+
+BENCHMARK(BM_read)->ArgsProduct({ ALL_KINDS, { 1 << 16 } })->ArgNames({ "kind", "count" });
+BENCHMARK(BM_write)->ArgsProduct({ ALL_KINDS, { 1 << 16 } })->ArgNames({ "kind", "count" });
+BENCHMARK(BM_move)->ArgsProduct({ ALL_KINDS, { 1 << 16 } })->ArgNames({ "kind", "count" });
+BENCHMARK(BM_read_n)->ArgsProduct({ ALL_KINDS, { 1 << 16 } })->ArgNames({ "kind", "count" });
+BENCHMARK(BM_write_n)->ArgsProduct({ ALL_KINDS, { 1 << 16 } })->ArgNames({ "kind", "count" });
+BENCHMARK(BM_encode_field);
+BENCHMARK(BM_decode_field);
+BENCHMARK(BM_split)->ArgsProduct({ ALL_KINDS, { 0, 1, 2 }, { 1 << 17 }, { 1 << 12 } })
+        ->ArgNames({ "kind", "runs", "count", "cutoff" })->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_merge)->ArgsProduct({ ALL_KINDS, { 2, 4 }, { 1 << 17 } })
+        ->ArgNames({ "kind", "k", "count" })->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_sort)->ArgsProduct({ ALL_KINDS, { 4, 8 }, { 1 << 14, 1 << 17 }, { 1 << 8, 1 << 12 } })
+        ->ArgNames({ "kind", "tapes", "count", "cutoff" })->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_distribution_sort)->ArgsProduct({ ALL_KINDS, { 1 << 14, 1 << 17 }, { 1 << 8, 1 << 12 } })
+        ->ArgNames({ "kind", "count", "cutoff" })->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,221 @@
+#include "binary_file_tape.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <vector>
+
+template <tape_element T>
+typed_binary_file_tape<T>::typed_binary_file_tape(std::string const& filename, size_t size)
+        : pos(0), size(size), bitmap_idx(0), bitmap_byte(0), bitmap_dirty(false), io_buf(CHUNK_LEN * ELEM_LEN) {
+    if (size == 0) {
+        throw std::invalid_argument("size of a tape cannot be zero");
+    }
+    if (!std::filesystem::exists(filename)) {
+        std::ofstream created(filename, std::ios::binary);
+        if (!created) {
+            throw std::runtime_error("cannot create file " + filename);
+        }
+    }
+    auto expected_size = size * ELEM_LEN + (size + 7) / 8;
+    auto file_size = std::filesystem::file_size(filename);
+    if (file_size < expected_size) {
+        if (file_size != 0) {
+            throw std::runtime_error("the file must either be empty "
+                                     "or contains valid binary tape of length " + std::to_string(size));
+        }
+        std::filesystem::resize_file(filename, expected_size);
+    }
+    file = std::fstream(filename, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("cannot open file " + filename);
+    }
+    file.exceptions(std::fstream::badbit | std::fstream::failbit);
+    load_bitmap_byte();
+}
+
+template <tape_element T>
+typed_binary_file_tape<T>::typed_binary_file_tape(std::string const& filename, size_t size,
+                                                  std::string const& config_filename)
+        : typed_binary_file_tape(filename, size) {
+    timings = timings_config::load_or_create(config_filename);
+}
+
+template <tape_element T>
+typed_binary_file_tape<T>::~typed_binary_file_tape() {
+    // the file stream throws on errors, and a destructor must not;
+    // callers that care about a failed write flush the tape explicitly
+    try {
+        typed_binary_file_tape::flush();
+    } catch (...) {
+    }
+}
+
+template <tape_element T>
+void typed_binary_file_tape<T>::load_bitmap_byte() const {
+    store_bitmap_byte();
+    bitmap_idx = pos / 8;
+    file.seekg(static_cast<std::streamoff>(size * ELEM_LEN + bitmap_idx));
+    bitmap_byte = static_cast<uint8_t>(file.get());
+}
+
+template <tape_element T>
+void typed_binary_file_tape<T>::store_bitmap_byte() const {
+    if (!bitmap_dirty) {
+        return;
+    }
+    file.seekp(static_cast<std::streamoff>(size * ELEM_LEN + bitmap_idx));
+    file.put(static_cast<char>(bitmap_byte));
+    bitmap_dirty = false;
+}
+
+template <tape_element T>
+T typed_binary_file_tape<T>::read() const {
+    clock.advance(timings.read);
+    char buf[ELEM_LEN];
+    file.seekg(static_cast<std::streamoff>(pos * ELEM_LEN));
+    file.read(buf, ELEM_LEN);
+    return element_traits<T>::decode(buf);
+}
+
+template <tape_element T>
+std::optional<T> typed_binary_file_tape<T>::read_safe() const {
+    if (bitmap_idx != pos / 8) {
+        load_bitmap_byte();
+    }
+    if (!(bitmap_byte & (1u << (pos % 8)))) {
+        clock.advance(timings.read);
+        return {};
+    }
+    return read();
+}
+
+template <tape_element T>
+void typed_binary_file_tape<T>::write(T data) {
+    clock.advance(timings.write);
+    char buf[ELEM_LEN];
+    element_traits<T>::encode(data, buf);
+    file.seekp(static_cast<std::streamoff>(pos * ELEM_LEN));
+    file.write(buf, ELEM_LEN);
+    set_filled();
+}
+
+template <tape_element T>
+void typed_binary_file_tape<T>::set_filled() const {
+    if (bitmap_idx != pos / 8) {
+        load_bitmap_byte();
+    }
+    auto mask = static_cast<uint8_t>(1u << (pos % 8));
+    if (!(bitmap_byte & mask)) {
+        bitmap_byte |= mask;
+        bitmap_dirty = true;
+    }
+}
+
+template <tape_element T>
+bool typed_binary_file_tape<T>::move_left() const {
+    if (pos == 0) {
+        return false;
+    }
+    clock.advance(timings.move_left);
+    pos--;
+    return true;
+}
+
+template <tape_element T>
+bool typed_binary_file_tape<T>::move_right() const {
+    if (pos + 1 == size) {
+        return false;
+    }
+    clock.advance(timings.move_right);
+    pos++;
+    return true;
+}
+
+template <tape_element T>
+void typed_binary_file_tape<T>::rewind() const {
+    clock.advance(timings.rewind);
+    pos = 0;
+}
+
+template <tape_element T>
+void typed_binary_file_tape<T>::flush() {
+    store_bitmap_byte();
+    file.flush();
+}
+
+template <tape_element T>
+size_t typed_binary_file_tape<T>::available(size_t n, direction dir) const {
+    return std::min(n, dir == direction::right ? size - pos : pos + 1);
+}
+
+template <tape_element T>
+size_t typed_binary_file_tape<T>::read_n(std::span<T> out, direction dir) const {
+    auto n = available(out.size(), dir);
+    if (n == 0) {
+        return 0;
+    }
+    auto move_timing = dir == direction::right ? timings.move_right : timings.move_left;
+    clock.advance(timings.read * n + move_timing * (n - 1));
+    for (size_t done = 0; done < n;) {
+        auto m = std::min(CHUNK_LEN, n - done);
+        auto first = dir == direction::right ? pos + done : pos + 1 - done - m;
+        file.seekg(static_cast<std::streamoff>(first * ELEM_LEN));
+        file.read(io_buf.data(), static_cast<std::streamsize>(m * ELEM_LEN));
+        for (size_t i = 0; i < m; ++i) {
+            auto idx = dir == direction::right ? i : m - 1 - i;
+            out[done + i] = element_traits<T>::decode(io_buf.data() + idx * ELEM_LEN);
+        }
+        done += m;
+    }
+    pos = dir == direction::right ? pos + n - 1 : pos + 1 - n;
+    return n;
+}
+
+template <tape_element T>
+size_t typed_binary_file_tape<T>::write_n(std::span<T const> data, direction dir) {
+    auto n = available(data.size(), dir);
+    if (n == 0) {
+        return 0;
+    }
+    auto move_timing = dir == direction::right ? timings.move_right : timings.move_left;
+    clock.advance(timings.write * n + move_timing * (n - 1));
+    auto first = dir == direction::right ? pos : pos + 1 - n;
+    auto last = dir == direction::right ? pos + n - 1 : first;
+    for (size_t done = 0; done < n;) {
+        auto m = std::min(CHUNK_LEN, n - done);
+        auto chunk_first = dir == direction::right ? pos + done : pos + 1 - done - m;
+        for (size_t i = 0; i < m; ++i) {
+            auto idx = dir == direction::right ? i : m - 1 - i;
+            element_traits<T>::encode(data[done + i], io_buf.data() + idx * ELEM_LEN);
+        }
+        file.seekp(static_cast<std::streamoff>(chunk_first * ELEM_LEN));
+        file.write(io_buf.data(), static_cast<std::streamsize>(m * ELEM_LEN));
+        done += m;
+    }
+    for (pos = first; pos < first + n; ++pos) {
+        set_filled();
+    }
+    pos = last;
+    return n;
+}
+
+template <tape_element T>
+size_t typed_binary_file_tape<T>::move_n(size_t n, direction dir) const {
+    auto moved = std::min(n, dir == direction::right ? size - 1 - pos : pos);
+    if (dir == direction::right) {
+        clock.advance(timings.move_right * moved);
+        pos += moved;
+    } else {
+        clock.advance(timings.move_left * moved);
+        pos -= moved;
+    }
+    return moved;
+}
+
+template <tape_element T>
+device_clock::duration typed_binary_file_tape<T>::elapsed_time() const {
+    return clock.elapsed();
+}
+
+#define INSTANTIATE_BINARY_FILE_TAPE(T) template class typed_binary_file_tape<T>;
+FOR_EACH_TAPE_ELEMENT(INSTANTIATE_BINARY_FILE_TAPE)
@@ -0,0 +1,108 @@
+#ifndef YADRO_TATLIN_TEST_TASK_BINARY_FILE_TAPE_H
+#define YADRO_TATLIN_TEST_TASK_BINARY_FILE_TAPE_H
+
+#include "basic_tape.h"
+#include "device_clock.h"
+#include "timings_config.h"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * This class emulates a tape by interacting with a binary file.
+ * The tape is stored elements of type T.
+ * Each element is stored as its element_traits<T>::width bytes in little-endian order
+ * (e.g. an int is stored as 4-byte little-endian two's complement integer).
+ * The elements are followed by a bitmap of filled elements:
+ * i-th bit (starting from the least significant bit of the first byte) is set iff i-th element is not empty.
+ * Therefore, a file consisting of zero bytes represents an empty tape.
+ * A tape of ints of size n occupies 4*n + ceil(n/8) bytes instead of 12*n bytes used by file_tape.
+ * To simulate delays in IO operations, timings from timings_config class are used.
+ */
+template <tape_element T>
+class typed_binary_file_tape : public typed_tape<T> {
+public:
+    /**
+     * Creates typed_binary_file_tape that stores data in the given file. The file must has one of the following states:
+     * 1. it can contains data in valid format (described above);
+     * 2. it can be empty, in that case the file is filled (pre-allocated) with required number of zero bytes;
+     * 3. it can yet not exists, in that case an attempt to create the file is being made, then see case 2.
+     * Default timings are used.
+     * @param filename path to the file where to store data.
+     * @param size number of elements of the tape. Cannot be zero.
+     */
+    typed_binary_file_tape(std::string const& filename, size_t size);
+
+    /**
+     * The same as typed_binary_file_tape::typed_binary_file_tape(std::string const&, size_t),
+     * but attempts to parse timings from `config_filename` path. See timings_config::load_or_create.
+     * @param filename path to the file where to store data.
+     * @param size number of elements of the tape. Cannot be zero.
+     * @param config_filename path to the timings configuration file.
+     */
+    typed_binary_file_tape(std::string const& filename, size_t size, std::string const& config_filename);
+
+    /**
+     * Flushes the tape. I/O errors are ignored here; call flush() beforehand to get them reported.
+     */
+    ~typed_binary_file_tape() override;
+
+    T read() const override;
+    std::optional<T> read_safe() const override;
+
+    void write(T data) override;
+
+    bool move_left() const override;
+    bool move_right() const override;
+
+    void rewind() const override;
+
+    void flush() override;
+
+    /**
+     * @return time spent by this tape on its operations according to the timings config, see device_clock
+     */
+    [[nodiscard]] device_clock::duration elapsed_time() const;
+
+    size_t read_n(std::span<T> out, direction dir) const override;
+    size_t write_n(std::span<T const> data, direction dir) override;
+    size_t move_n(size_t n, direction dir) const override;
+
+private:
+    size_t available(size_t n, direction dir) const;
+    void set_filled() const;
+    void load_bitmap_byte() const;
+    void store_bitmap_byte() const;
+
+    static constexpr size_t ELEM_LEN = element_traits<T>::width;
+    /**
+     * Number of elements encoded or decoded per I/O call by bulk operations.
+     */
+    static constexpr size_t CHUNK_LEN = 512;
+
+    mutable std::fstream file;
+    mutable size_t pos;
+    const size_t size;
+    timings_config timings;
+    mutable device_clock clock;
+
+    // the byte of the bitmap which contains current element's bit is cached,
+    // so sequential writes don't touch the bitmap on every call
+    mutable size_t bitmap_idx;
+    mutable uint8_t bitmap_byte;
+    mutable bool bitmap_dirty;
+
+    // CHUNK_LEN encoded elements, allocated once and reused by all bulk operations
+    mutable std::vector<char> io_buf;
+};
+
+#define YADRO_TATLIN_TEST_TASK_EXTERN_BINARY_FILE_TAPE(T) extern template class typed_binary_file_tape<T>;
+FOR_EACH_TAPE_ELEMENT(YADRO_TATLIN_TEST_TASK_EXTERN_BINARY_FILE_TAPE)
+#undef YADRO_TATLIN_TEST_TASK_EXTERN_BINARY_FILE_TAPE
+
+using binary_file_tape = typed_binary_file_tape<int>;
+
+
+#endif //YADRO_TATLIN_TEST_TASK_BINARY_FILE_TAPE_H
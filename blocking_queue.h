@@ -0,0 +1,82 @@
+#ifndef YADRO_TATLIN_TEST_TASK_BLOCKING_QUEUE_H
+#define YADRO_TATLIN_TEST_TASK_BLOCKING_QUEUE_H
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+/**
+ * Bounded multi-producer multi-consumer queue. push() blocks while the queue is full,
+ * pop() blocks while the queue is empty and not closed.
+ */
+template <typename T>
+class blocking_queue {
+public:
+    /**
+     * @param capacity max number of elements in the queue. Cannot be zero.
+     */
+    explicit blocking_queue(size_t capacity) : capacity(capacity) {}
+
+    /**
+     * Pushes `value` to the queue, blocks while the queue is full.
+     * @return false if the queue is closed (the value is dropped), true otherwise
+     */
+    bool push(T value) {
+        std::unique_lock lock(mutex);
+        not_full.wait(lock, [this] { return closed || items.size() < capacity; });
+        if (closed) {
+            return false;
+        }
+        items.push_back(std::move(value));
+        not_empty.notify_one();
+        return true;
+    }
+
+    /**
+     * Pops the first element of the queue, blocks while the queue is empty and not closed.
+     * @return the element or null optional if the queue is closed and empty
+     */
+    std::optional<T> pop() {
+        std::unique_lock lock(mutex);
+        not_empty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) {
+            return {};
+        }
+        auto res = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return res;
+    }
+
+    /**
+     * Forbids further pushes. Elements which are already in the queue can be popped.
+     */
+    void close() {
+        std::lock_guard lock(mutex);
+        closed = true;
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+
+    /**
+     * Closes the queue and drops its elements, so all blocked calls return immediately.
+     */
+    void cancel() {
+        std::lock_guard lock(mutex);
+        closed = true;
+        items.clear();
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+
+private:
+    const size_t capacity;
+    std::deque<T> items;
+    bool closed = false;
+    std::mutex mutex;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+};
+
+#endif //YADRO_TATLIN_TEST_TASK_BLOCKING_QUEUE_H
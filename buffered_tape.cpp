@@ -0,0 +1,220 @@
+#include "buffered_tape.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+template <tape_element T>
+typed_buffered_tape<T>::typed_buffered_tape(std::unique_ptr<typed_tape<T>> tape, size_t size, size_t block_size,
+                                            std::pmr::memory_resource* memory)
+        : tape(std::move(tape)), size(size), block_size(block_size), read_buf(memory), write_buf(memory) {
+    if (size == 0) {
+        throw std::invalid_argument("size of a tape cannot be zero");
+    }
+    if (block_size == 0) {
+        throw std::invalid_argument("size of a block cannot be zero");
+    }
+    read_buf.reserve(block_size);
+    write_buf.reserve(block_size);
+}
+
+template <tape_element T>
+typed_buffered_tape<T>::~typed_buffered_tape() {
+    // the underlying tape may throw on I/O errors, and a destructor must not;
+    // callers that care about a failed write flush the tape explicitly
+    try {
+        flush_writes();
+    } catch (...) {
+    }
+}
+
+namespace {
+    direction to_direction(int step) {
+        return step > 0 ? direction::right : direction::left;
+    }
+}
+
+template <tape_element T>
+void typed_buffered_tape<T>::seek(size_t target) const {
+    if (tape_pos < target) {
+        tape_pos += tape->move_n(target - tape_pos, direction::right);
+    } else if (tape_pos > target) {
+        tape_pos -= tape->move_n(tape_pos - target, direction::left);
+    }
+}
+
+template <tape_element T>
+size_t typed_buffered_tape<T>::available(size_t n, int step) const {
+    return std::min(n, step > 0 ? size - pos : pos + 1);
+}
+
+template <tape_element T>
+void typed_buffered_tape<T>::turn(int step) const {
+    if (dir != step) {
+        flush_writes();
+        dir = step;
+    }
+}
+
+template <tape_element T>
+void typed_buffered_tape<T>::fill() const {
+    flush_writes();
+    size_t n;
+    if (dir > 0) {
+        n = std::min(block_size, size - pos);
+        read_lo = pos;
+    } else {
+        n = std::min(block_size, pos + 1);
+        read_lo = pos + 1 - n;
+    }
+    read_buf.resize(n);
+    seek(pos);
+    tape->read_n(read_buf, to_direction(dir));
+    tape_pos = dir > 0 ? pos + n - 1 : read_lo;
+    if (dir < 0) {
+        std::reverse(read_buf.begin(), read_buf.end());
+    }
+}
+
+template <tape_element T>
+void typed_buffered_tape<T>::flush_writes() const {
+    if (write_buf.empty()) {
+        return;
+    }
+    seek(write_start);
+    tape->write_n(write_buf, to_direction(write_dir));
+    tape_pos = write_dir > 0 ? write_start + write_buf.size() - 1 : write_start + 1 - write_buf.size();
+    write_buf.clear();
+}
+
+template <tape_element T>
+T typed_buffered_tape<T>::read() const {
+    if (!write_buf.empty()) {
+        auto offset = (static_cast<std::ptrdiff_t>(pos) - static_cast<std::ptrdiff_t>(write_start)) * write_dir;
+        if (offset >= 0 && static_cast<size_t>(offset) < write_buf.size()) {
+            return write_buf[offset];
+        }
+    }
+    if (pos < read_lo || pos >= read_lo + read_buf.size()) {
+        fill();
+    }
+    return read_buf[pos - read_lo];
+}
+
+template <tape_element T>
+std::optional<T> typed_buffered_tape<T>::read_safe() const {
+    flush_writes();
+    seek(pos);
+    return tape->read_safe();
+}
+
+template <tape_element T>
+void typed_buffered_tape<T>::write(T data) {
+    if (pos >= read_lo && pos < read_lo + read_buf.size()) {
+        read_buf[pos - read_lo] = data;
+    }
+    if (!write_buf.empty()) {
+        auto offset = (static_cast<std::ptrdiff_t>(pos) - static_cast<std::ptrdiff_t>(write_start)) * write_dir;
+        if (offset >= 0 && static_cast<size_t>(offset) < write_buf.size()) {
+            write_buf[offset] = data;
+            return;
+        }
+        if (static_cast<size_t>(offset) == write_buf.size() && write_dir == dir && write_buf.size() < block_size) {
+            write_buf.push_back(data);
+            return;
+        }
+        flush_writes();
+    }
+    write_start = pos;
+    write_dir = dir;
+    write_buf.push_back(data);
+}
+
+template <tape_element T>
+bool typed_buffered_tape<T>::move_left() const {
+    if (pos == 0) {
+        return false;
+    }
+    turn(-1);
+    pos--;
+    return true;
+}
+
+template <tape_element T>
+bool typed_buffered_tape<T>::move_right() const {
+    if (pos + 1 == size) {
+        return false;
+    }
+    turn(1);
+    pos++;
+    return true;
+}
+
+template <tape_element T>
+void typed_buffered_tape<T>::rewind() const {
+    flush_writes();
+    tape->rewind();
+    tape_pos = pos = 0;
+}
+
+template <tape_element T>
+void typed_buffered_tape<T>::flush() {
+    flush_writes();
+    tape->flush();
+}
+
+template <tape_element T>
+std::optional<tape_bytes> typed_buffered_tape<T>::bytes_transferred() const {
+    return tape->bytes_transferred();
+}
+
+template <tape_element T>
+size_t typed_buffered_tape<T>::read_n(std::span<T> out, direction d) const {
+    auto step = d == direction::right ? 1 : -1;
+    auto n = available(out.size(), step);
+    if (n > 1) {
+        // the first element is read before the head moves, so the block must be read ahead in `d` already
+        turn(step);
+    }
+    if (out.size() < block_size) {
+        return typed_tape<T>::read_n(out, d);
+    }
+    // large reads bypass the buffer
+    flush_writes();
+    seek(pos);
+    tape->read_n(out.first(n), d);
+    tape_pos = pos = step > 0 ? pos + n - 1 : pos + 1 - n;
+    return n;
+}
+
+template <tape_element T>
+size_t typed_buffered_tape<T>::write_n(std::span<T const> data, direction d) {
+    auto step = d == direction::right ? 1 : -1;
+    auto n = available(data.size(), step);
+    if (n > 1) {
+        turn(step);
+    }
+    if (data.size() < block_size) {
+        return typed_tape<T>::write_n(data, d);
+    }
+    // large writes bypass the buffer
+    flush_writes();
+    read_buf.clear();
+    seek(pos);
+    tape->write_n(data.first(n), d);
+    tape_pos = pos = step > 0 ? pos + n - 1 : pos + 1 - n;
+    return n;
+}
+
+template <tape_element T>
+size_t typed_buffered_tape<T>::move_n(size_t n, direction d) const {
+    auto step = d == direction::right ? 1 : -1;
+    auto moved = std::min(n, step > 0 ? size - 1 - pos : pos);
+    if (moved > 0) {
+        turn(step);
+    }
+    pos = step > 0 ? pos + moved : pos - moved;
+    return moved;
+}
+
+#define INSTANTIATE_BUFFERED_TAPE(T) template class typed_buffered_tape<T>;
+FOR_EACH_TAPE_ELEMENT(INSTANTIATE_BUFFERED_TAPE)
@@ -0,0 +1,90 @@
+#ifndef YADRO_TATLIN_TEST_TASK_BUFFERED_TAPE_H
+#define YADRO_TATLIN_TEST_TASK_BUFFERED_TAPE_H
+
+#include "basic_tape.h"
+
+#include <memory_resource>
+#include <vector>
+
+/**
+ * Decorator which adds read-ahead and write-behind buffering to any tape.
+ * Reads are served from a block of elements which is read ahead in the direction the head moves
+ * (so both left-to-right and right-to-left scans are buffered).
+ * Writes to consecutive elements (in the direction the head moves) are accumulated in a block
+ * and written to the underlying tape at once.
+ * Moving the head doesn't touch the underlying tape; its head is moved lazily when a block is read or written.
+ * Buffered writes are flushed when the block is full, when the direction of moving changes,
+ * on rewind, on flush() and in the destructor.
+ * Bulk reads and writes of at least a block of elements bypass the buffers.
+ */
+template <tape_element T>
+class typed_buffered_tape : public typed_tape<T> {
+public:
+    /**
+     * @param tape underlying tape. Its head must be at the left-most position.
+     * @param size number of elements of the underlying tape. Cannot be zero.
+     * @param block_size max number of elements which are read or written at once. Cannot be zero.
+     * @param memory resource for the buffers (2*block_size elements)
+     */
+    typed_buffered_tape(std::unique_ptr<typed_tape<T>> tape, size_t size, size_t block_size,
+                        std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+    typed_buffered_tape(typed_buffered_tape const&) = delete;
+    typed_buffered_tape& operator=(typed_buffered_tape const&) = delete;
+
+    /**
+     * Flushes buffered writes. I/O errors are ignored here; call flush() beforehand to get them reported.
+     */
+    ~typed_buffered_tape() override;
+
+    T read() const override;
+    std::optional<T> read_safe() const override;
+
+    void write(T data) override;
+
+    bool move_left() const override;
+    bool move_right() const override;
+
+    void rewind() const override;
+
+    void flush() override;
+
+    [[nodiscard]] std::optional<tape_bytes> bytes_transferred() const override;
+
+    size_t read_n(std::span<T> out, direction d) const override;
+    size_t write_n(std::span<T const> data, direction d) override;
+    size_t move_n(size_t n, direction d) const override;
+
+private:
+    void seek(size_t target) const;
+    size_t available(size_t n, int step) const;
+    void turn(int step) const;
+    void fill() const;
+    void flush_writes() const;
+
+    std::unique_ptr<typed_tape<T>> tape;
+    const size_t size;
+    const size_t block_size;
+
+    mutable size_t pos = 0;
+    mutable size_t tape_pos = 0; // position of the head of the underlying tape
+    mutable int dir = 1;         // direction of the last move (or of the bulk operation): 1 means right, -1 means left
+
+    // elements [read_lo, read_lo + read_buf.size()) of the underlying tape, ordered by position
+    mutable std::pmr::vector<T> read_buf;
+    mutable size_t read_lo = 0;
+
+    // pending writes to elements write_start, write_start + write_dir, ...
+    mutable std::pmr::vector<T> write_buf;
+    mutable size_t write_start = 0;
+    mutable int write_dir = 1;
+};
+
+#define YADRO_TATLIN_TEST_TASK_EXTERN_BUFFERED_TAPE(T) extern template class typed_buffered_tape<T>;
+FOR_EACH_TAPE_ELEMENT(YADRO_TATLIN_TEST_TASK_EXTERN_BUFFERED_TAPE)
+#undef YADRO_TATLIN_TEST_TASK_EXTERN_BUFFERED_TAPE
+
+using buffered_tape = typed_buffered_tape<int>;
+
+
+#endif //YADRO_TATLIN_TEST_TASK_BUFFERED_TAPE_H
@@ -0,0 +1,398 @@
+#include "compressed_file_tape.h"
+
+#include <algorithm>
+#include <bit>
+#include <filesystem>
+#include <limits>
+
+namespace {
+    const size_t HEADER_LEN = 8;
+    const uint8_t HAS_BITMAP = 1;
+
+    bool test_bit(uint64_t const* bits, size_t i) {
+        return (bits[i / 64] >> (i % 64)) & 1;
+    }
+
+    void set_bit(uint64_t* bits, size_t i) {
+        bits[i / 64] |= uint64_t(1) << (i % 64);
+    }
+
+    size_t count_bits(uint64_t const* bits, size_t n_words) {
+        size_t cnt = 0;
+        for (size_t i = 0; i < n_words; ++i) {
+            cnt += std::popcount(bits[i]);
+        }
+        return cnt;
+    }
+
+    void store_u16(uint16_t value, char* buf) {
+        buf[0] = static_cast<char>(value & 0xFF);
+        buf[1] = static_cast<char>(value >> 8);
+    }
+
+    void store_u32(uint32_t value, char* buf) {
+        for (size_t i = 0; i < sizeof(uint32_t); ++i) {
+            buf[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+        }
+    }
+
+    uint32_t load_u32(char const* buf) {
+        uint32_t value = 0;
+        for (size_t i = 0; i < sizeof(uint32_t); ++i) {
+            value |= static_cast<uint32_t>(static_cast<uint8_t>(buf[i])) << (8 * i);
+        }
+        return value;
+    }
+
+    uint32_t zigzag(uint32_t delta) {
+        auto signed_delta = static_cast<int32_t>(delta);
+        return (delta << 1) ^ static_cast<uint32_t>(signed_delta >> 31);
+    }
+
+    uint32_t unzigzag(uint32_t value) {
+        return (value >> 1) ^ (0u - (value & 1));
+    }
+
+    size_t payload_len(size_t n_present, size_t width) {
+        return n_present == 0 ? 0 : ((n_present - 1) * width + 7) / 8;
+    }
+
+    /**
+     * Encodes the first `len` elements of a block into `out` (see compressed_file_tape).
+     * @return number of written bytes
+     */
+    size_t encode_block(int const* values, uint64_t const* present, size_t len, char* out) {
+        std::fill(out, out + HEADER_LEN, 0);
+        auto n_present = count_bits(present, (len + 63) / 64);
+        if (n_present == 0) {
+            return HEADER_LEN;
+        }
+        uint32_t deltas[compressed_file_tape::BLOCK_LEN];
+        size_t n_deltas = 0;
+        uint32_t max_delta = 0;
+        std::optional<uint32_t> prev;
+        for (size_t i = 0; i < len; ++i) {
+            if (!test_bit(present, i)) {
+                continue;
+            }
+            auto value = static_cast<uint32_t>(values[i]);
+            if (prev) {
+                deltas[n_deltas] = zigzag(value - *prev);
+                max_delta = std::max(max_delta, deltas[n_deltas]);
+                n_deltas++;
+            } else {
+                store_u32(value, out + 4);
+            }
+            prev = value;
+        }
+        auto width = static_cast<size_t>(std::bit_width(max_delta));
+        store_u16(static_cast<uint16_t>(n_present), out);
+        out[2] = static_cast<char>(width);
+        char* ptr = out + HEADER_LEN;
+        if (n_present < len) {
+            out[3] = static_cast<char>(HAS_BITMAP);
+            for (size_t i = 0; i < (len + 7) / 8; ++i) {
+                *ptr++ = static_cast<char>((present[i / 8] >> (8 * (i % 8))) & 0xFF);
+            }
+        }
+        uint64_t acc = 0;
+        size_t n_bits = 0;
+        for (size_t i = 0; i < n_deltas; ++i) {
+            acc |= static_cast<uint64_t>(deltas[i]) << n_bits;
+            n_bits += width;
+            while (n_bits >= 8) {
+                *ptr++ = static_cast<char>(acc & 0xFF);
+                acc >>= 8;
+                n_bits -= 8;
+            }
+        }
+        if (n_bits > 0) {
+            *ptr++ = static_cast<char>(acc & 0xFF);
+        }
+        return ptr - out;
+    }
+}
+
+compressed_file_tape::compressed_file_tape(std::string const& filename, size_t size)
+                                          : pos(0), size(size), block_idx(std::numeric_limits<size_t>::max()),
+                                            values(), present(), written(), loaded(false), dirty(false) {
+    if (size == 0) {
+        throw std::invalid_argument("size of a tape cannot be zero");
+    }
+    if (!std::filesystem::exists(filename)) {
+        std::ofstream created(filename, std::ios::binary);
+        if (!created) {
+            throw std::runtime_error("cannot create file " + filename);
+        }
+    }
+    auto expected_size = (size + BLOCK_LEN - 1) / BLOCK_LEN * SLOT_LEN;
+    auto file_size = std::filesystem::file_size(filename);
+    if (file_size < expected_size) {
+        if (file_size != 0) {
+            throw std::runtime_error("the file must either be empty "
+                                     "or contains valid compressed tape of length " + std::to_string(size));
+        }
+        std::filesystem::resize_file(filename, expected_size);
+    }
+    file = std::fstream(filename, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("cannot open file " + filename);
+    }
+    file.exceptions(std::fstream::badbit | std::fstream::failbit);
+}
+
+compressed_file_tape::compressed_file_tape(std::string const& filename, size_t size,
+                                           std::string const& config_filename)
+                                          : compressed_file_tape(filename, size) {
+    timings = timings_config::load_or_create(config_filename);
+}
+
+compressed_file_tape::~compressed_file_tape() {
+    // the file stream throws on errors, and a destructor must not;
+    // callers that care about a failed write flush the tape explicitly
+    try {
+        compressed_file_tape::flush();
+    } catch (...) {
+    }
+}
+
+size_t compressed_file_tape::block_len(size_t idx) const {
+    return std::min(BLOCK_LEN, size - idx * BLOCK_LEN);
+}
+
+void compressed_file_tape::seek_block(size_t p) const {
+    auto idx = p / BLOCK_LEN;
+    if (idx == block_idx) {
+        return;
+    }
+    store_block();
+    block_idx = idx;
+    present.fill(0);
+    written.fill(0);
+    loaded = false;
+}
+
+void compressed_file_tape::load_block() const {
+    auto len = block_len(block_idx);
+    char buf[SLOT_LEN];
+    file.seekg(static_cast<std::streamoff>(block_idx * SLOT_LEN));
+    file.read(buf, HEADER_LEN);
+    size_t n_present = static_cast<uint8_t>(buf[0]) | static_cast<size_t>(static_cast<uint8_t>(buf[1])) << 8;
+    auto width = static_cast<size_t>(static_cast<uint8_t>(buf[2]));
+    bool has_bitmap = static_cast<uint8_t>(buf[3]) & HAS_BITMAP;
+    if (n_present > len || width > 32 || (n_present != len && n_present != 0 && !has_bitmap)) {
+        throw std::runtime_error("corrupted block " + std::to_string(block_idx) + " of a compressed tape");
+    }
+    auto bitmap_len = has_bitmap ? (len + 7) / 8 : 0;
+    auto rest = bitmap_len + payload_len(n_present, width);
+    file.read(buf + HEADER_LEN, static_cast<std::streamsize>(rest));
+    n_bytes_read += HEADER_LEN + rest;
+
+    bitmap old_present{};
+    if (has_bitmap) {
+        for (size_t i = 0; i < bitmap_len; ++i) {
+            old_present[i / 8] |= static_cast<uint64_t>(static_cast<uint8_t>(buf[HEADER_LEN + i])) << (8 * (i % 8));
+        }
+        if (count_bits(old_present.data(), BITMAP_WORDS) != n_present) {
+            throw std::runtime_error("corrupted block " + std::to_string(block_idx) + " of a compressed tape");
+        }
+    } else if (n_present != 0) {
+        for (size_t i = 0; i < len; ++i) {
+            set_bit(old_present.data(), i);
+        }
+    }
+    char const* ptr = buf + HEADER_LEN + bitmap_len;
+    uint64_t acc = 0;
+    size_t n_bits = 0;
+    auto mask = (uint64_t(1) << width) - 1;
+    auto prev = load_u32(buf + 4);
+    bool first = true;
+    for (size_t i = 0; i < len; ++i) {
+        if (!test_bit(old_present.data(), i)) {
+            if (!test_bit(written.data(), i)) {
+                values[i] = 0;
+            }
+            continue;
+        }
+        if (!first) {
+            while (n_bits < width) {
+                acc |= static_cast<uint64_t>(static_cast<uint8_t>(*ptr++)) << n_bits;
+                n_bits += 8;
+            }
+            prev += unzigzag(static_cast<uint32_t>(acc & mask));
+            acc >>= width;
+            n_bits -= width;
+        }
+        first = false;
+        if (!test_bit(written.data(), i)) {
+            values[i] = static_cast<int>(prev);
+            set_bit(present.data(), i);
+        }
+    }
+    loaded = true;
+}
+
+void compressed_file_tape::store_block() const {
+    if (!dirty) {
+        return;
+    }
+    auto len = block_len(block_idx);
+    if (!loaded && count_bits(written.data(), BITMAP_WORDS) != len) {
+        // the elements which were not overwritten are kept
+        load_block();
+    }
+    char buf[SLOT_LEN];
+    auto n = encode_block(values.data(), present.data(), len, buf);
+    file.seekp(static_cast<std::streamoff>(block_idx * SLOT_LEN));
+    file.write(buf, static_cast<std::streamsize>(n));
+    n_bytes_written += n;
+    dirty = false;
+}
+
+int compressed_file_tape::read() const {
+    auto value = read_safe();
+    return value ? *value : 0;
+}
+
+std::optional<int> compressed_file_tape::read_safe() const {
+    clock.advance(timings.read);
+    seek_block(pos);
+    auto off = pos % BLOCK_LEN;
+    if (!loaded && !test_bit(written.data(), off)) {
+        load_block();
+    }
+    if (!test_bit(present.data(), off)) {
+        return {};
+    }
+    return values[off];
+}
+
+void compressed_file_tape::write(int data) {
+    clock.advance(timings.write);
+    seek_block(pos);
+    auto off = pos % BLOCK_LEN;
+    values[off] = data;
+    set_bit(present.data(), off);
+    set_bit(written.data(), off);
+    dirty = true;
+}
+
+bool compressed_file_tape::move_left() const {
+    if (pos == 0) {
+        return false;
+    }
+    clock.advance(timings.move_left);
+    pos--;
+    return true;
+}
+
+bool compressed_file_tape::move_right() const {
+    if (pos + 1 == size) {
+        return false;
+    }
+    clock.advance(timings.move_right);
+    pos++;
+    return true;
+}
+
+void compressed_file_tape::rewind() const {
+    clock.advance(timings.rewind);
+    pos = 0;
+}
+
+void compressed_file_tape::flush() {
+    store_block();
+    file.flush();
+}
+
+size_t compressed_file_tape::available(size_t n, direction dir) const {
+    return std::min(n, dir == direction::right ? size - pos : pos + 1);
+}
+
+size_t compressed_file_tape::read_n(std::span<int> out, direction dir) const {
+    auto n = available(out.size(), dir);
+    if (n == 0) {
+        return 0;
+    }
+    auto move_timing = dir == direction::right ? timings.move_right : timings.move_left;
+    clock.advance(timings.read * n + move_timing * (n - 1));
+    for (size_t i = 0; i < n; ++i) {
+        auto p = dir == direction::right ? pos + i : pos - i;
+        seek_block(p);
+        auto off = p % BLOCK_LEN;
+        if (!loaded && !test_bit(written.data(), off)) {
+            load_block();
+        }
+        out[i] = test_bit(present.data(), off) ? values[off] : 0;
+    }
+    pos = dir == direction::right ? pos + n - 1 : pos + 1 - n;
+    return n;
+}
+
+size_t compressed_file_tape::read_safe_n(std::span<std::optional<int>> out, direction dir) const {
+    auto n = available(out.size(), dir);
+    if (n == 0) {
+        return 0;
+    }
+    auto move_timing = dir == direction::right ? timings.move_right : timings.move_left;
+    clock.advance(timings.read * n + move_timing * (n - 1));
+    for (size_t i = 0; i < n; ++i) {
+        auto p = dir == direction::right ? pos + i : pos - i;
+        seek_block(p);
+        auto off = p % BLOCK_LEN;
+        if (!loaded && !test_bit(written.data(), off)) {
+            load_block();
+        }
+        out[i] = test_bit(present.data(), off) ? std::optional(values[off]) : std::nullopt;
+    }
+    pos = dir == direction::right ? pos + n - 1 : pos + 1 - n;
+    return n;
+}
+
+size_t compressed_file_tape::write_n(std::span<int const> data, direction dir) {
+    auto n = available(data.size(), dir);
+    if (n == 0) {
+        return 0;
+    }
+    auto move_timing = dir == direction::right ? timings.move_right : timings.move_left;
+    clock.advance(timings.write * n + move_timing * (n - 1));
+    for (size_t i = 0; i < n; ++i) {
+        auto p = dir == direction::right ? pos + i : pos - i;
+        seek_block(p);
+        auto off = p % BLOCK_LEN;
+        values[off] = data[i];
+        set_bit(present.data(), off);
+        set_bit(written.data(), off);
+        dirty = true;
+    }
+    pos = dir == direction::right ? pos + n - 1 : pos + 1 - n;
+    return n;
+}
+
+size_t compressed_file_tape::move_n(size_t n, direction dir) const {
+    auto moved = std::min(n, dir == direction::right ? size - 1 - pos : pos);
+    if (dir == direction::right) {
+        clock.advance(timings.move_right * moved);
+        pos += moved;
+    } else {
+        clock.advance(timings.move_left * moved);
+        pos -= moved;
+    }
+    return moved;
+}
+
+device_clock::duration compressed_file_tape::elapsed_time() const {
+    return clock.elapsed();
+}
+
+uint64_t compressed_file_tape::bytes_read() const {
+    return n_bytes_read;
+}
+
+uint64_t compressed_file_tape::bytes_written() const {
+    return n_bytes_written;
+}
+
+std::optional<tape_bytes> compressed_file_tape::bytes_transferred() const {
+    return tape_bytes{ .read = n_bytes_read, .written = n_bytes_written };
+}
@@ -0,0 +1,125 @@
+#ifndef YADRO_TATLIN_TEST_TASK_COMPRESSED_FILE_TAPE_H
+#define YADRO_TATLIN_TEST_TASK_COMPRESSED_FILE_TAPE_H
+
+#include "basic_tape.h"
+#include "device_clock.h"
+#include "timings_config.h"
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+/**
+ * This class emulates a tape by interacting with a binary file which stores the elements compressed.
+ * It is meant for temporary tapes holding sorted runs, where neighbouring elements are close to each other.
+ * The tape is divided into blocks of BLOCK_LEN elements, the i-th block is stored in a slot of SLOT_LEN bytes
+ * at offset i*SLOT_LEN. A block is encoded as:
+ * 1. 8-byte header: number of non-empty elements (2 bytes), bit width `w` of the deltas (1 byte),
+ *    flags (1 byte, bit 0 is set iff the bitmap follows) and the first non-empty element (4 bytes);
+ * 2. if some elements of the block are empty, the bitmap of non-empty elements (ceil(BLOCK_LEN/8) bytes);
+ * 3. differences between consecutive non-empty elements, zigzag-encoded (so descending runs are as cheap
+ *    as ascending ones) and packed into `w` bits each.
+ * All numbers are little-endian. Only the encoded bytes of a slot are read and written, and the file is
+ * preallocated sparsely, so a slot of a well-compressed block doesn't occupy its whole size on disk.
+ * A file consisting of zero bytes represents an empty tape.
+ * The block under the head is kept decoded in RAM, so the tape supports sequential scans in both directions
+ * at the cost of a slot access per BLOCK_LEN elements. Blocks which are completely overwritten are not read.
+ * To simulate delays in IO operations, timings from timings_config class are used.
+ */
+class compressed_file_tape : public basic_tape {
+public:
+    /**
+     * Creates compressed_file_tape that stores data in the given file. The file must has one of the following
+     * states:
+     * 1. it can contains data in valid format (described above);
+     * 2. it can be empty, in that case the file is (sparsely) pre-allocated with required number of zero bytes;
+     * 3. it can yet not exists, in that case an attempt to create the file is being made, then see case 2.
+     * Default timings are used.
+     * @param filename path to the file where to store data.
+     * @param size number of elements of the tape. Cannot be zero.
+     */
+    compressed_file_tape(std::string const& filename, size_t size);
+
+    /**
+     * The same as compressed_file_tape::compressed_file_tape(std::string const&, size_t),
+     * but attempts to parse timings from `config_filename` path. See timings_config::load_or_create.
+     * @param filename path to the file where to store data.
+     * @param size number of elements of the tape. Cannot be zero.
+     * @param config_filename path to the timings configuration file.
+     */
+    compressed_file_tape(std::string const& filename, size_t size, std::string const& config_filename);
+
+    /**
+     * Stores the current block. I/O errors are ignored here; call flush() beforehand to get them reported.
+     */
+    ~compressed_file_tape() override;
+
+    int read() const override;
+    std::optional<int> read_safe() const override;
+
+    void write(int data) override;
+
+    bool move_left() const override;
+    bool move_right() const override;
+
+    void rewind() const override;
+
+    void flush() override;
+
+    /**
+     * @return time spent by this tape on its operations according to the timings config, see device_clock
+     */
+    [[nodiscard]] device_clock::duration elapsed_time() const;
+
+    /**
+     * @return number of bytes read from the file so far
+     */
+    [[nodiscard]] uint64_t bytes_read() const;
+
+    /**
+     * @return number of bytes written to the file so far
+     */
+    [[nodiscard]] uint64_t bytes_written() const;
+
+    [[nodiscard]] std::optional<tape_bytes> bytes_transferred() const override;
+
+    size_t read_n(std::span<int> out, direction dir) const override;
+    size_t read_safe_n(std::span<std::optional<int>> out, direction dir) const override;
+    size_t write_n(std::span<int const> data, direction dir) override;
+    size_t move_n(size_t n, direction dir) const override;
+
+    static constexpr size_t BLOCK_LEN = 1024;
+    static constexpr size_t SLOT_LEN = 8192;
+
+private:
+    static constexpr size_t BITMAP_WORDS = BLOCK_LEN / 64;
+    using bitmap = std::array<uint64_t, BITMAP_WORDS>;
+
+    size_t available(size_t n, direction dir) const;
+    size_t block_len(size_t idx) const;
+    void seek_block(size_t p) const;
+    void load_block() const;
+    void store_block() const;
+
+    mutable std::fstream file;
+    mutable size_t pos;
+    const size_t size;
+    timings_config timings;
+    mutable device_clock clock;
+
+    // the block containing the element under the head
+    mutable size_t block_idx;
+    mutable std::array<int, BLOCK_LEN> values;
+    mutable bitmap present;
+    // elements written since the block was cached; if they cover the block, its slot is not read
+    mutable bitmap written;
+    mutable bool loaded;
+    mutable bool dirty;
+
+    mutable uint64_t n_bytes_read = 0;
+    mutable uint64_t n_bytes_written = 0;
+};
+
+
+#endif //YADRO_TATLIN_TEST_TASK_COMPRESSED_FILE_TAPE_H
@@ -0,0 +1,132 @@
+#include "counting_tape.h"
+
+template <tape_element T>
+typed_counting_tape<T>::typed_counting_tape(std::unique_ptr<typed_tape<T>> tape, tape_counters& counters)
+        : tape(std::move(tape)), counters(counters),
+          counts_bytes(this->tape->bytes_transferred().has_value()) {
+    count_bytes();
+}
+
+template <tape_element T>
+typed_counting_tape<T>::~typed_counting_tape() {
+    try {
+        tape->flush();
+    } catch (...) {
+    }
+    count_bytes();
+}
+
+template <tape_element T>
+void typed_counting_tape<T>::count_moves(size_t n, direction dir) const {
+    if (n == 0) {
+        return;
+    }
+    (dir == direction::left ? counters.moves_left : counters.moves_right) += n;
+    if (last_dir && *last_dir != dir) {
+        counters.reversals++;
+    }
+    last_dir = dir;
+}
+
+template <tape_element T>
+void typed_counting_tape<T>::count_bytes() const {
+    if (counts_bytes) {
+        counters.bytes = tape->bytes_transferred();
+    }
+}
+
+template <tape_element T>
+T typed_counting_tape<T>::read() const {
+    counters.reads++;
+    auto data = tape->read();
+    count_bytes();
+    return data;
+}
+
+template <tape_element T>
+std::optional<T> typed_counting_tape<T>::read_safe() const {
+    counters.reads++;
+    auto data = tape->read_safe();
+    count_bytes();
+    return data;
+}
+
+template <tape_element T>
+void typed_counting_tape<T>::write(T data) {
+    counters.writes++;
+    tape->write(data);
+    count_bytes();
+}
+
+template <tape_element T>
+bool typed_counting_tape<T>::move_left() const {
+    bool moved = tape->move_left();
+    count_moves(moved, direction::left);
+    count_bytes();
+    return moved;
+}
+
+template <tape_element T>
+bool typed_counting_tape<T>::move_right() const {
+    bool moved = tape->move_right();
+    count_moves(moved, direction::right);
+    count_bytes();
+    return moved;
+}
+
+template <tape_element T>
+void typed_counting_tape<T>::rewind() const {
+    counters.rewinds++;
+    last_dir.reset();
+    tape->rewind();
+    count_bytes();
+}
+
+template <tape_element T>
+void typed_counting_tape<T>::flush() {
+    tape->flush();
+    count_bytes();
+}
+
+template <tape_element T>
+size_t typed_counting_tape<T>::read_n(std::span<T> out, direction dir) const {
+    auto n = tape->read_n(out, dir);
+    counters.reads += n;
+    count_moves(n > 0 ? n - 1 : 0, dir);
+    count_bytes();
+    return n;
+}
+
+template <tape_element T>
+size_t typed_counting_tape<T>::read_safe_n(std::span<std::optional<T>> out, direction dir) const {
+    auto n = tape->read_safe_n(out, dir);
+    counters.reads += n;
+    count_moves(n > 0 ? n - 1 : 0, dir);
+    count_bytes();
+    return n;
+}
+
+template <tape_element T>
+size_t typed_counting_tape<T>::write_n(std::span<T const> data, direction dir) {
+    auto n = tape->write_n(data, dir);
+    counters.writes += n;
+    count_moves(n > 0 ? n - 1 : 0, dir);
+    count_bytes();
+    return n;
+}
+
+template <tape_element T>
+size_t typed_counting_tape<T>::move_n(size_t n, direction dir) const {
+    auto moved = tape->move_n(n, dir);
+    count_moves(moved, dir);
+    count_bytes();
+    return moved;
+}
+
+template <tape_element T>
+std::optional<tape_bytes> typed_counting_tape<T>::bytes_transferred() const {
+    return tape->bytes_transferred();
+}
+
+#define INSTANTIATE_COUNTING_TAPE(T) template class typed_counting_tape<T>;
+FOR_EACH_TAPE_ELEMENT(INSTANTIATE_COUNTING_TAPE)
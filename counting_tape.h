@@ -0,0 +1,97 @@
+#ifndef YADRO_TATLIN_TEST_TASK_COUNTING_TAPE_H
+#define YADRO_TATLIN_TEST_TASK_COUNTING_TAPE_H
+
+#include "basic_tape.h"
+
+#include <optional>
+#include <string>
+
+/**
+ * Numbers of operations performed on a tape.
+ * Bulk operations are counted element-wise: read_n of n elements is n reads and n-1 moves.
+ */
+struct tape_counters {
+    std::string name;
+    /**
+     * Number of bytes an element occupies on the device, used to report the bytes read and written.
+     * Zero if it is not fixed (e.g. for compressed tapes).
+     */
+    size_t element_bytes = 0;
+    size_t reads = 0;
+    size_t writes = 0;
+    size_t moves_left = 0;
+    size_t moves_right = 0;
+    /**
+     * Number of moves in the direction opposite to the previous move (rewinds reset the direction).
+     */
+    size_t reversals = 0;
+    size_t rewinds = 0;
+
+    /**
+     * Bytes transferred by a tape which counts them itself (see typed_tape::bytes_transferred).
+     * Reported instead of the ones computed by element_bytes.
+     */
+    std::optional<tape_bytes> bytes{};
+};
+
+/**
+ * Decorator which counts the operations performed on a tape.
+ * Counters are stored outside of the tape, so they outlive it.
+ * A tape is not meant to be used concurrently, so the counters are not synchronized.
+ */
+template <tape_element T>
+class typed_counting_tape : public typed_tape<T> {
+public:
+    /**
+     * @param tape underlying tape
+     * @param counters where to count the operations. Must outlive the tape.
+     */
+    typed_counting_tape(std::unique_ptr<typed_tape<T>> tape, tape_counters& counters);
+
+    /**
+     * Flushes the underlying tape, so the bytes it writes on destruction are counted.
+     * I/O errors are ignored here; call flush() beforehand to get them reported.
+     */
+    ~typed_counting_tape() override;
+
+    T read() const override;
+    std::optional<T> read_safe() const override;
+
+    void write(T data) override;
+
+    bool move_left() const override;
+    bool move_right() const override;
+
+    void rewind() const override;
+
+    void flush() override;
+
+    size_t read_n(std::span<T> out, direction dir) const override;
+    size_t read_safe_n(std::span<std::optional<T>> out, direction dir) const override;
+    size_t write_n(std::span<T const> data, direction dir) override;
+    size_t move_n(size_t n, direction dir) const override;
+
+    [[nodiscard]] std::optional<tape_bytes> bytes_transferred() const override;
+
+private:
+    void count_moves(size_t n, direction dir) const;
+
+    /**
+     * Copies the bytes transferred by the underlying tape to the counters, if it counts them.
+     */
+    void count_bytes() const;
+
+    std::unique_ptr<typed_tape<T>> tape;
+    tape_counters& counters;
+    bool counts_bytes;
+    mutable std::optional<direction> last_dir;
+};
+
+#define YADRO_TATLIN_TEST_TASK_EXTERN_COUNTING_TAPE(T) extern template class typed_counting_tape<T>;
+FOR_EACH_TAPE_ELEMENT(YADRO_TATLIN_TEST_TASK_EXTERN_COUNTING_TAPE)
+#undef YADRO_TATLIN_TEST_TASK_EXTERN_COUNTING_TAPE
+
+using counting_tape = typed_counting_tape<int>;
+
+
+#endif //YADRO_TATLIN_TEST_TASK_COUNTING_TAPE_H
@@ -0,0 +1,37 @@
+#include "device_clock.h"
+
+#include <thread>
+
+std::atomic<bool> device_clock::virtual_mode = false;
+std::atomic<device_clock::duration::rep> device_clock::total_time = 0;
+
+void device_clock::advance(duration delay) {
+    if (delay <= duration::zero()) {
+        return;
+    }
+    time += delay;
+    total_time.fetch_add(delay.count(), std::memory_order_relaxed);
+    if (!virtual_mode.load(std::memory_order_relaxed)) {
+        std::this_thread::sleep_for(delay);
+    }
+}
+
+device_clock::duration device_clock::elapsed() const {
+    return time;
+}
+
+void device_clock::set_virtual(bool enabled) {
+    virtual_mode.store(enabled);
+}
+
+bool device_clock::is_virtual() {
+    return virtual_mode.load();
+}
+
+device_clock::duration device_clock::total() {
+    return duration(total_time.load());
+}
+
+void device_clock::reset_total() {
+    total_time.store(0);
+}
@@ -0,0 +1,48 @@
+#ifndef YADRO_TATLIN_TEST_TASK_DEVICE_CLOCK_H
+#define YADRO_TATLIN_TEST_TASK_DEVICE_CLOCK_H
+
+#include <atomic>
+#include <chrono>
+
+/**
+ * Accounts the time spent by a simulated device (e.g. a tape) on its operations.
+ * By default, each operation sleeps for its delay. In virtual mode, the delays are only accumulated,
+ * so the simulated time of a long run with realistic timings can be measured in seconds.
+ * Each clock counts the time of its own device; the time of all devices is summed in a global counter.
+ * A single clock must not be used concurrently; different clocks can be used from different threads.
+ */
+class device_clock {
+public:
+    using duration = std::chrono::nanoseconds;
+
+    /**
+     * Charges `delay` to this clock and to the global counter.
+     * Sleeps for `delay` unless virtual mode is enabled.
+     */
+    void advance(duration delay);
+
+    /**
+     * @return total time charged to this clock
+     */
+    [[nodiscard]] duration elapsed() const;
+
+    /**
+     * Enables or disables virtual mode for all clocks.
+     */
+    static void set_virtual(bool enabled);
+    static bool is_virtual();
+
+    /**
+     * @return total time charged to all clocks since the start of the program (or the last reset_total call)
+     */
+    static duration total();
+    static void reset_total();
+
+private:
+    duration time{0};
+
+    static std::atomic<bool> virtual_mode;
+    static std::atomic<duration::rep> total_time;
+};
+
+#endif //YADRO_TATLIN_TEST_TASK_DEVICE_CLOCK_H
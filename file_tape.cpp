@@ -1,10 +1,10 @@
 #include "file_tape.h"
+#include "text_codec.h"
 
+#include <algorithm>
 #include <chrono>
 #include <filesystem>
 #include <iostream>
-#include <limits>
-#include <thread>
 #include <vector>
 
 namespace {
@@ -27,10 +27,11 @@ namespace {
     }
 }
 
-const uint8_t file_tape::FILL_LEN = std::to_string(std::numeric_limits<int>::min()).size();
-const std::string file_tape::FILL_S = std::string(FILL_LEN, ' ');
+const uint8_t file_tape::FILL_LEN = TEXT_FIELD_LEN;
+const size_t file_tape::CHUNK_LEN = 256;
 
-file_tape::file_tape(std::string const& filename, size_t size) : pos(0), size(size) {
+file_tape::file_tape(std::string const& filename, size_t size)
+                    : pos(0), size(size), io_buf(CHUNK_LEN * (TEXT_FIELD_LEN + 1)) {
     if (size == 0) {
         throw std::invalid_argument("size of a tape cannot be zero");
     }
@@ -40,34 +41,35 @@ file_tape::file_tape(std::string const& filename, size_t size) : pos(0), size(si
             throw std::runtime_error("cannot create file " + filename);
         }
     }
-    file = std::fstream(filename);
-    if (!file) {
-        throw std::runtime_error("cannot open file " + filename);
-    }
     auto expected_size = size * (FILL_LEN + 1) - 1;
     auto file_size = std::filesystem::file_size(filename);
-    if (file_size < expected_size) {
+    bool allocate = file_size < expected_size;
+    if (allocate) {
         if (file_size != 0) {
             throw std::runtime_error("the file must either be empty "
                                      "or contains valid tape of length " + std::to_string(size));
         }
-        std::string content(size * (FILL_LEN + 1), ' ');
-        file << content << std::endl;
+    }
+    file = std::fstream(filename);
+    if (!file) {
+        throw std::runtime_error("cannot open file " + filename);
+    }
+    if (allocate) {
+        // empty elements, written by chunks of io_buf
+        std::fill(io_buf.begin(), io_buf.end(), ' ');
+        for (size_t left = size * (FILL_LEN + 1); left > 0;) {
+            auto n = std::min(left, io_buf.size());
+            file.write(io_buf.data(), static_cast<std::streamsize>(n));
+            left -= n;
+        }
+        file << std::endl;
     }
     file.exceptions(std::fstream::badbit);
 }
 
 file_tape::file_tape(std::string const& filename, size_t size, std::string const& config_filename)
                     : file_tape(filename, size) {
-    try {
-        timings_config config(config_filename);
-        timings = config;
-    } catch (std::runtime_error& ignored) {
-        std::ofstream config_file(config_filename);
-        if (config_file) {
-            config_file << timings.to_string() << std::endl;
-        }
-    }
+    timings = timings_config::load_or_create(config_filename);
 }
 
 void file_tape::update_fstream_pos() const {
@@ -77,41 +79,33 @@ void file_tape::update_fstream_pos() const {
 }
 
 int file_tape::read() const {
-    std::this_thread::sleep_for(timings.read);
-    int res;
-    update_fstream_pos();
-    file >> res;
-    return res;
+    return read_safe().value_or(0);
 }
 
 std::optional<int> file_tape::read_safe() const {
-    std::this_thread::sleep_for(timings.read);
-    char buf[FILL_LEN];
+    clock.advance(timings.read);
+    char buf[TEXT_FIELD_LEN];
     update_fstream_pos();
-    file.read(buf, FILL_LEN);
-    std::string s(buf, FILL_LEN);
-    try {
-        auto res = std::stoi(s);
-        return { res };
-    } catch (std::exception& e) {
-        if (s != FILL_S) {
-            throw std::runtime_error("file corrupted: " + s);
-        }
-        return {};
+    if (!file.read(buf, TEXT_FIELD_LEN)) {
+        throw std::runtime_error("cannot read an element from the file");
     }
+    return decode_field(buf);
 }
 
 void file_tape::write(int data) {
-    std::this_thread::sleep_for(timings.write);
+    clock.advance(timings.write);
+    char buf[TEXT_FIELD_LEN + 1];
+    encode_field(data, buf);
+    buf[TEXT_FIELD_LEN] = ' ';
     update_fstream_pos();
-    file << std::setw(FILL_LEN) << data << ' ';
+    file.write(buf, TEXT_FIELD_LEN + 1);
 }
 
 bool file_tape::move_left() const {
     if (pos == 0) {
         return false;
     }
-    std::this_thread::sleep_for(timings.move_left);
+    clock.advance(timings.move_left);
     pos--;
     return true;
 }
@@ -120,59 +114,97 @@ bool file_tape::move_right() const {
     if (pos + 1 == size) {
         return false;
     }
-    std::this_thread::sleep_for(timings.move_right);
+    clock.advance(timings.move_right);
     pos++;
     return true;
 }
 
 void file_tape::rewind() const {
-    std::this_thread::sleep_for(timings.rewind);
+    clock.advance(timings.rewind);
     pos = 0;
 }
 
-#pragma clang diagnostic push
-#pragma clang diagnostic ignored "-Wshadow"
+void file_tape::flush() {
+    file.flush();
+}
 
-file_tape::timings_config::timings_config(std::string const& filename) {
-    std::ifstream file(filename);
-    if (!file) {
-        throw std::runtime_error("cannot open config file " + filename);
+size_t file_tape::available(size_t n, direction dir) const {
+    return std::min(n, dir == direction::right ? size - pos : pos + 1);
+}
+
+template <typename Decode>
+size_t file_tape::read_fields(size_t n, direction dir, Decode decode) const {
+    n = available(n, dir);
+    if (n == 0) {
+        return 0;
     }
-    std::string entry;
-    while (file >> entry) {
-        auto pos = entry.find('=');
-        if (pos == std::string::npos) {
-            continue;
+    auto move_timing = dir == direction::right ? timings.move_right : timings.move_left;
+    clock.advance(timings.read * n + move_timing * (n - 1));
+    for (size_t done = 0; done < n;) {
+        auto m = std::min(CHUNK_LEN, n - done);
+        auto first = dir == direction::right ? pos + done : pos + 1 - done - m;
+        file.seekg(static_cast<std::streamoff>(first * (FILL_LEN + 1)));
+        auto len = static_cast<std::streamsize>(m * (FILL_LEN + 1) - 1);
+        if (!file.read(io_buf.data(), len) || file.gcount() != len) {
+            throw std::runtime_error("cannot read elements from the file");
         }
+        for (size_t i = 0; i < m; ++i) {
+            auto idx = dir == direction::right ? i : m - 1 - i;
+            decode(done + i, io_buf.data() + idx * (FILL_LEN + 1));
+        }
+        done += m;
+    }
+    pos = dir == direction::right ? pos + n - 1 : pos + 1 - n;
+    return n;
+}
 
-        auto field = std::string_view(entry.begin(), entry.begin() + pos);  // NOLINT(*-narrowing-conversions)
-        try {
-            auto value = std::chrono::milliseconds{std::stoull(entry.substr(pos + 1))};
-            if (field == "rewind") {
-                rewind = value;
-            } else if (field.starts_with('r')) {
-                read = value;
-            } else if (field.starts_with('w')) {
-                write = value;
-            } else if (field == "move_left" || field == "ml") {
-                move_left = value;
-            } else if (field == "move_right" || field == "mr") {
-                move_right = value;
-            }
-        } catch (std::invalid_argument& e) {
-            continue;
-        } catch (std::out_of_range& e) {
-            continue;
+size_t file_tape::read_n(std::span<int> out, direction dir) const {
+    return read_fields(out.size(), dir, [out](size_t i, char const* field) {
+        out[i] = decode_field(field).value_or(0);
+    });
+}
+
+size_t file_tape::read_safe_n(std::span<std::optional<int>> out, direction dir) const {
+    return read_fields(out.size(), dir, [out](size_t i, char const* field) {
+        out[i] = decode_field(field);
+    });
+}
+
+size_t file_tape::write_n(std::span<int const> data, direction dir) {
+    auto n = available(data.size(), dir);
+    if (n == 0) {
+        return 0;
+    }
+    auto move_timing = dir == direction::right ? timings.move_right : timings.move_left;
+    clock.advance(timings.write * n + move_timing * (n - 1));
+    for (size_t done = 0; done < n;) {
+        auto m = std::min(CHUNK_LEN, n - done);
+        auto first = dir == direction::right ? pos + done : pos + 1 - done - m;
+        for (size_t i = 0; i < m; ++i) {
+            auto* field = io_buf.data() + (dir == direction::right ? i : m - 1 - i) * (FILL_LEN + 1);
+            encode_field(data[done + i], field);
+            field[FILL_LEN] = ' ';
         }
+        file.seekp(static_cast<std::streamoff>(first * (FILL_LEN + 1)));
+        file.write(io_buf.data(), static_cast<std::streamsize>(m * (FILL_LEN + 1)));
+        done += m;
     }
+    pos = dir == direction::right ? pos + n - 1 : pos + 1 - n;
+    return n;
 }
 
-#pragma clang diagnostic pop
+size_t file_tape::move_n(size_t n, direction dir) const {
+    auto moved = std::min(n, dir == direction::right ? size - 1 - pos : pos);
+    if (dir == direction::right) {
+        clock.advance(timings.move_right * moved);
+        pos += moved;
+    } else {
+        clock.advance(timings.move_left * moved);
+        pos -= moved;
+    }
+    return moved;
+}
 
-std::string file_tape::timings_config::to_string() const {
-    std::stringstream ss;
-    ss << "read=" << read << " write=" << write;
-    ss << " move_left=" << move_left << " move_right=" << move_right;
-    ss << " rewind=" << rewind;
-    return ss.str();
+device_clock::duration file_tape::elapsed_time() const {
+    return clock.elapsed();
 }
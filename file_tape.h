@@ -2,10 +2,12 @@
 #define YADRO_TATLIN_TEST_TASK_FILE_TAPE_H
 
 #include "basic_tape.h"
+#include "device_clock.h"
+#include "timings_config.h"
 
 #include <string>
 #include <fstream>
-#include <chrono>
+#include <vector>
 
 /**
  * This class emulates a tape by interacting with a text file.
@@ -16,34 +18,13 @@
  * <11 minus the length of string representation of the number> whitespaces is written,
  * then the number is written.
  * The elements are separated by whitespace.
- * Empty elements are allowed (stored as 11 whitespaces).
+ * Empty elements are allowed (stored as 11 whitespaces, or as 11 zero bytes in a never written part of
+ * a pre-allocated file).
  * To simulate delays in IO operations, timings from timings_config class are used.
  */
 class file_tape : public basic_tape {
 public:
-    struct timings_config {
-        std::chrono::milliseconds read{0};
-        std::chrono::milliseconds write{0};
-        std::chrono::milliseconds move_left{0};
-        std::chrono::milliseconds move_right{0};
-        std::chrono::milliseconds rewind{0};
-
-        timings_config() = default;
-        /**
-         * Attempts to parse `filename` and update default timings values from a content of the file.
-         * Allowed format: 'r' or "read" for read timing, 'w' or "write" for write timing,
-         * "ml" or "move_left" for move_left timing, "mr" or "move_right" for move_right timing,
-         * "rewind" for "rewind" timing.
-         * Timings are measured in milliseconds.
-         * Field name must be followed by '=' and field value.
-         * Optionally, the value can be followed by 'ms' suffix.
-         * Example: "mr=1337 r=123  move_left=42ms rewind=101" (without quotes).
-         * Result: { .read=123, .write=0, .move_left=42, .move_right=1337, .rewind=101 }.
-         * @param filename path to the config file
-         */
-        explicit timings_config(std::string const& filename);
-        [[nodiscard]] std::string to_string() const;
-    };
+    using timings_config = ::timings_config;
 
     /**
      * Creates file_tape that stores data in the given file. The file must has one of the following states:
@@ -78,16 +59,43 @@ public:
 
     void rewind() const override;
 
+    void flush() override;
+
+    /**
+     * @return time spent by this tape on its operations according to the timings config, see device_clock
+     */
+    [[nodiscard]] device_clock::duration elapsed_time() const;
+
+    size_t read_n(std::span<int> out, direction dir) const override;
+    size_t read_safe_n(std::span<std::optional<int>> out, direction dir) const override;
+    size_t write_n(std::span<int const> data, direction dir) override;
+    size_t move_n(size_t n, direction dir) const override;
+
 private:
     void update_fstream_pos() const;
+    size_t available(size_t n, direction dir) const;
+
+    /**
+     * Reads up to `n` consecutive elements (as a raw text) by chunks of CHUNK_LEN elements,
+     * each chunk with a single I/O call into io_buf.
+     * Moves the head as basic_tape::read_n does.
+     * @param decode called with the index of an element (in order of reading) and its field
+     * @return number of elements read
+     */
+    template <typename Decode>
+    size_t read_fields(size_t n, direction dir, Decode decode) const;
 
     static const uint8_t FILL_LEN;
-    static const std::string FILL_S;
+    static const size_t CHUNK_LEN;
 
     mutable std::fstream file;
     mutable size_t pos;
     const size_t size;
     timings_config timings;
+    mutable device_clock clock;
+
+    // text of CHUNK_LEN elements, allocated once and reused by all bulk operations
+    mutable std::vector<char> io_buf;
 };
 
 
@@ -0,0 +1,134 @@
+#ifndef YADRO_TATLIN_TEST_TASK_LOSER_TREE_H
+#define YADRO_TATLIN_TEST_TASK_LOSER_TREE_H
+
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+/**
+ * Tournament tree of losers which repeatedly selects the best key among k sources.
+ * Sources are identified by indices 0..k-1. Each source either has a current key or is exhausted;
+ * an exhausted source never wins. Ties are won by a source with the lower index.
+ * Replacing the winner's key costs ceil(log2(k)) comparisons.
+ * @tparam T type of keys
+ * @tparam Compare strict weak ordering; the winner is the least key with respect to it
+ */
+template <typename T, typename Compare = std::less<T>>
+class loser_tree {
+public:
+    /**
+     * Creates a tree of `k` exhausted sources.
+     * @param k number of sources. Cannot be zero.
+     */
+    explicit loser_tree(size_t k, Compare cmp = Compare())
+            : keys(k), exhausted(k, true), tree(k), cmp(std::move(cmp)) {
+        if (k == 0) {
+            throw std::invalid_argument("number of sources cannot be zero");
+        }
+    }
+
+    /**
+     * Sets the current key of the source `i`. Must be followed by build() before querying the tree.
+     */
+    void set(size_t i, T key) {
+        keys[i] = std::move(key);
+        exhausted[i] = false;
+    }
+
+    /**
+     * Marks the source `i` as exhausted. Must be followed by build() before querying the tree.
+     */
+    void reset(size_t i) {
+        exhausted[i] = true;
+    }
+
+    /**
+     * Plays the whole tournament. O(k).
+     */
+    void build() {
+        auto k = keys.size();
+        std::vector<size_t> winners(2 * k);
+        for (size_t i = 0; i < k; ++i) {
+            winners[k + i] = i;
+        }
+        for (size_t node = k - 1; node > 0; --node) {
+            auto l = winners[2 * node];
+            auto r = winners[2 * node + 1];
+            if (beats(l, r)) {
+                winners[node] = l;
+                tree[node] = r;
+            } else {
+                winners[node] = r;
+                tree[node] = l;
+            }
+        }
+        tree[0] = k == 1 ? 0 : winners[1];
+    }
+
+    /**
+     * @return true iff all sources are exhausted
+     */
+    [[nodiscard]] bool empty() const {
+        return exhausted[tree[0]];
+    }
+
+    /**
+     * @return index of the source with the best key
+     */
+    [[nodiscard]] size_t winner() const {
+        return tree[0];
+    }
+
+    /**
+     * @return the best key
+     */
+    [[nodiscard]] T const& top() const {
+        return keys[tree[0]];
+    }
+
+    /**
+     * Replaces the key of the winner with the next key of the same source.
+     */
+    void replace(T key) {
+        keys[tree[0]] = std::move(key);
+        replay();
+    }
+
+    /**
+     * Marks the winner as exhausted.
+     */
+    void pop() {
+        exhausted[tree[0]] = true;
+        replay();
+    }
+
+private:
+    bool beats(size_t a, size_t b) const {
+        if (exhausted[a] || exhausted[b]) {
+            return !exhausted[a] || (exhausted[b] && a < b);
+        }
+        if (cmp(keys[a], keys[b])) {
+            return true;
+        }
+        return !cmp(keys[b], keys[a]) && a < b;
+    }
+
+    void replay() {
+        auto k = keys.size();
+        auto winner = tree[0];
+        for (auto node = (winner + k) / 2; node > 0; node /= 2) {
+            if (beats(tree[node], winner)) {
+                std::swap(tree[node], winner);
+            }
+        }
+        tree[0] = winner;
+    }
+
+    std::vector<T> keys;
+    std::vector<bool> exhausted;
+    std::vector<size_t> tree; // tree[0] is the winner, tree[1..k-1] are losers of the matches
+    Compare cmp;
+};
+
+#endif //YADRO_TATLIN_TEST_TASK_LOSER_TREE_H
@@ -1,14 +1,26 @@
-#include "file_tape.h"
+#include "counting_tape.h"
+#include "device_clock.h"
+#include "memory_arena.h"
+#include "sort_planner.h"
 #include "tape_algorithm.h"
 #include "tape_utils.h"
+#include "temp_tape_pool.h"
 
+#include <algorithm>
 #include <args.hxx>
+#include <chrono>
+#include <cstdint>
+#include <deque>
 #include <iostream>
+#include <memory>
+#include <new>
+#include <type_traits>
 
 
 int main(int argc, char* argv[]) {
     args::ArgumentParser parser("A utility for sorting tapes containing integers. "
-                                "Tapes are emulated using regular text files. "
+                                "Tapes are emulated using regular text files "
+                                "(or binary ones, which can also store 64-bit integers and doubles). "
                                 "For the format of a configuration file and the data file of a tape, see README.md.",
                                 "Author: Danila Belous.");
     args::HelpFlag help(parser, "help", "Display this help menu", { 'h', "help" });
@@ -23,6 +35,45 @@ int main(int argc, char* argv[]) {
                                                                     "but cannot be zero."
                                                                     "The default value is 1e7.",
                                    {'m', "cutoff"}, 10000000);
+    args::ValueFlag<size_t> tapes(parser, "tapes", "The number of tapes used for sorting, "
+                                                   "including the output tape. "
+                                                   "2k tapes allow to merge k blocks at once, "
+                                                   "which reduces the number of passes over the data. "
+                                                   "Cannot be less than 4. The default value is 4.",
+                                  {"tapes"}, 4);
+    args::ValueFlag<std::string> runs(parser, "runs", "How to split the input tape into initial sorted runs: "
+                                                      "'fixed' (sort blocks of 'cutoff' elements in RAM) or "
+                                                      "'replacement' (replacement selection with a heap of 'cutoff' "
+                                                      "elements, which produces longer runs) or "
+                                                      "'natural' (reuse ascending and descending blocks of "
+                                                      "presorted input, which may need no merges at all). "
+                                                      "The default value is 'fixed'.",
+                                      {"runs"}, "fixed");
+    args::ValueFlag<std::string> engine(parser, "engine", "How to sort the data which doesn't fit into RAM: "
+                                                          "'merge' (merge the initial runs by passes over the data) or "
+                                                          "'distribution' (distribute the elements into buckets "
+                                                          "of key ranges chosen by sampling, until each bucket "
+                                                          "fits into 'cutoff'; buckets which still don't fit "
+                                                          "after two passes are merged). "
+                                                          "The default value is 'merge'.",
+                                        {"engine"}, "merge");
+    args::ValueFlag<size_t> buckets(parser, "buckets", "The number of buckets of a distribution pass "
+                                                       "with '--engine=distribution'. "
+                                                       "The default value is chosen by 'count' and 'cutoff'.",
+                                    {"buckets"}, 0);
+    args::Flag pipelined(parser, "pipelined", "Whether to overlap reading, sorting and writing of blocks "
+                                              "when generating fixed runs. "
+                                              "The runs become three times shorter to fit into 'cutoff'.",
+                         { "pipelined" });
+    args::ValueFlag<size_t> threads(parser, "threads", "The number of threads used to sort a block in RAM "
+                                                       "with '--pipelined'. "
+                                                       "The default value is the number of CPU cores.",
+                                    {"threads"}, 0);
+    args::Flag pipelined_merge(parser, "pipelined-merge", "Whether each tape taking part in a 2-way merge "
+                                                          "is accessed by its own I/O thread, "
+                                                          "so the delays of the tapes overlap. "
+                                                          "Used with 4 or 5 tapes and fixed runs.",
+                               { "pipelined-merge" });
     args::ValueFlag<std::string> output(parser, "output", "Path to the output tape. "
                                                            "It either should be correct tape or should be an empty file, "
                                                            "or should point to the desired location of the output tape. "
@@ -32,6 +83,90 @@ int main(int argc, char* argv[]) {
                                                            "to the desired location where to create it. "
                                                            "The default value is 'file_tape.cfg'.",
                                    {"config", "cfg"}, "file_tape.cfg");
+    args::ValueFlag<std::string> input_format(parser, "format", "Format of the input tape: "
+                                                                "'text' (see README.md), 'binary', 'mmap' "
+                                                                "or 'compressed'. "
+                                                                "The default value is 'text'.",
+                                              {"input-format"}, "text");
+    args::ValueFlag<std::string> output_format(parser, "format", "Format of the output tape: "
+                                                                 "'text', 'binary', 'mmap' or 'compressed'. "
+                                                                 "The default value is 'text'.",
+                                               {"output-format"}, "text");
+    args::ValueFlag<std::string> tmp_format(parser, "format", "Format of the temporary tapes: "
+                                                              "'text', 'binary', 'mmap' or 'compressed' "
+                                                              "(delta-encoded blocks, which shrink sorted runs). "
+                                                              "The default value is 'text'.",
+                                            {"tmp-format"}, "text");
+    args::ValueFlag<std::string> type(parser, "type", "Type of the elements: 'int32', 'int64', 'uint32' "
+                                                      "or 'double'. Types other than 'int32' are stored "
+                                                      "by binary tapes only, so all formats must be 'binary'. "
+                                                      "The default value is 'int32'.",
+                                      {"type"}, "int32");
+    args::ValueFlag<size_t> buffer(parser, "buffer", "The number of elements which each temporary tape "
+                                                     "reads ahead or writes behind at once. "
+                                                     "Zero disables buffering. "
+                                                     "The default value is 4096.",
+                                   {"buffer"}, 4096);
+    args::Flag rewind(parser, "rewind", "Whether to rewind the tapes before each merge pass "
+                                        "and read them from left to right instead of scanning them backwards. "
+                                        "Uses (tapes-1)/2-way merge, so at least 5 tapes are required.",
+                      { "rewind" });
+    args::Flag virtual_clock(parser, "virtual-clock", "Whether to only account the delays from the config file "
+                                                      "instead of sleeping, and to print the total simulated time "
+                                                      "spent by all tapes at the end.",
+                             { "virtual-clock" });
+    args::Flag plan(parser, "plan", "Do not sort, but print the predicted time spent by the tapes "
+                                    "for each sorting strategy which can use up to 'tapes' tapes "
+                                    "with the timings from the config file.",
+                    { "plan" });
+    args::Flag auto_plan(parser, "auto", "Use the sorting strategy with the least predicted time "
+                                         "(see '--plan') instead of the one set by '--tapes' and '--runs'.",
+                         { "auto" });
+    args::ValueFlag<std::string> memory(parser, "memory", "Memory budget for sorting, e.g. '512MiB' or '4G'. "
+                                                          "It is divided between the buffers of temporary tapes "
+                                                          "and the algorithm, which overrides 'cutoff'. "
+                                                          "All buffers are allocated from two regions "
+                                                          "(for the tapes and the algorithm) "
+                                                          "preallocated at start.",
+                                        {"memory"});
+    args::Flag huge_pages(parser, "huge-pages", "Whether to try to back the '--memory' region with huge pages.",
+                          { "huge-pages" });
+    args::Flag stats(parser, "stats", "Whether to print the numbers of operations performed on each tape "
+                                      "and the time of each phase of sorting as JSON.",
+                     { "stats" });
+    args::ValueFlag<std::string> checkpoint(parser, "checkpoint", "Path to a file where to save the state of sorting "
+                                                                  "after each merge pass. The file is removed "
+                                                                  "when sorting is finished. "
+                                                                  "Used with 4 or 5 tapes and fixed runs.",
+                                            {"checkpoint"});
+    args::Flag resume(parser, "resume", "Whether to continue sorting from the state saved to '--checkpoint' "
+                                        "by an interrupted run with the same arguments, "
+                                        "reusing its temporary tapes.",
+                      { "resume" });
+    args::ValueFlag<std::string> tmp_dir(parser, "tmp-dir", "Directory for the temporary tapes, "
+                                                            "or a comma-separated list of directories "
+                                                            "(e.g. on different drives) which are assigned "
+                                                            "to the partitions in turn. "
+                                                            "The default value is 'tmp'.",
+                                         {"tmp-dir"}, "tmp");
+    args::ValueFlag<size_t> partitions(parser, "partitions", "The number of key ranges into which the input tape "
+                                                             "is distributed by sample sort. The ranges are sorted "
+                                                             "concurrently, each with its own temporary tapes "
+                                                             "and 'cutoff'/'partitions' elements of RAM, "
+                                                             "and then concatenated. "
+                                                             "The default value is 1.",
+                                       {"partitions"}, 1);
+    args::ValueFlag<size_t> top(parser, "top", "Write only the K least elements to the output tape, "
+                                               "in ascending order. "
+                                               "If 2K elements fit into 'cutoff', they are selected "
+                                               "in a single pass over the input tape; otherwise, "
+                                               "runs and their tails which cannot reach the first K "
+                                               "elements are discarded before merging. "
+                                               "Cannot be combined with '--partitions'.",
+                                {"top"});
+    args::Flag largest(parser, "largest", "With '--top', select the K greatest elements instead, "
+                                          "in descending order.",
+                       {"largest"});
     try {
         parser.ParseCLI(argc, argv);
         auto sz = args::get(size);
@@ -44,12 +179,167 @@ int main(int argc, char* argv[]) {
             std::cout << "Number of elements which can be sorted in RAM cannot be zero.";
             return 1;
         }
-        auto cfg = args::get(config);
-        file_tape src(args::get(input), sz, cfg);
-        file_tape dst(args::get(output), sz, cfg);
-        sort(src, sz, dst, ctff, create_file_tape_factory(cfg));
-        if (print) {
-            print_tape(dst, std::cout);
+        if (args::get(tapes) < 4) {
+            std::cout << "Number of tapes cannot be less than 4.";
+            return 1;
+        }
+        auto n_partitions = args::get(partitions);
+        if (n_partitions == 0) {
+            std::cout << "Number of partitions cannot be zero.";
+            return 1;
+        }
+        if (top && args::get(top) == 0) {
+            std::cout << "Number of selected elements cannot be zero.";
+            return 1;
+        }
+        if (top && n_partitions != 1) {
+            std::cout << "Selection of the top elements cannot be split into partitions.";
+            return 1;
+        }
+        if (largest && !top) {
+            std::cout << "'--largest' requires '--top'.";
+            return 1;
+        }
+        auto run_gen = parse_run_generation(args::get(runs));
+        auto sort_eng = parse_sort_engine(args::get(engine));
+        auto options = sort_options{ .cutoff = ctff, .n_tapes = args::get(tapes), .runs = run_gen,
+                                     .pipelined_split = static_cast<bool>(pipelined), .n_threads = args::get(threads),
+                                     .pipelined_merge = static_cast<bool>(pipelined_merge),
+                                     .rewind = static_cast<bool>(rewind), .checkpoint = args::get(checkpoint),
+                                     .resume = static_cast<bool>(resume), .engine = sort_eng,
+                                     .n_buckets = args::get(buckets) };
+        auto src_fmt = parse_tape_format(args::get(input_format));
+        auto dst_fmt = parse_tape_format(args::get(output_format));
+        auto tmp_fmt = parse_tape_format(args::get(tmp_format));
+        auto elem_type = parse_element_type(args::get(type));
+        if (elem_type != element_type::int32 &&
+            (src_fmt != tape_format::binary || dst_fmt != tape_format::binary || tmp_fmt != tape_format::binary)) {
+            std::cout << "Only binary tapes can store elements other than 32-bit integers.";
+            return 1;
+        }
+        // the tapes and the sort are instantiated for the type of the elements
+        auto sort_tapes = [&]<tape_element T>(std::type_identity<T>) -> int {
+            auto buffer_size = args::get(buffer);
+            std::unique_ptr<memory_arena> arena;
+            std::unique_ptr<memory_arena> io_arena;
+            if (memory) {
+                auto bytes = parse_memory_size(args::get(memory));
+                auto footprint = top ? estimate_top_k_footprint(options)
+                                     : estimate_sample_sort_footprint(options, n_partitions);
+                if (auto_plan && !top) {
+                    // the plan may rewind the tapes, which takes the most temporary tapes
+                    auto rewinding = options;
+                    rewinding.rewind = true;
+                    auto rewinding_footprint = estimate_sample_sort_footprint(rewinding, n_partitions);
+                    footprint.n_temp_tapes = std::max(footprint.n_temp_tapes, rewinding_footprint.n_temp_tapes);
+                }
+                // each partition has its own tapes and cutoff/P elements, so it gets an equal share of the budget
+                auto budget = divide_memory_budget(bytes / n_partitions, footprint, buffer_size, sizeof(T));
+                ctff = budget.cutoff * n_partitions;
+                options.cutoff = ctff;
+                buffer_size = budget.buffer_size;
+                // the buffers of the tapes come and go during the phases, so they get a region of their own
+                // and don't fragment the memory of the large blocks of the algorithm
+                auto io_bytes = budget.io_bytes * n_partitions;
+                arena = std::make_unique<memory_arena>(bytes - io_bytes, static_cast<bool>(huge_pages));
+                options.memory = arena.get();
+                if (io_bytes != 0) {
+                    io_arena = std::make_unique<memory_arena>(io_bytes, static_cast<bool>(huge_pages));
+                }
+            }
+            auto* io_memory = io_arena ? io_arena.get() : options.memory;
+            device_clock::set_virtual(static_cast<bool>(virtual_clock));
+            auto cfg = args::get(config);
+            if (plan) {
+                auto plans = plan_sort(sz, ctff, args::get(tapes), timings_config::load_or_create(cfg));
+                auto best = std::min_element(plans.begin(), plans.end(), [](auto const& a, auto const& b) {
+                    return a.device_time < b.device_time;
+                });
+                for (auto it = plans.begin(); it != plans.end(); ++it) {
+                    std::cout << (it == best ? "* " : "  ") << it->to_string() << ": "
+                              << it->device_time.count() << " s, " << it->n_passes << " merge passes" << std::endl;
+                }
+                return 0;
+            }
+            auto src = create_file_tape<T>(args::get(input), sz, cfg, src_fmt);
+            // only the selected elements are written
+            auto dst = create_file_tape<T>(args::get(output), top ? std::min(args::get(top), sz) : sz, cfg, dst_fmt);
+            auto tmp_dirs = parse_path_list(args::get(tmp_dir));
+            auto pools = std::vector<std::shared_ptr<temp_tape_pool>>();
+            auto factories = std::vector<typed_tape_factory<T>>();
+            auto counters = std::deque<tape_counters>();
+            auto tmp_counters = std::vector<std::deque<tape_counters>>(n_partitions);
+            if (stats) {
+                counters.push_back({ .name = "src", .element_bytes = element_bytes<T>(src_fmt) });
+                src = std::make_unique<typed_counting_tape<T>>(std::move(src), counters.back());
+                counters.push_back({ .name = "dst", .element_bytes = element_bytes<T>(dst_fmt) });
+                dst = std::make_unique<typed_counting_tape<T>>(std::move(dst), counters.back());
+            }
+            for (size_t i = 0; i < n_partitions; ++i) {
+                pools.push_back(std::make_shared<temp_tape_pool>(tmp_dirs[i % tmp_dirs.size()], cfg, tmp_fmt,
+                                                                 static_cast<bool>(resume)));
+                // with a checkpoint, the temporary tapes are needed to resume the sort if it fails
+                pools.back()->keep_files(static_cast<bool>(checkpoint));
+                auto factory = pools.back()->factory<T>();
+                if (stats) {
+                    // count the operations on the underlying tapes, not the buffered ones
+                    auto prefix = n_partitions == 1 ? "tmp" : "p" + std::to_string(i) + ".tmp";
+                    factory = create_counting_tape_factory<T>(std::move(factory), tmp_counters[i], prefix,
+                                                              element_bytes<T>(tmp_fmt));
+                }
+                if (buffer_size != 0) {
+                    factory = create_buffered_tape_factory<T>(std::move(factory), buffer_size, io_memory);
+                }
+                factories.push_back(std::move(factory));
+            }
+            if (auto_plan) {
+                auto best = choose_sort_plan(sz, ctff, args::get(tapes), timings_config::load_or_create(cfg)).options;
+                options.n_tapes = best.n_tapes;
+                options.runs = best.runs;
+                options.rewind = best.rewind;
+            }
+            auto report = top ? top_k(*src, sz, args::get(top), static_cast<bool>(largest), *dst, options, factories[0])
+                              : sample_sort(*src, sz, *dst, options, factories);
+            auto device_time = device_clock::total();
+            for (auto const& pool : pools) {
+                pool->keep_files(false);
+            }
+            if (stats) {
+                for (auto const& part_counters : tmp_counters) {
+                    counters.insert(counters.end(), part_counters.begin(), part_counters.end());
+                }
+                print_stats(report, counters, std::cout);
+            }
+            if (print) {
+                print_tape(*dst, std::cout);
+            }
+            if (run_gen == run_generation::natural) {
+                std::cout << "Initial runs: " << report.n_runs << ", merge passes: " << report.n_passes
+                          << ", merge passes saved: " << report.n_passes_saved << std::endl;
+            }
+            if (sort_eng == sort_engine::distribution) {
+                std::cout << "Distribution passes: " << report.n_distribution_passes
+                          << ", merged buckets: " << report.n_merged_buckets << std::endl;
+            }
+            if (top) {
+                std::cout << "Initial runs: " << report.n_runs << ", merge passes: " << report.n_passes
+                          << ", elements pruned: " << report.n_pruned << std::endl;
+            }
+            if (virtual_clock) {
+                std::cout << "Simulated device time: "
+                          << std::chrono::duration<double>(device_time).count() << " s" << std::endl;
+            }
+            return 0;
+        };
+        switch (elem_type) {
+            case element_type::int64:
+                return sort_tapes(std::type_identity<int64_t>());
+            case element_type::uint32:
+                return sort_tapes(std::type_identity<uint32_t>());
+            case element_type::float64:
+                return sort_tapes(std::type_identity<double>());
+            default:
+                return sort_tapes(std::type_identity<int>());
         }
     } catch (args::Help&) {
         std::cout << parser;
@@ -57,11 +347,17 @@ int main(int argc, char* argv[]) {
         std::cerr << e.what() << std::endl;
         std::cerr << parser;
         return 1;
+    } catch (std::invalid_argument& e) {
+        std::cout << e.what() << std::endl;
+        return 1;
     } catch (std::ios_base::failure& e) {
         std::cout << "I/O error occurred while working with the tapes: " << e.what() << std::endl;
         return 1;
     } catch (std::runtime_error& e) {
         std::cout << "An error occurred while working with the tapes: " << e.what() << std::endl;
         return 1;
+    } catch (std::bad_alloc&) {
+        std::cout << "Not enough memory for sorting." << std::endl;
+        return 1;
     }
 }
@@ -0,0 +1,163 @@
+#include "memory_arena.h"
+
+#include <algorithm>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace {
+    size_t align_up(size_t x, size_t alignment) {
+        return (x + alignment - 1) / alignment * alignment;
+    }
+
+#ifdef _WIN32
+    char* allocate_region(size_t size, bool huge_pages, bool& huge) {
+        if (huge_pages) {
+            auto large = GetLargePageMinimum();
+            if (large != 0) {
+                auto* p = VirtualAlloc(nullptr, align_up(size, large),
+                                       MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+                if (p != nullptr) {
+                    huge = true;
+                    return static_cast<char*>(p);
+                }
+            }
+        }
+        auto* p = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if (p == nullptr) {
+            throw std::bad_alloc();
+        }
+        return static_cast<char*>(p);
+    }
+
+    void free_region(char* data, size_t) {
+        VirtualFree(data, 0, MEM_RELEASE);
+    }
+#else
+    constexpr size_t HUGE_PAGE_SIZE = 2 << 20;
+
+    size_t region_size(size_t size, bool huge) {
+        return huge ? align_up(size, HUGE_PAGE_SIZE) : size;
+    }
+
+    char* allocate_region(size_t size, bool huge_pages, bool& huge) {
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_POPULATE
+        flags |= MAP_POPULATE;
+#endif
+#ifdef MAP_HUGETLB
+        if (huge_pages) {
+            auto* p = mmap(nullptr, region_size(size, true), PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+            if (p != MAP_FAILED) {
+                huge = true;
+                return static_cast<char*>(p);
+            }
+        }
+#endif
+        auto* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+        if (p == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+#ifdef MADV_HUGEPAGE
+        if (huge_pages) {
+            // transparent huge pages, if enabled
+            madvise(p, size, MADV_HUGEPAGE);
+        }
+#endif
+        return static_cast<char*>(p);
+    }
+
+    void free_region(char* data, size_t size, bool huge) {
+        munmap(data, region_size(size, huge));
+    }
+#endif
+}
+
+memory_arena::memory_arena(size_t size, bool huge_pages) : size(size) {
+    if (size == 0) {
+        throw std::invalid_argument("size of an arena cannot be zero");
+    }
+    data = allocate_region(size, huge_pages, huge);
+    free_blocks[0] = size;
+}
+
+memory_arena::~memory_arena() {
+#ifdef _WIN32
+    free_region(data, size);
+#else
+    free_region(data, size, huge);
+#endif
+}
+
+size_t memory_arena::capacity() const {
+    return size;
+}
+
+size_t memory_arena::used() const {
+    std::lock_guard lock(mutex);
+    return in_use;
+}
+
+size_t memory_arena::peak() const {
+    std::lock_guard lock(mutex);
+    return peak_use;
+}
+
+bool memory_arena::on_huge_pages() const {
+    return huge;
+}
+
+void* memory_arena::do_allocate(size_t bytes, size_t alignment) {
+    if (alignment > ALIGNMENT) {
+        throw std::bad_alloc();
+    }
+    bytes = align_up(std::max<size_t>(bytes, 1), ALIGNMENT);
+    std::lock_guard lock(mutex);
+    // first fit; all free blocks start at multiples of ALIGNMENT
+    for (auto it = free_blocks.begin(); it != free_blocks.end(); ++it) {
+        auto [offset, block_size] = *it;
+        if (block_size < bytes) {
+            continue;
+        }
+        free_blocks.erase(it);
+        if (block_size > bytes) {
+            free_blocks[offset + bytes] = block_size - bytes;
+        }
+        in_use += bytes;
+        peak_use = std::max(peak_use, in_use);
+        return data + offset;
+    }
+    throw std::bad_alloc();
+}
+
+void memory_arena::do_deallocate(void* p, size_t bytes, size_t) {
+    bytes = align_up(std::max<size_t>(bytes, 1), ALIGNMENT);
+    auto offset = static_cast<size_t>(static_cast<char*>(p) - data);
+    std::lock_guard lock(mutex);
+    in_use -= bytes;
+    auto next = free_blocks.lower_bound(offset);
+    if (next != free_blocks.end() && offset + bytes == next->first) {
+        bytes += next->second;
+        next = free_blocks.erase(next);
+    }
+    if (next != free_blocks.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            prev->second += bytes;
+            return;
+        }
+    }
+    free_blocks[offset] = bytes;
+}
+
+bool memory_arena::do_is_equal(std::pmr::memory_resource const& other) const noexcept {
+    return this == &other;
+}
@@ -0,0 +1,74 @@
+#ifndef YADRO_TATLIN_TEST_TASK_MEMORY_ARENA_H
+#define YADRO_TATLIN_TEST_TASK_MEMORY_ARENA_H
+
+#include <cstddef>
+#include <map>
+#include <memory_resource>
+#include <mutex>
+
+/**
+ * Memory resource which serves all allocations from a single region of memory allocated up front.
+ * Freed blocks are reused (adjacent free blocks are coalesced), so buffers of consecutive phases
+ * of an algorithm share the same memory, and the peak memory usage never exceeds the size of the arena.
+ * The region is committed when the arena is created, so no allocation from the system happens later.
+ * Thread-safe.
+ */
+class memory_arena : public std::pmr::memory_resource {
+public:
+    /**
+     * Alignment of all allocated blocks. Sizes of the blocks are rounded up to a multiple of it.
+     */
+    static constexpr size_t ALIGNMENT = 64;
+
+    /**
+     * @param size size of the region in bytes. Cannot be zero.
+     * @param huge_pages whether to try to back the region with huge pages.
+     * If they are not available, regular pages are used.
+     * @throws std::bad_alloc if the region cannot be allocated
+     */
+    explicit memory_arena(size_t size, bool huge_pages = false);
+
+    memory_arena(memory_arena const&) = delete;
+    memory_arena& operator=(memory_arena const&) = delete;
+
+    ~memory_arena() override;
+
+    /**
+     * @return size of the region in bytes
+     */
+    [[nodiscard]] size_t capacity() const;
+
+    /**
+     * @return number of bytes allocated at the moment
+     */
+    [[nodiscard]] size_t used() const;
+
+    /**
+     * @return max number of bytes which were allocated at the same time
+     */
+    [[nodiscard]] size_t peak() const;
+
+    /**
+     * @return whether the region is backed by huge pages
+     */
+    [[nodiscard]] bool on_huge_pages() const;
+
+private:
+    /**
+     * @throws std::bad_alloc if there is no free block of the requested size
+     */
+    void* do_allocate(size_t bytes, size_t alignment) override;
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+    [[nodiscard]] bool do_is_equal(std::pmr::memory_resource const& other) const noexcept override;
+
+    char* data = nullptr;
+    size_t size;
+    bool huge = false;
+
+    mutable std::mutex mutex;
+    std::map<size_t, size_t> free_blocks; // offset -> size
+    size_t in_use = 0;
+    size_t peak_use = 0;
+};
+
+#endif //YADRO_TATLIN_TEST_TASK_MEMORY_ARENA_H
@@ -0,0 +1,230 @@
+#include "merge_kernel.h"
+#include "tape_element.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+namespace {
+    /**
+     * Branchless merge: the element to output is selected by a conditional move.
+     * The order of ties doesn't matter: equal elements of these types are indistinguishable.
+     * @return pointer past the last written element
+     */
+    template <bool Descending, typename T>
+    T* merge_scalar(T const* a, T const* a_end, T const* b, T const* b_end, T* out) {
+        while (a != a_end && b != b_end) {
+            auto x = *a;
+            auto y = *b;
+            bool take_a = element_traits<T>::less(x, y) ^ Descending;
+            *out++ = take_a ? x : y;
+            a += take_a;
+            b += !take_a;
+        }
+        out = std::copy(a, a_end, out);
+        return std::copy(b, b_end, out);
+    }
+
+#if defined(__AVX2__)
+    /**
+     * Vector of 8 ints.
+     */
+    struct vec_avx2 {
+        using type = __m256i;
+        static constexpr size_t width = 8;
+
+        static type load(int const* p) {
+            return _mm256_loadu_si256(reinterpret_cast<__m256i const*>(p));
+        }
+
+        static void store(int* p, type v) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v);
+        }
+
+        static type reverse(type v) {
+            return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+        }
+
+        static type min(type a, type b) {
+            return _mm256_min_epi32(a, b);
+        }
+
+        static type max(type a, type b) {
+            return _mm256_max_epi32(a, b);
+        }
+
+        /**
+         * Sorts a bitonic vector: compare-exchanges elements at distances 4, 2 and 1.
+         * `First` selects the element which goes first (min for ascending order).
+         */
+        template <typename First, typename Second>
+        static type sort_bitonic(type v, First first, Second second) {
+            auto t = _mm256_permute2x128_si256(v, v, 1);
+            v = _mm256_blend_epi32(first(v, t), second(v, t), 0xF0);
+            t = _mm256_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+            v = _mm256_blend_epi32(first(v, t), second(v, t), 0xCC);
+            t = _mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+            return _mm256_blend_epi32(first(v, t), second(v, t), 0xAA);
+        }
+    };
+    using vec = vec_avx2;
+#elif defined(__SSE4_1__)
+    /**
+     * Vector of 4 ints.
+     */
+    struct vec_sse41 {
+        using type = __m128i;
+        static constexpr size_t width = 4;
+
+        static type load(int const* p) {
+            return _mm_loadu_si128(reinterpret_cast<__m128i const*>(p));
+        }
+
+        static void store(int* p, type v) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v);
+        }
+
+        static type reverse(type v) {
+            return _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+        }
+
+        static type min(type a, type b) {
+            return _mm_min_epi32(a, b);
+        }
+
+        static type max(type a, type b) {
+            return _mm_max_epi32(a, b);
+        }
+
+        /**
+         * Sorts a bitonic vector: compare-exchanges elements at distances 2 and 1.
+         * `First` selects the element which goes first (min for ascending order).
+         */
+        template <typename First, typename Second>
+        static type sort_bitonic(type v, First first, Second second) {
+            auto t = _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+            v = _mm_blend_epi16(first(v, t), second(v, t), 0xF0);
+            t = _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+            return _mm_blend_epi16(first(v, t), second(v, t), 0xCC);
+        }
+    };
+    using vec = vec_sse41;
+#endif
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+    /**
+     * Merges three sorted sequences, see merge_scalar.
+     */
+    template <bool Descending>
+    int* merge_scalar3(int const* a, int const* a_end, int const* b, int const* b_end,
+                       int const* c, int const* c_end, int* out) {
+        while (a != a_end && b != b_end && c != c_end) {
+            auto x = *a;
+            auto y = *b;
+            bool take_a = (x < y) ^ Descending;
+            auto xy = take_a ? x : y;
+            if ((*c < xy) ^ Descending) {
+                *out++ = *c++;
+            } else {
+                *out++ = xy;
+                a += take_a;
+                b += !take_a;
+            }
+        }
+        if (a == a_end) {
+            return merge_scalar<Descending>(b, b_end, c, c_end, out);
+        }
+        if (b == b_end) {
+            return merge_scalar<Descending>(a, a_end, c, c_end, out);
+        }
+        return merge_scalar<Descending>(a, a_end, b, b_end, out);
+    }
+
+    /**
+     * Merges vectors of `vec::width` elements with a bitonic network:
+     * the merged pair of the current vector and the next vector of the sequence with the first head
+     * gives `width` elements to output and `width` elements to merge with the next vector.
+     * The tails of the sequences are merged by merge_scalar3.
+     */
+    template <bool Descending>
+    void merge_simd(int const* a, int const* a_end, int const* b, int const* b_end, int* out) {
+        constexpr auto w = vec::width;
+        auto first = [](vec::type x, vec::type y) { return Descending ? vec::max(x, y) : vec::min(x, y); };
+        auto second = [](vec::type x, vec::type y) { return Descending ? vec::min(x, y) : vec::max(x, y); };
+
+        auto cur = vec::load(a);
+        a += w;
+        auto next = vec::load(b);
+        b += w;
+        while (true) {
+            // cur and reversed next form a bitonic sequence
+            next = vec::reverse(next);
+            auto lo = vec::sort_bitonic(first(cur, next), first, second);
+            cur = vec::sort_bitonic(second(cur, next), first, second);
+            vec::store(out, lo);
+            out += w;
+
+            bool a_first = b == b_end || (a != a_end && !((*b < *a) ^ Descending));
+            auto*& src = a_first ? a : b;
+            auto* src_end = a_first ? a_end : b_end;
+            if (static_cast<size_t>(src_end - src) < w) {
+                break;
+            }
+            next = vec::load(src);
+            src += w;
+        }
+        int rest[w];
+        vec::store(rest, cur);
+        merge_scalar3<Descending>(a, a_end, b, b_end, rest, rest + w, out);
+    }
+#endif
+}
+
+namespace {
+    template <typename T>
+    void merge_sorted_scalar_of(std::span<T const> a, std::span<T const> b, std::span<T> out, bool descending) {
+        auto* a_end = a.data() + a.size();
+        auto* b_end = b.data() + b.size();
+        if (descending) {
+            merge_scalar<true>(a.data(), a_end, b.data(), b_end, out.data());
+        } else {
+            merge_scalar<false>(a.data(), a_end, b.data(), b_end, out.data());
+        }
+    }
+}
+
+void merge_sorted_scalar(std::span<int const> a, std::span<int const> b, std::span<int> out, bool descending) {
+    merge_sorted_scalar_of(a, b, out, descending);
+}
+
+void merge_sorted(std::span<int const> a, std::span<int const> b, std::span<int> out, bool descending) {
+#if defined(__AVX2__) || defined(__SSE4_1__)
+    if (a.size() >= vec::width && b.size() >= vec::width) {
+        auto* a_end = a.data() + a.size();
+        auto* b_end = b.data() + b.size();
+        if (descending) {
+            merge_simd<true>(a.data(), a_end, b.data(), b_end, out.data());
+        } else {
+            merge_simd<false>(a.data(), a_end, b.data(), b_end, out.data());
+        }
+        return;
+    }
+#endif
+    merge_sorted_scalar(a, b, out, descending);
+}
+
+void merge_sorted(std::span<int64_t const> a, std::span<int64_t const> b, std::span<int64_t> out, bool descending) {
+    merge_sorted_scalar_of(a, b, out, descending);
+}
+
+void merge_sorted(std::span<uint32_t const> a, std::span<uint32_t const> b, std::span<uint32_t> out,
+                  bool descending) {
+    merge_sorted_scalar_of(a, b, out, descending);
+}
+
+void merge_sorted(std::span<double const> a, std::span<double const> b, std::span<double> out, bool descending) {
+    merge_sorted_scalar_of(a, b, out, descending);
+}
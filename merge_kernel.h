@@ -0,0 +1,31 @@
+#ifndef YADRO_TATLIN_TEST_TASK_MERGE_KERNEL_H
+#define YADRO_TATLIN_TEST_TASK_MERGE_KERNEL_H
+
+#include <cstdint>
+#include <span>
+
+/**
+ * Merges two sequences sorted in the same order into `out`.
+ * Uses a bitonic merge network on AVX2 or SSE4.1 vectors if the program is built for such a CPU
+ * (see ENABLE_NATIVE_ARCH option in CMakeLists.txt), and a branchless scalar loop otherwise.
+ * @param a first sorted sequence
+ * @param b second sorted sequence
+ * @param out where to store the merged sequence. Its size must be equal to a.size() + b.size()
+ * @param descending whether the sequences are sorted in descending (instead of ascending) order
+ */
+void merge_sorted(std::span<int const> a, std::span<int const> b, std::span<int> out, bool descending);
+
+/**
+ * The same for other types of elements, ordered by element_traits::less. Always uses the scalar loop.
+ */
+void merge_sorted(std::span<int64_t const> a, std::span<int64_t const> b, std::span<int64_t> out, bool descending);
+void merge_sorted(std::span<uint32_t const> a, std::span<uint32_t const> b, std::span<uint32_t> out,
+                  bool descending);
+void merge_sorted(std::span<double const> a, std::span<double const> b, std::span<double> out, bool descending);
+
+/**
+ * The same as merge_sorted, but always uses the scalar loop.
+ */
+void merge_sorted_scalar(std::span<int const> a, std::span<int const> b, std::span<int> out, bool descending);
+
+#endif //YADRO_TATLIN_TEST_TASK_MERGE_KERNEL_H
@@ -0,0 +1,193 @@
+#include "mmap_file_tape.h"
+#include "text_codec.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    // number of bytes ahead of the head which are advised to be prefetched
+    const size_t PREFETCH_WINDOW = 1 << 20;
+}
+
+const uint8_t mmap_file_tape::FILL_LEN = TEXT_FIELD_LEN;
+
+mmap_file_tape::mmap_file_tape(std::string const& filename, size_t size) : size(size) {
+    if (size == 0) {
+        throw std::invalid_argument("size of a tape cannot be zero");
+    }
+    if (!std::filesystem::exists(filename)) {
+        std::ofstream created(filename);
+        if (!created) {
+            throw std::runtime_error("cannot create file " + filename);
+        }
+    }
+    auto expected_size = size * (FILL_LEN + 1) - 1;
+    auto file_size = std::filesystem::file_size(filename);
+    bool fill = false;
+    if (file_size < expected_size) {
+        if (file_size != 0) {
+            throw std::runtime_error("the file must either be empty "
+                                     "or contains valid tape of length " + std::to_string(size));
+        }
+        // the same content as file_tape pre-allocates: whitespaces followed by a line break
+        file_size = size * (FILL_LEN + 1) + 1;
+        std::filesystem::resize_file(filename, file_size);
+        fill = true;
+    }
+    mapped_len = file_size;
+
+#ifdef _WIN32
+    file_handle = CreateFileA(filename.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        file_handle = nullptr;
+        throw std::runtime_error("cannot open file " + filename);
+    }
+    mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+    if (mapping_handle != nullptr) {
+        mapped = static_cast<char*>(MapViewOfFile(mapping_handle, FILE_MAP_ALL_ACCESS, 0, 0, mapped_len));
+    }
+#else
+    fd = ::open(filename.c_str(), O_RDWR);
+    if (fd < 0) {
+        throw std::runtime_error("cannot open file " + filename);
+    }
+    void* addr = mmap(nullptr, mapped_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    mapped = addr == MAP_FAILED ? nullptr : static_cast<char*>(addr);
+#endif
+    if (mapped == nullptr) {
+        unmap();
+        throw std::runtime_error("cannot map file " + filename);
+    }
+
+    if (fill) {
+        std::memset(mapped, ' ', mapped_len - 1);
+        mapped[mapped_len - 1] = '\n';
+    }
+}
+
+mmap_file_tape::mmap_file_tape(std::string const& filename, size_t size, std::string const& config_filename)
+                              : mmap_file_tape(filename, size) {
+    timings = timings_config::load_or_create(config_filename);
+}
+
+mmap_file_tape::~mmap_file_tape() {
+    unmap();
+}
+
+void mmap_file_tape::unmap() noexcept {
+#ifdef _WIN32
+    if (mapped != nullptr) {
+        UnmapViewOfFile(mapped);
+    }
+    if (mapping_handle != nullptr) {
+        CloseHandle(mapping_handle);
+    }
+    if (file_handle != nullptr) {
+        CloseHandle(file_handle);
+    }
+    mapping_handle = file_handle = nullptr;
+#else
+    if (mapped != nullptr) {
+        munmap(mapped, mapped_len);
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    fd = -1;
+#endif
+    mapped = nullptr;
+}
+
+void mmap_file_tape::flush() {
+#ifdef _WIN32
+    if (!FlushViewOfFile(mapped, mapped_len) || !FlushFileBuffers(file_handle)) {
+        throw std::runtime_error("cannot flush mapped tape");
+    }
+#else
+    if (msync(mapped, mapped_len, MS_SYNC) != 0) {
+        throw std::runtime_error("cannot flush mapped tape");
+    }
+#endif
+}
+
+void mmap_file_tape::prefetch([[maybe_unused]] bool forward) const {
+#ifndef _WIN32
+    static const auto page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    auto offset = pos * (FILL_LEN + 1);
+    if (offset >= advised_lo && offset < advised_hi) {
+        return;
+    }
+    size_t lo, hi;
+    if (forward) {
+        lo = offset;
+        hi = std::min(mapped_len, offset + PREFETCH_WINDOW);
+    } else {
+        lo = offset > PREFETCH_WINDOW ? offset - PREFETCH_WINDOW : 0;
+        hi = std::min(mapped_len, offset + FILL_LEN + 1);
+    }
+    lo -= lo % page_size;
+    madvise(mapped + lo, hi - lo, MADV_WILLNEED);
+    advised_lo = lo;
+    advised_hi = hi;
+#endif
+}
+
+int mmap_file_tape::read() const {
+    return read_safe().value_or(0);
+}
+
+std::optional<int> mmap_file_tape::read_safe() const {
+    clock.advance(timings.read);
+    return decode_field(mapped + pos * (FILL_LEN + 1));
+}
+
+void mmap_file_tape::write(int data) {
+    clock.advance(timings.write);
+    auto* field = mapped + pos * (FILL_LEN + 1);
+    encode_field(data, field);
+    if (pos * (FILL_LEN + 1) + FILL_LEN < mapped_len) {
+        field[FILL_LEN] = ' ';
+    }
+}
+
+bool mmap_file_tape::move_left() const {
+    if (pos == 0) {
+        return false;
+    }
+    clock.advance(timings.move_left);
+    pos--;
+    prefetch(false);
+    return true;
+}
+
+bool mmap_file_tape::move_right() const {
+    if (pos + 1 == size) {
+        return false;
+    }
+    clock.advance(timings.move_right);
+    pos++;
+    prefetch(true);
+    return true;
+}
+
+void mmap_file_tape::rewind() const {
+    clock.advance(timings.rewind);
+    pos = 0;
+}
+
+device_clock::duration mmap_file_tape::elapsed_time() const {
+    return clock.elapsed();
+}
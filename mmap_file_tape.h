@@ -0,0 +1,91 @@
+#ifndef YADRO_TATLIN_TEST_TASK_MMAP_FILE_TAPE_H
+#define YADRO_TATLIN_TEST_TASK_MMAP_FILE_TAPE_H
+
+#include "basic_tape.h"
+#include "device_clock.h"
+#include "timings_config.h"
+
+#include <cstdint>
+#include <string>
+
+/**
+ * This class emulates a tape by memory-mapping a text file of the same format as file_tape uses.
+ * Reading, writing and moving the head are plain memory accesses;
+ * the OS pages the data in and out.
+ * While the head moves, the pages ahead of it (in the direction of moving)
+ * are advised to be prefetched, so both forward and backward sequential scans are streamed.
+ * To simulate delays in IO operations, timings from timings_config class are used.
+ */
+class mmap_file_tape : public basic_tape {
+public:
+    /**
+     * Creates mmap_file_tape that stores data in the given file.
+     * Requirements to the file are the same as in file_tape::file_tape(std::string const&, size_t).
+     * An empty file is grown to the required size and filled with whitespaces.
+     * Default timings are used.
+     * @param filename path to the file where to store data.
+     * @param size number of elements of the tape. Cannot be zero.
+     */
+    mmap_file_tape(std::string const& filename, size_t size);
+
+    /**
+     * The same as mmap_file_tape::mmap_file_tape(std::string const&, size_t),
+     * but attempts to parse timings from `config_filename` path. See timings_config::load_or_create.
+     * @param filename path to the file where to store data.
+     * @param size number of elements of the tape. Cannot be zero.
+     * @param config_filename path to the timings configuration file.
+     */
+    mmap_file_tape(std::string const& filename, size_t size, std::string const& config_filename);
+
+    mmap_file_tape(mmap_file_tape const&) = delete;
+    mmap_file_tape& operator=(mmap_file_tape const&) = delete;
+
+    ~mmap_file_tape() override;
+
+    int read() const override;
+    std::optional<int> read_safe() const override;
+
+    void write(int data) override;
+
+    bool move_left() const override;
+    bool move_right() const override;
+
+    void rewind() const override;
+
+    /**
+     * Synchronously writes modified pages back to the file.
+     */
+    void flush() override;
+
+    /**
+     * @return time spent by this tape on its operations according to the timings config, see device_clock
+     */
+    [[nodiscard]] device_clock::duration elapsed_time() const;
+
+private:
+    void prefetch(bool forward) const;
+    void unmap() noexcept;
+
+    static const uint8_t FILL_LEN;
+
+    char* mapped = nullptr;
+    size_t mapped_len = 0;
+#ifdef _WIN32
+    void* file_handle = nullptr;
+    void* mapping_handle = nullptr;
+#else
+    int fd = -1;
+#endif
+
+    mutable size_t pos = 0;
+    const size_t size;
+    timings_config timings;
+    mutable device_clock clock;
+
+    // byte range of the mapping which was last advised to be prefetched
+    mutable size_t advised_lo = 0;
+    mutable size_t advised_hi = 0;
+};
+
+
+#endif //YADRO_TATLIN_TEST_TASK_MMAP_FILE_TAPE_H
@@ -0,0 +1,116 @@
+#include "radix_sort.h"
+#include "tape_element.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+namespace {
+    constexpr size_t N_BUCKETS = 256;
+
+    /**
+     * Ranges which are shorter are sorted by std::sort.
+     */
+    constexpr size_t MIN_RADIX_SIZE = 64;
+
+    /**
+     * @param shift number of bits of the key (see element_traits::radix_key) below the digit
+     */
+    template <typename T>
+    size_t digit(T x, unsigned shift) {
+        return (element_traits<T>::radix_key(x) >> shift) & (N_BUCKETS - 1);
+    }
+
+    /**
+     * Counts digits of the elements. Four tables are filled independently,
+     * so consecutive increments do not depend on each other and the loop can be pipelined by a CPU.
+     */
+    template <typename T>
+    std::array<size_t, N_BUCKETS> histogram(T const* first, T const* last, unsigned shift) {
+        std::array<std::array<size_t, N_BUCKETS>, 4> counts{};
+        auto n = static_cast<size_t>(last - first);
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            counts[0][digit(first[i], shift)]++;
+            counts[1][digit(first[i + 1], shift)]++;
+            counts[2][digit(first[i + 2], shift)]++;
+            counts[3][digit(first[i + 3], shift)]++;
+        }
+        for (; i < n; ++i) {
+            counts[0][digit(first[i], shift)]++;
+        }
+        for (size_t b = 0; b < N_BUCKETS; ++b) {
+            counts[0][b] += counts[1][b] + counts[2][b] + counts[3][b];
+        }
+        return counts[0];
+    }
+
+    template <typename T>
+    void american_flag_sort(T* first, T* last, unsigned shift) {
+        if (static_cast<size_t>(last - first) < MIN_RADIX_SIZE) {
+            std::sort(first, last, element_less<T>());
+            return;
+        }
+
+        auto counts = histogram(first, last, shift);
+        auto n = static_cast<size_t>(last - first);
+        if (std::find(counts.begin(), counts.end(), n) != counts.end()) {
+            // all the elements have the same digit
+            if (shift != 0) {
+                american_flag_sort(first, last, shift - 8);
+            }
+            return;
+        }
+        std::array<T*, N_BUCKETS> next{};
+        std::array<T*, N_BUCKETS> end{};
+        auto* pos = first;
+        for (size_t b = 0; b < N_BUCKETS; ++b) {
+            next[b] = pos;
+            pos += counts[b];
+            end[b] = pos;
+        }
+
+        // move each element to its bucket following the cycles of the permutation
+        for (size_t b = 0; b < N_BUCKETS; ++b) {
+            while (next[b] != end[b]) {
+                auto value = *next[b];
+                for (auto d = digit(value, shift); d != b; d = digit(value, shift)) {
+                    std::swap(value, *next[d]++);
+                }
+                *next[b]++ = value;
+            }
+        }
+
+        if (shift == 0) {
+            return;
+        }
+        pos = first;
+        for (size_t b = 0; b < N_BUCKETS; ++b) {
+            if (counts[b] > 1) {
+                american_flag_sort(pos, pos + counts[b], shift - 8);
+            }
+            pos += counts[b];
+        }
+    }
+
+    template <typename T>
+    void sort_by_keys(std::span<T> data) {
+        american_flag_sort(data.data(), data.data() + data.size(), 8 * (sizeof(T) - 1));
+    }
+}
+
+void radix_sort(std::span<int> data) {
+    sort_by_keys(data);
+}
+
+void radix_sort(std::span<int64_t> data) {
+    sort_by_keys(data);
+}
+
+void radix_sort(std::span<uint32_t> data) {
+    sort_by_keys(data);
+}
+
+void radix_sort(std::span<double> data) {
+    sort_by_keys(data);
+}
@@ -0,0 +1,31 @@
+#ifndef YADRO_TATLIN_TEST_TASK_RADIX_SORT_H
+#define YADRO_TATLIN_TEST_TASK_RADIX_SORT_H
+
+#include <cstdint>
+#include <span>
+
+/**
+ * Sorts 32-bit signed integers in ascending order in place.
+ * Uses MSD radix sort by bytes with in-place permutation of buckets (American flag sort),
+ * so no scratch memory proportional to the data is needed. Small ranges are sorted by std::sort.
+ * @param data elements to sort
+ */
+void radix_sort(std::span<int> data);
+
+/**
+ * The same for 64-bit signed integers (8 digits instead of 4).
+ */
+void radix_sort(std::span<int64_t> data);
+
+/**
+ * The same for 32-bit unsigned integers.
+ */
+void radix_sort(std::span<uint32_t> data);
+
+/**
+ * The same for doubles, sorted by the bits of their keys (see element_traits<double>),
+ * so negative zero precedes positive zero and NaNs go to the ends.
+ */
+void radix_sort(std::span<double> data);
+
+#endif //YADRO_TATLIN_TEST_TASK_RADIX_SORT_H
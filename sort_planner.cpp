@@ -0,0 +1,121 @@
+#include "sort_planner.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+    /**
+     * Costs of tape operations per element, in milliseconds.
+     */
+    struct unit_costs {
+        explicit unit_costs(timings_config const& timings)
+                : read(static_cast<double>(timings.read.count())),
+                  write(static_cast<double>(timings.write.count())),
+                  move_left(static_cast<double>(timings.move_left.count())),
+                  move_right(static_cast<double>(timings.move_right.count())),
+                  rewind(static_cast<double>(timings.rewind.count())) {}
+
+        [[nodiscard]] double read_forward() const {
+            return read + move_right;
+        }
+
+        [[nodiscard]] double read_backward() const {
+            return read + move_left;
+        }
+
+        [[nodiscard]] double write_forward() const {
+            return write + move_right;
+        }
+
+        double read, write, move_left, move_right, rewind;
+    };
+
+    size_t div_ceil(size_t a, size_t b) {
+        return (a + b - 1) / b;
+    }
+
+    /**
+     * @return predicted number of initial runs
+     */
+    size_t count_runs(size_t count, size_t memory, run_generation runs) {
+        if (runs != run_generation::replacement_selection || count <= memory) {
+            return div_ceil(count, memory);
+        }
+        // see replacement_selection: part of memory is used for reading, runs are twice as long as the heap
+        auto heap = memory - std::min<size_t>(4096, memory / 8);
+        return div_ceil(count, 2 * heap);
+    }
+
+    sort_plan estimate(size_t count, size_t memory, sort_options options, unit_costs const& c) {
+        auto n = static_cast<double>(count);
+        auto n_runs = count_runs(count, memory, options.runs);
+        auto plan = sort_plan{ .options = options };
+
+        // run generation reads src and writes the runs from left to right
+        double cost = n * (c.read_forward() + c.write_forward());
+        if (options.rewind) {
+            auto k = (options.n_tapes - 1) / 2;
+            plan.n_passes = count_merge_passes(n_runs, k);
+            // each pass rewinds and reads src tapes from left to right;
+            // dst tapes are rewound unless they are fresh (first pass) or dst is written (last pass)
+            cost += static_cast<double>(plan.n_passes) * (n * (c.read_forward() + c.write_forward()) +
+                                                          static_cast<double>(k) * c.rewind);
+            if (plan.n_passes > 2) {
+                cost += static_cast<double>((plan.n_passes - 2) * k) * c.rewind;
+            }
+            if (plan.n_passes == 0) {
+                // the only run is copied to dst, see rewinding_merge_sort
+                cost += static_cast<double>(k) * c.rewind + n * (c.read_forward() + c.write_forward());
+            }
+        } else if (options.n_tapes < 6 && options.runs == run_generation::fixed) {
+            plan.n_passes = count_merge_passes(n_runs, 2);
+            // see merge: both heads are read before each comparison, unless the tapes are read by chunks
+            auto read = memory >= 4 ? c.read_backward() : 2 * c.read + c.move_left;
+            cost += static_cast<double>(plan.n_passes) * n * (read + c.write_forward());
+        } else {
+            plan.n_passes = count_merge_passes(n_runs, options.n_tapes / 2);
+            cost += static_cast<double>(plan.n_passes) * n * (c.read_backward() + c.write_forward());
+        }
+        if (!options.rewind && plan.n_passes % 2) {
+            // the result is reversed, see copy_reversed
+            cost += n * (c.read_backward() + c.write_forward());
+        }
+        plan.device_time = std::chrono::duration<double, std::milli>(cost);
+        return plan;
+    }
+}
+
+std::string sort_plan::to_string() const {
+    auto k = options.rewind ? (options.n_tapes - 1) / 2 : options.n_tapes / 2;
+    return std::to_string(options.n_tapes) + " tapes, " +
+           (options.runs == run_generation::fixed ? "fixed"
+            : options.runs == run_generation::replacement_selection ? "replacement selection" : "natural") + " runs, " +
+           std::to_string(k) + "-way merge, " +
+           (options.rewind ? "rewinds" : "reverse scans");
+}
+
+std::vector<sort_plan> plan_sort(size_t count, size_t memory, size_t max_tapes, timings_config const& timings) {
+    if (count == 0 || memory == 0) {
+        throw std::invalid_argument("count and memory must be positive integers");
+    }
+    if (max_tapes < 4) {
+        throw std::invalid_argument("at least 4 tapes are required");
+    }
+    auto costs = unit_costs(timings);
+    auto plans = std::vector<sort_plan>();
+    for (size_t n_tapes = 4; n_tapes <= max_tapes; ++n_tapes) {
+        for (auto runs : { run_generation::fixed, run_generation::replacement_selection }) {
+            auto options = sort_options{ .cutoff = memory, .n_tapes = n_tapes, .runs = runs,
+                                         .rewind = n_tapes % 2 == 1 };
+            plans.push_back(estimate(count, memory, options, costs));
+        }
+    }
+    return plans;
+}
+
+sort_plan choose_sort_plan(size_t count, size_t memory, size_t max_tapes, timings_config const& timings) {
+    auto plans = plan_sort(count, memory, max_tapes, timings);
+    return *std::min_element(plans.begin(), plans.end(), [](sort_plan const& a, sort_plan const& b) {
+        return a.device_time < b.device_time;
+    });
+}
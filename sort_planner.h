@@ -0,0 +1,53 @@
+#ifndef YADRO_TATLIN_TEST_TASK_SORT_PLANNER_H
+#define YADRO_TATLIN_TEST_TASK_SORT_PLANNER_H
+
+#include "tape_algorithm.h"
+#include "timings_config.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+/**
+ * A candidate strategy of sorting and its predicted cost.
+ */
+struct sort_plan {
+    sort_options options;
+
+    /**
+     * Number of merge passes over the data (not counting run generation and a final copy).
+     */
+    size_t n_passes = 0;
+
+    /**
+     * Predicted total time spent by all tapes, as accounted by device_clock.
+     */
+    std::chrono::duration<double> device_time{0};
+
+    /**
+     * @return human-readable description of the strategy, e.g. "6 tapes, fixed runs, 3-way merge, reverse scans"
+     */
+    [[nodiscard]] std::string to_string() const;
+};
+
+/**
+ * Predicts the cost of sorting strategies which can be executed with the given resources.
+ * For each number of tapes from 4 to `max_tapes`, the candidates are:
+ * fixed or replacement selection runs; merges with reverse scans (even number of tapes)
+ * or with rewinds (odd number of tapes, see sort_options::rewind).
+ * The cost model counts reads, writes, moves and rewinds made by each pass over the data
+ * and prices them with `timings`. The length of replacement selection runs is predicted for random input.
+ * @param count number of elements to sort. Cannot be zero.
+ * @param memory number of elements that can be sorted in RAM (sort_options::cutoff). Cannot be zero.
+ * @param max_tapes max number of tapes which can be used, including dst. Cannot be less than 4.
+ * @param timings delays of tape operations
+ * @return candidates in order of increasing number of tapes
+ */
+std::vector<sort_plan> plan_sort(size_t count, size_t memory, size_t max_tapes, timings_config const& timings);
+
+/**
+ * @return the cheapest candidate returned by plan_sort (the one with the least number of tapes on ties)
+ */
+sort_plan choose_sort_plan(size_t count, size_t memory, size_t max_tapes, timings_config const& timings);
+
+#endif //YADRO_TATLIN_TEST_TASK_SORT_PLANNER_H
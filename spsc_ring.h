@@ -0,0 +1,86 @@
+#ifndef YADRO_TATLIN_TEST_TASK_SPSC_RING_H
+#define YADRO_TATLIN_TEST_TASK_SPSC_RING_H
+
+#include <atomic>
+#include <memory_resource>
+#include <optional>
+#include <vector>
+
+/**
+ * Bounded lock-free ring buffer for exactly one producer thread and one consumer thread.
+ * push() blocks while the ring is full, pop() blocks while the ring is empty.
+ */
+template <typename T>
+class spsc_ring {
+public:
+    /**
+     * @param capacity max number of elements in the ring. Cannot be zero.
+     * @param memory resource for the elements
+     */
+    explicit spsc_ring(size_t capacity, std::pmr::memory_resource* memory = std::pmr::get_default_resource())
+            : buf(capacity, memory) {}
+
+    /**
+     * Pushes `value` to the ring, blocks while the ring is full. Must be called by the producer only.
+     * @return false if the ring is cancelled (the value is dropped), true otherwise
+     */
+    bool push(T value) {
+        auto t = tail.load(std::memory_order_relaxed);
+        while (true) {
+            auto h = head.load(std::memory_order_acquire);
+            if (cancelled.load(std::memory_order_acquire)) {
+                return false;
+            }
+            if (t - h < buf.size()) {
+                break;
+            }
+            head.wait(h, std::memory_order_acquire);
+        }
+        buf[t % buf.size()] = std::move(value);
+        tail.store(t + 1, std::memory_order_release);
+        tail.notify_one();
+        return true;
+    }
+
+    /**
+     * Pops the first element of the ring, blocks while the ring is empty. Must be called by the consumer only.
+     * @return the element or null optional if the ring is cancelled
+     */
+    std::optional<T> pop() {
+        auto h = head.load(std::memory_order_relaxed);
+        while (true) {
+            auto t = tail.load(std::memory_order_acquire);
+            if (cancelled.load(std::memory_order_acquire)) {
+                return {};
+            }
+            if (t != h) {
+                break;
+            }
+            tail.wait(t, std::memory_order_acquire);
+        }
+        auto res = std::move(buf[h % buf.size()]);
+        head.store(h + 1, std::memory_order_release);
+        head.notify_one();
+        return res;
+    }
+
+    /**
+     * Wakes up the producer and the consumer; all further calls fail. Can be called from any thread.
+     */
+    void cancel() {
+        cancelled.store(true, std::memory_order_release);
+        // change the indices to wake up the waiting threads, the ring is not used after cancellation
+        head.fetch_add(1, std::memory_order_acq_rel);
+        tail.fetch_add(1, std::memory_order_acq_rel);
+        head.notify_all();
+        tail.notify_all();
+    }
+
+private:
+    std::pmr::vector<T> buf;
+    alignas(64) std::atomic<size_t> head = 0;
+    alignas(64) std::atomic<size_t> tail = 0;
+    std::atomic<bool> cancelled = false;
+};
+
+#endif //YADRO_TATLIN_TEST_TASK_SPSC_RING_H
@@ -1,9 +1,104 @@
+#include "blocking_queue.h"
+#include "device_clock.h"
+#include "loser_tree.h"
+#include "merge_kernel.h"
+#include "radix_sort.h"
+#include "spsc_ring.h"
 #include "tape_algorithm.h"
 #include "tape_utils.h"
 
 #include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <memory_resource>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <vector>
 
 namespace {
+    /**
+     * Records the time of consecutive phases of a sort.
+     */
+    class phase_timer {
+    public:
+        explicit phase_timer(std::vector<sort_phase>& phases) : phases(phases) {}
+
+        /**
+         * Records the phase which started when the previous one finished (or when the timer was created).
+         */
+        void finish(std::string name) {
+            auto wall_now = std::chrono::steady_clock::now();
+            auto device_now = device_clock::total();
+            phases.push_back({ std::move(name), wall_now - wall_start, device_now - device_start });
+            wall_start = wall_now;
+            device_start = device_now;
+        }
+
+    private:
+        std::vector<sort_phase>& phases;
+        std::chrono::steady_clock::time_point wall_start = std::chrono::steady_clock::now();
+        device_clock::duration device_start = device_clock::total();
+    };
+
+    /**
+     * Sorts a block in RAM. Records are sorted by a stable sort, so records with equal keys keep their order;
+     * other elements are radix sorted.
+     */
+    template <tape_element T>
+    void sort_block(std::span<T> data) {
+        if constexpr (element_traits<T>::has_payload) {
+            std::stable_sort(data.begin(), data.end(), element_less<T>());
+        } else {
+            radix_sort(data);
+        }
+    }
+
+    /**
+     * Merges two chunks sorted in the same order into `out`. On ties, the elements of `a` go first.
+     */
+    template <tape_element T>
+    void merge_chunks(std::span<T const> a, std::span<T const> b, std::span<T> out, bool descending) {
+        if constexpr (element_traits<T>::has_payload) {
+            if (descending) {
+                std::merge(a.begin(), a.end(), b.begin(), b.end(), out.begin(), element_greater<T>());
+            } else {
+                std::merge(a.begin(), a.end(), b.begin(), b.end(), out.begin(), element_less<T>());
+            }
+        } else {
+            // equal elements are indistinguishable, so the order of ties doesn't matter
+            merge_sorted(a, b, out, descending);
+        }
+    }
+
+    /**
+     * Computes sizes of the blocks of the i-th layer on two src tapes of a merge step (see merge).
+     * @return sizes of the left and the right blocks
+     */
+    std::pair<size_t, size_t> layer_sizes(size_t i, size_t last_layer_id,
+                                          size_t n_elems, size_t n_blocks, size_t block_size) {
+        if (i != last_layer_id) {
+            return { block_size, block_size };
+        }
+        auto last_block_size = n_elems % block_size;
+        if (last_block_size == 0) {
+            last_block_size = block_size;
+        }
+        if (n_blocks % 2) {
+            return { last_block_size, 0 };
+        }
+        return { block_size, last_block_size };
+    }
+
     /**
      * Merges two src tapes (which are split into blocks of size `block_size`)
      * to two dst tapes (which will be split into blocks of size `block_size*2`).
@@ -11,6 +106,9 @@ namespace {
      * (depending on the current step in the merge sort algorithm).
      * If src tapes blocks are sorted in ascending order,
      * then dst blocks will be sorted in descending order, and vice versa.
+     * The block on src1 always precedes the block on src2 in the input, so the merge is stable
+     * if ties are taken from src1 for ascending dst blocks and from src2 for descending ones
+     * (a descending block is the reversed stable order).
      * @param src1 left source tape
      * @param src2 right source tape
      * @param dst1 left destination tape
@@ -22,28 +120,14 @@ namespace {
      * @param block_size current (src) size of the blocks
      * @param cmp_greater used to set the order of elements
      */
-    void merge(basic_tape const* src1, basic_tape const* src2,
-               basic_tape* dst1, basic_tape* dst2,
+    template <tape_element T>
+    void merge(typed_tape<T> const* src1, typed_tape<T> const* src2,
+               typed_tape<T>* dst1, typed_tape<T>* dst2,
                size_t n_layers, size_t last_layer_id,
                size_t n_elems, size_t n_blocks, size_t block_size,
                int cmp_greater) {
         for (size_t i = 0; i < n_layers; ++i) {
-            size_t left_block_size, right_block_size;
-            if (i == last_layer_id) {
-                auto last_block_size = n_elems % block_size;
-                if (last_block_size == 0) {
-                    last_block_size = block_size;
-                }
-                if (n_blocks % 2) {
-                    left_block_size = last_block_size;
-                    right_block_size = 0;
-                } else {
-                    left_block_size = block_size;
-                    right_block_size = last_block_size;
-                }
-            } else {
-                left_block_size = right_block_size = block_size;
-            }
+            auto [left_block_size, right_block_size] = layer_sizes(i, last_layer_id, n_elems, n_blocks, block_size);
 
             // basic merge, but we move from right to left on src tapes
             for (size_t left = 0, right = 0; left < left_block_size || right < right_block_size;) {
@@ -58,7 +142,7 @@ namespace {
                 } else {
                     auto e1 = src1->read();
                     auto e2 = src2->read();
-                    if ((e1 < e2) ^ cmp_greater) {
+                    if (element_traits<T>::less(e2, e1) == static_cast<bool>(cmp_greater)) {
                         dst1->write(e1);
                         src1->move_left();
                         left++;
@@ -77,97 +161,1761 @@ namespace {
         }
     }
 
+    /**
+     * Same as merge, but elements are read and written by chunks, which are merged in RAM by merge_sorted.
+     * A chunk of one src tape is merged with the part of the other chunk which precedes its last element,
+     * so at least one of the chunks is consumed entirely and is read again.
+     * The content of the tapes and the positions of their heads are the same as after merge.
+     * @param chunk_size max number of elements read from a src tape at once; 4*chunk_size elements of RAM are used
+     * @param memory resource for the chunks
+     */
+    template <tape_element T>
+    void chunked_merge(typed_tape<T> const* src1, typed_tape<T> const* src2,
+                       typed_tape<T>* dst1, typed_tape<T>* dst2,
+                       size_t n_layers, size_t last_layer_id,
+                       size_t n_elems, size_t n_blocks, size_t block_size,
+                       int cmp_greater, size_t chunk_size, std::pmr::memory_resource* memory) {
+        // a single allocation of the size of a block, so it reuses the memory of the runs (see memory_arena)
+        auto buf = std::pmr::vector<T>(4 * chunk_size, memory);
+        auto buf1 = std::span(buf).first(chunk_size);
+        auto buf2 = std::span(buf).subspan(chunk_size, chunk_size);
+        auto out = std::span(buf).subspan(2 * chunk_size);
+        bool descending = cmp_greater;
+        auto precedes = [descending](T const& x, T const& y) {
+            return descending ? element_traits<T>::less(y, x) : element_traits<T>::less(x, y);
+        };
+        for (size_t i = 0; i < n_layers; ++i) {
+            auto [left_block_size, right_block_size] = layer_sizes(i, last_layer_id, n_elems, n_blocks, block_size);
+            auto left = std::span<T>(), right = std::span<T>();
+            size_t left_read = 0, right_read = 0;
+            auto refill = [chunk_size](typed_tape<T> const* src, std::span<T> buf, std::span<T>& chunk,
+                                       size_t& read, size_t size) {
+                if (chunk.empty() && read < size) {
+                    chunk = buf.first(std::min(chunk_size, size - read));
+                    src->read_n(chunk, direction::left);
+                    src->move_left();
+                    read += chunk.size();
+                }
+            };
+            for (auto remaining = left_block_size + right_block_size; remaining > 0;) {
+                refill(src1, buf1, left, left_read, left_block_size);
+                refill(src2, buf2, right, right_read, right_block_size);
+                // the elements of the first chunk go first on ties, see merge
+                auto& first = descending ? right : left;
+                auto& second = descending ? left : right;
+                size_t n_first = first.size(), n_second = second.size();
+                if (!first.empty() && !second.empty()) {
+                    if (precedes(second.back(), first.back())) {
+                        n_first = std::upper_bound(first.begin(), first.end(), second.back(), precedes) - first.begin();
+                    } else {
+                        n_second = std::lower_bound(second.begin(), second.end(), first.back(), precedes)
+                                   - second.begin();
+                    }
+                }
+                auto merged = out.first(n_first + n_second);
+                merge_chunks<T>(first.first(n_first), second.first(n_second), merged, descending);
+                first = first.subspan(n_first);
+                second = second.subspan(n_second);
+                dst1->write_n(merged, direction::right);
+                remaining -= merged.size();
+                if (remaining > 0 || i + 2 < n_layers) {
+                    dst1->move_right();
+                }
+            }
+
+            std::swap(dst1, dst2);
+        }
+    }
+
+    /**
+     * Same as merge, but each tape is accessed by its own I/O thread:
+     * two threads read src tapes from right to left and two threads write dst tapes from left to right,
+     * exchanging elements with the merging (calling) thread through SPSC rings.
+     * So the delays of the tapes overlap, and the merging thread only touches memory.
+     * The content of the tapes and the positions of their heads are the same as after merge.
+     * An exception thrown by any thread stops the others and is rethrown to the caller.
+     * @param ring_size capacity of each of the four rings
+     * @param memory resource for the rings
+     */
+    template <tape_element T>
+    void pipelined_merge(typed_tape<T> const* src1, typed_tape<T> const* src2,
+                         typed_tape<T>* dst1, typed_tape<T>* dst2,
+                         size_t n_layers, size_t last_layer_id,
+                         size_t n_elems, size_t n_blocks, size_t block_size,
+                         int cmp_greater, size_t ring_size, std::pmr::memory_resource* memory) {
+        size_t n_read1 = 0, n_read2 = 0, n_written1 = 0, n_written2 = 0;
+        for (size_t i = 0; i < n_layers; ++i) {
+            auto [left_block_size, right_block_size] = layer_sizes(i, last_layer_id, n_elems, n_blocks, block_size);
+            n_read1 += left_block_size;
+            n_read2 += right_block_size;
+            (i % 2 ? n_written2 : n_written1) += left_block_size + right_block_size;
+        }
+
+        auto in1 = spsc_ring<T>(ring_size, memory);
+        auto in2 = spsc_ring<T>(ring_size, memory);
+        auto out1 = spsc_ring<T>(ring_size, memory);
+        auto out2 = spsc_ring<T>(ring_size, memory);
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        auto fail = [&] {
+            {
+                std::lock_guard lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+            for (auto* ring : { &in1, &in2, &out1, &out2 }) {
+                ring->cancel();
+            }
+        };
+
+        auto threads = std::vector<std::thread>();
+        auto start_reader = [&](typed_tape<T> const* tape, size_t count, spsc_ring<T>& ring) {
+            threads.emplace_back([&fail, tape, count, &ring] {
+                try {
+                    for (size_t j = 0; j < count; ++j) {
+                        if (!ring.push(tape->read())) {
+                            return;
+                        }
+                        tape->move_left();
+                    }
+                } catch (...) {
+                    fail();
+                }
+            });
+        };
+        auto start_writer = [&](typed_tape<T>* tape, size_t count, spsc_ring<T>& ring) {
+            threads.emplace_back([&fail, tape, count, &ring] {
+                try {
+                    for (size_t j = 0; j < count; ++j) {
+                        auto e = ring.pop();
+                        if (!e) {
+                            return;
+                        }
+                        tape->write(*e);
+                        if (j + 1 < count) {
+                            tape->move_right();
+                        }
+                    }
+                } catch (...) {
+                    fail();
+                }
+            });
+        };
+        start_reader(src1, n_read1, in1);
+        start_reader(src2, n_read2, in2);
+        start_writer(dst1, n_written1, out1);
+        start_writer(dst2, n_written2, out2);
+
+        struct cancelled {};
+        auto next = [](spsc_ring<T>& ring) {
+            auto e = ring.pop();
+            if (!e) {
+                throw cancelled{};
+            }
+            return *e;
+        };
+        try {
+            std::optional<T> e1, e2;
+            for (size_t i = 0; i < n_layers; ++i) {
+                auto [left_block_size, right_block_size] = layer_sizes(i, last_layer_id, n_elems, n_blocks, block_size);
+                auto& out = i % 2 ? out2 : out1;
+                for (size_t left = 0, right = 0; left < left_block_size || right < right_block_size;) {
+                    bool take_left;
+                    if (left >= left_block_size) {
+                        take_left = false;
+                    } else if (right >= right_block_size) {
+                        take_left = true;
+                    } else {
+                        if (!e1) {
+                            e1 = next(in1);
+                        }
+                        if (!e2) {
+                            e2 = next(in2);
+                        }
+                        take_left = element_traits<T>::less(*e2, *e1) == static_cast<bool>(cmp_greater);
+                    }
+                    auto& e = take_left ? e1 : e2;
+                    if (!e) {
+                        e = next(take_left ? in1 : in2);
+                    }
+                    if (!out.push(*e)) {
+                        throw cancelled{};
+                    }
+                    e.reset();
+                    (take_left ? left : right)++;
+                }
+            }
+        } catch (cancelled&) {
+            // the error is already stored by the failed thread
+        } catch (...) {
+            fail();
+        }
+        for (auto& t : threads) {
+            t.join();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    /**
+     * State of merge_sort between its steps.
+     */
+    struct merge_sort_state {
+        /**
+         * Number of initial runs.
+         */
+        size_t n_runs;
+
+        /**
+         * Size of the blocks on tape1 and tape2.
+         */
+        size_t block_size;
+
+        /**
+         * Total number of blocks on tape1 and tape2.
+         */
+        size_t n_blocks;
+
+        /**
+         * Number of the next step (the steps are numbered from one; the first one is splitting of src).
+         */
+        size_t n_steps;
+
+        /**
+         * Indices of tape1, tape2, tape3 and tape4 in the array of tapes.
+         */
+        std::array<size_t, 4> roles;
+
+        /**
+         * Number of elements written to each tape (in the array of tapes) by the last step.
+         * The head of such tape is on the last written element.
+         */
+        std::array<size_t, 4> lengths;
+    };
+
+    const std::string CHECKPOINT_HEADER = "tape_sorting_checkpoint_v1";
+
+    /**
+     * Saves the state of merge_sort of `n_elems` elements with `cutoff` to `path`.
+     * The file is replaced atomically, so it always contains a complete state.
+     */
+    void save_checkpoint(std::string const& path, size_t n_elems, size_t cutoff, merge_sort_state const& state) {
+        auto tmp_path = path + ".tmp";
+        {
+            std::ofstream out(tmp_path);
+            out << CHECKPOINT_HEADER << ' ' << n_elems << ' ' << cutoff << ' ' << state.n_runs << ' '
+                << state.block_size << ' ' << state.n_blocks << ' ' << state.n_steps;
+            for (auto role : state.roles) {
+                out << ' ' << role;
+            }
+            for (auto length : state.lengths) {
+                out << ' ' << length;
+            }
+            out << std::endl;
+            if (!out) {
+                throw std::runtime_error("cannot write checkpoint " + tmp_path);
+            }
+        }
+        std::filesystem::rename(tmp_path, path);
+    }
+
+    /**
+     * Loads the state saved by save_checkpoint.
+     * @return null optional if there is no checkpoint at `path`
+     * @throws std::invalid_argument if the checkpoint is corrupted or was saved for other `n_elems` or `cutoff`
+     */
+    std::optional<merge_sort_state> load_checkpoint(std::string const& path, size_t n_elems, size_t cutoff) {
+        std::ifstream in(path);
+        if (!in) {
+            return {};
+        }
+        std::string header;
+        size_t saved_n_elems = 0;
+        size_t saved_cutoff = 0;
+        merge_sort_state state{};
+        in >> header >> saved_n_elems >> saved_cutoff
+           >> state.n_runs >> state.block_size >> state.n_blocks >> state.n_steps;
+        for (auto& role : state.roles) {
+            in >> role;
+        }
+        for (auto& length : state.lengths) {
+            in >> length;
+        }
+        if (!in || header != CHECKPOINT_HEADER) {
+            throw std::invalid_argument("checkpoint " + path + " is corrupted");
+        }
+        if (saved_n_elems != n_elems || saved_cutoff != cutoff) {
+            throw std::invalid_argument("checkpoint " + path + " was saved for another count or cutoff");
+        }
+        auto sorted_roles = state.roles;
+        std::sort(sorted_roles.begin(), sorted_roles.end());
+        if (sorted_roles != std::array<size_t, 4>{ 0, 1, 2, 3 }) {
+            throw std::invalid_argument("checkpoint " + path + " is corrupted");
+        }
+        return state;
+    }
+
     /**
      * Performs iterative merge sort algorithm. Scans src tapes from right to left,
      * and stores merged sorted blocks to dst tapes from left to right.
      * The size of blocks is doubled on each step.
      * The result is stored in reversed order each two iterations of the algorithm.
      * @param n_elems number of elements to sort
-     * @param cutoff initial size of blocks (already sorted and stored in tape1 and tape2)
-     * @param tape1 must point at its last element
-     * @param tape2 must point at its last element
-     * @param tape3 must point at beginning of the tape
-     * @param tape4 must point at beginning of the tape
-     * @return number of iterations of the algorithm
-     */
-    size_t merge_sort(size_t n_elems, size_t cutoff,
-                    basic_tape* tape1, basic_tape* tape2,
-                    basic_tape* tape3, basic_tape* tape4) {
-
-        auto n_steps = 1;
-        auto block_size = cutoff;
-        auto n_blocks = (n_elems + cutoff - 1) / cutoff;
+     * @param tapes the tapes taking part in the sort
+     * @param state the state after the last performed step: tape1 and tape2 (see state.roles)
+     * must point at their last elements, tape3 and tape4 must point at beginning.
+     * It is updated after each step.
+     * @param ring_size if not zero, pipelined_merge with rings of this size is used instead of merge
+     * @param chunk_size if not zero (and ring_size is zero), chunked_merge with chunks of this size is used
+     * @param memory resource for the buffers of merges
+     * @param timer records each step as a "merge" phase
+     * @param on_step called after each step with the updated state
+     */
+    template <tape_element T>
+    void merge_sort(size_t n_elems, std::array<typed_tape<T>*, 4> const& tapes, merge_sort_state& state,
+                    size_t ring_size, size_t chunk_size, std::pmr::memory_resource* memory, phase_timer& timer,
+                    std::function<void(merge_sort_state const&)> const& on_step) {
+        auto& [n_runs, block_size, n_blocks, n_steps, roles, lengths] = state;
         while (block_size < n_elems) { // log(n) merges
+            auto* tape1 = tapes[roles[0]];
+            auto* tape2 = tapes[roles[1]];
 
             auto n_layers = (n_blocks + 1) / 2; // also equals n_blocks on the next step
             bool first_write_to_tape3 = n_layers % 2 || (n_steps % 2 == 0);
-            merge(tape1, tape2,
-                  (first_write_to_tape3 ? tape3 : tape4), (first_write_to_tape3 ? tape4 : tape3),
-                  n_layers, (n_steps % 2 ? 0 : n_layers - 1),
-                  n_elems, n_blocks, block_size, n_steps % 2);
+            auto dst1_id = first_write_to_tape3 ? roles[2] : roles[3];
+            auto dst2_id = first_write_to_tape3 ? roles[3] : roles[2];
+            auto* dst1 = tapes[dst1_id];
+            auto* dst2 = tapes[dst2_id];
+            auto last_layer_id = n_steps % 2 ? 0 : n_layers - 1;
+            if (ring_size != 0) {
+                pipelined_merge(tape1, tape2, dst1, dst2, n_layers, last_layer_id,
+                                n_elems, n_blocks, block_size, n_steps % 2, ring_size, memory);
+            } else if (chunk_size != 0) {
+                chunked_merge(tape1, tape2, dst1, dst2, n_layers, last_layer_id,
+                              n_elems, n_blocks, block_size, n_steps % 2, chunk_size, memory);
+            } else {
+                merge(tape1, tape2, dst1, dst2, n_layers, last_layer_id,
+                      n_elems, n_blocks, block_size, n_steps % 2);
+            }
+            timer.finish("merge");
 
-            std::swap(tape1, tape3);
-            std::swap(tape2, tape4);
+            lengths = {};
+            for (size_t i = 0; i < n_layers; ++i) {
+                auto [left, right] = layer_sizes(i, last_layer_id, n_elems, n_blocks, block_size);
+                lengths[i % 2 == 0 ? dst1_id : dst2_id] += left + right;
+            }
+            std::swap(roles[0], roles[2]);
+            std::swap(roles[1], roles[3]);
             block_size *= 2;
             n_blocks = n_layers;
             n_steps++;
+            on_step(state);
         }
-        return n_steps;
     }
 
     /**
-     * Splits the source tape into two tapes as evenly as possible.
-     * Writes to the dst tapes by sorted blocks of size `cutoff`.
-     * The number of elements on the dst1 tape is guaranteed to be not less than
-     * the number of elements on the dst2.
+     * Splits the source tape into several tapes as evenly as possible.
+     * Writes to the dst tapes by sorted (in ascending order) blocks of size `cutoff`:
+     * i-th block is written to dst[i % dst.size()].
+     * The number of elements on the dst[i] tape is guaranteed to be not less than
+     * the number of elements on the dst[i + 1].
+     * Each dst tape points at its last written element after the split.
      * @param src
      * @param n_elems
      * @param cutoff
-     * @param dst1
-     * @param dst2
+     * @param dst
+     * @param memory resource for the block
+     * @return sizes of the blocks in order of writing
      */
-    void split_tape(basic_tape const& src, size_t n_elems, size_t cutoff,
-                    basic_tape* dst1, basic_tape* dst2) {
+    template <tape_element T>
+    std::vector<size_t> split_tape(typed_tape<T> const& src, size_t n_elems, size_t cutoff,
+                                   std::vector<typed_tape<T>*> const& dst, std::pmr::memory_resource* memory) {
         auto n_blocks = (n_elems + cutoff - 1) / cutoff;
-        auto block_in_ram = std::vector<int>(cutoff);
+        auto block_in_ram = std::pmr::vector<T>(std::min(cutoff, n_elems), memory);
+        auto runs = std::vector<size_t>();
+        runs.reserve(n_blocks);
         for (size_t i = 0, nb = 0; i < n_elems; i += cutoff, ++nb) {
-            for (size_t j = 0; j < cutoff && i + j < n_elems; ++j) {
-                block_in_ram[j] = src.read();
-                src.move_right();
-            }
             if (i + cutoff >= n_elems) {
                 block_in_ram.resize(n_elems - i);
             }
-            std::sort(block_in_ram.begin(), block_in_ram.end());
-            bulk_write(block_in_ram, *dst1);
-            if (nb + 2 < n_blocks) {
-                dst1->move_right();
+            src.read_n(block_in_ram, direction::right);
+            src.move_right();
+            sort_block<T>(block_in_ram);
+            auto* tape = dst[nb % dst.size()];
+            tape->write_n(block_in_ram, direction::right);
+            if (nb + dst.size() < n_blocks) {
+                tape->move_right();
             }
-            std::swap(dst1, dst2);
+            runs.push_back(block_in_ram.size());
         }
+        return runs;
+    }
+
+    /**
+     * Sorts `data` in place using up to `n_threads` threads:
+     * the range is partitioned around its median, and the halves are sorted concurrently by sort_block.
+     * Records are not partitioned (it would reorder equal keys): the halves are sorted as is and merged stably.
+     */
+    template <tape_element T>
+    void parallel_sort(std::span<T> data, size_t n_threads) {
+        constexpr size_t min_parallel_size = 1 << 15;
+        if (n_threads <= 1 || data.size() < min_parallel_size) {
+            sort_block(data);
+            return;
+        }
+        auto half = data.size() / 2;
+        auto middle = data.begin() + static_cast<std::ptrdiff_t>(half);
+        if constexpr (!element_traits<T>::has_payload) {
+            std::nth_element(data.begin(), middle, data.end(), element_less<T>());
+        }
+        auto worker = std::thread(parallel_sort<T>, data.first(half), n_threads / 2);
+        parallel_sort(data.subspan(half), n_threads - n_threads / 2);
+        worker.join();
+        if constexpr (element_traits<T>::has_payload) {
+            std::inplace_merge(data.begin(), middle, data.end(), element_less<T>());
+        }
+    }
+
+    /**
+     * Same as split_tape, but reading, sorting and writing of blocks are overlapped:
+     * a reader thread fills block i+1 while the calling thread sorts block i (see parallel_sort)
+     * and a writer thread writes block i-1. Three buffers of `block_size` elements rotate between the stages.
+     * An exception thrown in any stage stops the pipeline and is rethrown to the caller.
+     * @param src
+     * @param n_elems
+     * @param block_size
+     * @param dst
+     * @param n_threads number of threads used to sort a block
+     * @param memory resource for the buffers
+     * @return sizes of the blocks in order of writing
+     */
+    template <tape_element T>
+    std::vector<size_t> pipelined_split_tape(typed_tape<T> const& src, size_t n_elems, size_t block_size,
+                                             std::vector<typed_tape<T>*> const& dst, size_t n_threads,
+                                             std::pmr::memory_resource* memory) {
+        constexpr size_t n_buffers = 3;
+        struct block {
+            size_t buffer_id;
+            size_t size;
+        };
+
+        auto n_blocks = (n_elems + block_size - 1) / block_size;
+        auto buffers = std::vector<std::pmr::vector<T>>();
+        buffers.reserve(n_buffers);
+        auto free_buffers = blocking_queue<size_t>(n_buffers);
+        auto read_blocks = blocking_queue<block>(n_buffers);
+        auto sorted_blocks = blocking_queue<block>(n_buffers);
+        for (size_t i = 0; i < n_buffers; ++i) {
+            buffers.emplace_back(std::min(block_size, n_elems), memory);
+            free_buffers.push(i);
+        }
+
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        auto fail = [&] {
+            {
+                std::lock_guard lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+            free_buffers.cancel();
+            read_blocks.cancel();
+            sorted_blocks.cancel();
+        };
+        auto data = [&](block const& b) {
+            return std::span(buffers[b.buffer_id]).first(b.size);
+        };
+
+        auto reader = std::thread([&] {
+            try {
+                for (size_t i = 0; i < n_elems; i += block_size) {
+                    auto id = free_buffers.pop();
+                    if (!id) {
+                        return;
+                    }
+                    auto b = block{ *id, std::min(block_size, n_elems - i) };
+                    src.read_n(data(b), direction::right);
+                    src.move_right();
+                    if (!read_blocks.push(b)) {
+                        return;
+                    }
+                }
+                read_blocks.close();
+            } catch (...) {
+                fail();
+            }
+        });
+        auto writer = std::thread([&] {
+            try {
+                for (size_t nb = 0; nb < n_blocks; ++nb) {
+                    auto b = sorted_blocks.pop();
+                    if (!b) {
+                        return;
+                    }
+                    auto* tape = dst[nb % dst.size()];
+                    tape->write_n(data(*b), direction::right);
+                    if (nb + dst.size() < n_blocks) {
+                        tape->move_right();
+                    }
+                    free_buffers.push(b->buffer_id);
+                }
+            } catch (...) {
+                fail();
+            }
+        });
+
+        auto runs = std::vector<size_t>();
+        runs.reserve(n_blocks);
+        try {
+            while (auto b = read_blocks.pop()) {
+                parallel_sort(data(*b), n_threads);
+                runs.push_back(b->size);
+                if (!sorted_blocks.push(*b)) {
+                    break;
+                }
+            }
+            sorted_blocks.close();
+        } catch (...) {
+            fail();
+        }
+        reader.join();
+        writer.join();
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return runs;
+    }
+
+    /**
+     * Reads a tape from left to right by chunks.
+     */
+    template <tape_element T>
+    class chunk_reader {
+    public:
+        /**
+         * @param src tape to read, must point at the first element to read
+         * @param n_elems number of elements to read
+         * @param chunk_size number of elements to read at once. Zero means reading element by element.
+         * @param memory resource for the chunk
+         */
+        chunk_reader(typed_tape<T> const& src, size_t n_elems, size_t chunk_size, std::pmr::memory_resource* memory)
+                : src(src), remaining(n_elems), buf(chunk_size, memory) {}
+
+        [[nodiscard]] bool empty() const {
+            return remaining == 0;
+        }
+
+        T next() {
+            remaining--;
+            if (buf.empty()) {
+                auto res = src.read();
+                src.move_right();
+                return res;
+            }
+            if (next_id == filled) {
+                filled = std::min(buf.size(), remaining + 1);
+                src.read_n(std::span(buf).first(filled), direction::right);
+                src.move_right();
+                next_id = 0;
+            }
+            return buf[next_id++];
+        }
+
+    private:
+        typed_tape<T> const& src;
+        size_t remaining;
+        std::pmr::vector<T> buf;
+        size_t next_id = 0;
+        size_t filled = 0;
+    };
+
+    /**
+     * Writes runs to dst tapes: i-th run is written to dst[i % dst.size()].
+     * The head of a tape is moved right only before writing the next element,
+     * so each tape points at its last written element.
+     */
+    template <tape_element T>
+    class run_writer {
+    public:
+        explicit run_writer(std::vector<typed_tape<T>*> const& dst) : dst(dst), used(dst.size()) {}
+
+        void write(T data) {
+            auto id = runs.size() % dst.size();
+            if (used[id]) {
+                dst[id]->move_right();
+            }
+            used[id] = true;
+            dst[id]->write(data);
+            run_len++;
+        }
+
+        /**
+         * Writes consecutive elements of the current run at once.
+         */
+        void write_n(std::span<T const> data) {
+            if (data.empty()) {
+                return;
+            }
+            auto id = runs.size() % dst.size();
+            if (used[id]) {
+                dst[id]->move_right();
+            }
+            used[id] = true;
+            dst[id]->write_n(data, direction::right);
+            run_len += data.size();
+        }
+
+        void finish_run() {
+            if (run_len > 0) {
+                runs.push_back(run_len);
+                run_len = 0;
+            }
+        }
+
+        /**
+         * @return lengths of the written runs in order of writing
+         */
+        std::vector<size_t> finish() {
+            finish_run();
+            return std::move(runs);
+        }
+
+    private:
+        std::vector<typed_tape<T>*> const& dst;
+        std::vector<bool> used;
+        std::vector<size_t> runs;
+        size_t run_len = 0;
+    };
+
+    /**
+     * Splits the source tape into sorted (in ascending order) runs using replacement selection.
+     * A min-heap of elements is kept in RAM; the least element is written to the current run
+     * and replaced with the next element of src. If the next element is less than the written one,
+     * it is put aside (in the same array) for the next run. The run ends when the heap becomes empty.
+     * For random input the runs are twice as long as the heap on average;
+     * partially sorted input produces much longer runs.
+     * i-th run is written to dst[i % dst.size()], each dst tape points at its last written element after the split.
+     * @param src
+     * @param n_elems
+     * @param cutoff number of elements that can be stored in RAM
+     * @param dst
+     * @param memory resource for the heap and the chunk
+     * @return sizes of the runs in order of writing
+     */
+    template <tape_element T>
+    std::vector<size_t> replacement_selection(typed_tape<T> const& src, size_t n_elems, size_t cutoff,
+                                              std::vector<typed_tape<T>*> const& dst,
+                                              std::pmr::memory_resource* memory) {
+        // a small part of memory is used to read src by chunks
+        auto chunk_size = std::min<size_t>(4096, cutoff / 8);
+        auto reader = chunk_reader(src, n_elems, chunk_size, memory);
+        auto writer = run_writer(dst);
+
+        // heap[0..h) is the heap of the current run, heap[h..used) are the elements of the next run
+        auto heap = std::pmr::vector<T>(std::min(cutoff - chunk_size, n_elems), memory);
+        for (T& e : heap) {
+            e = reader.next();
+        }
+        auto h = heap.size();
+        auto used = heap.size();
+        auto cmp = element_greater<T>();
+        std::make_heap(heap.begin(), heap.end(), cmp);
+        while (h > 0) {
+            std::pop_heap(heap.begin(), heap.begin() + static_cast<std::ptrdiff_t>(h), cmp);
+            auto e = heap[h - 1];
+            writer.write(e);
+            if (!reader.empty()) {
+                auto next = reader.next();
+                if (!element_traits<T>::less(next, e)) {
+                    heap[h - 1] = next;
+                    std::push_heap(heap.begin(), heap.begin() + static_cast<std::ptrdiff_t>(h), cmp);
+                } else {
+                    heap[--h] = next;
+                }
+            } else {
+                heap[h - 1] = heap[used - 1];
+                used--;
+                h--;
+            }
+            if (h == 0) {
+                writer.finish_run();
+                h = used;
+                std::make_heap(heap.begin(), heap.begin() + static_cast<std::ptrdiff_t>(h), cmp);
+            }
+        }
+        return writer.finish();
+    }
+
+    /**
+     * @return whether `block` is sorted in descending order and can be reversed to be sorted in ascending order.
+     * Records must be strictly descending: reversing equal keys would change their order.
+     */
+    template <tape_element T>
+    bool reversible(std::span<T const> block) {
+        if constexpr (element_traits<T>::has_payload) {
+            return std::adjacent_find(block.begin(), block.end(), [](T const& a, T const& b) {
+                return !element_traits<T>::less(b, a);
+            }) == block.end();
+        } else {
+            return std::is_sorted(block.begin(), block.end(), element_greater<T>());
+        }
+    }
+
+    /**
+     * Splits the source tape into sorted (in ascending order) runs reusing the order which is already present in src.
+     * src is read by blocks of `memory` elements. A block sorted in descending order is reversed,
+     * and an unsorted block is sorted. If the first element of the sorted block is not less than
+     * the last element of the current run, the block extends the run, so presorted input gives runs
+     * much longer than `memory`, and sorted input gives a single run.
+     * A run which ends inside an unsorted block is extended by the ascending prefix of the block,
+     * and the rest of the block is sorted and starts the next run, so runs are not split at block boundaries.
+     * Descending runs are only detected within a block.
+     * i-th run is written to dst[i % dst.size()], each dst tape points at its last written element after the split.
+     * @param src
+     * @param n_elems
+     * @param cutoff number of elements that can be stored in RAM
+     * @param dst
+     * @param memory resource for the block
+     * @return sizes of the runs in order of writing
+     */
+    template <tape_element T>
+    std::vector<size_t> natural_runs(typed_tape<T> const& src, size_t n_elems, size_t cutoff,
+                                     std::vector<typed_tape<T>*> const& dst, std::pmr::memory_resource* memory) {
+        auto writer = run_writer(dst);
+        auto block = std::pmr::vector<T>(std::min(cutoff, n_elems), memory);
+        std::optional<T> last;
+        for (size_t i = 0; i < n_elems; i += block.size()) {
+            if (i + block.size() > n_elems) {
+                block.resize(n_elems - i);
+            }
+            src.read_n(block, direction::right);
+            src.move_right();
+            if (reversible<T>(block)) {
+                std::reverse(block.begin(), block.end());
+            } else if (auto ascending = std::is_sorted_until(block.begin(), block.end(), element_less<T>());
+                       ascending != block.end()) {
+                auto rest = std::span<T>(ascending, block.end());
+                sort_block<T>(rest);
+                if (last && !element_traits<T>::less(block.front(), *last) &&
+                    element_traits<T>::less(rest.front(), *last)) {
+                    // the run continues into the block and ends inside it: the ascending prefix extends the run,
+                    // and the sorted rest of the block starts the next one
+                    writer.write_n(std::span<T const>(block.begin(), ascending));
+                    writer.finish_run();
+                    writer.write_n(rest);
+                    last = rest.back();
+                    continue;
+                }
+                sort_block<T>(block);
+            }
+            if (last && element_traits<T>::less(block.front(), *last)) {
+                writer.finish_run();
+            }
+            writer.write_n(block);
+            last = block.back();
+        }
+        return writer.finish();
+    }
+
+    /**
+     * Merges groups of runs from k src tapes into single runs on k dst tapes.
+     * Run j is stored on src[j % k]. By default, src tapes are scanned from right to left,
+     * so the groups are merged starting from the last one,
+     * and merged runs are written from left to right in the reversed order of groups.
+     * Runs on src tapes are read backwards, so if they are sorted in ascending order,
+     * the merged runs are sorted in descending order, and vice versa.
+     * If `read_dir` is direction::right, src tapes are scanned from left to right,
+     * the groups are merged in order and the merged runs keep the order of elements.
+     * The merge is stable. Reading right, the runs of a group on lower src tapes precede the others in the input.
+     * Reading left, the order of runs is reversed by each pass, and a descending run is the reversed stable order,
+     * so in either case ties are taken from the higher src tape first.
+     * @tparam Compare ordering of the elements in the merged runs
+     * @param runs lengths of runs on src tapes in order of writing
+     * @param src tapes with runs, each must point at its last element (or at the first one if reading right)
+     * @param dst tapes for merged runs, each must point at the beginning
+     * @param read_dir direction of scanning src tapes
+     * @param limit max length of a merged run: the rest of the group can't reach its first `limit` elements,
+     * so it is skipped
+     * @return lengths of merged runs in order of writing
+     */
+    template <typename Compare, tape_element T>
+    std::vector<size_t> kway_merge(std::vector<size_t> const& runs,
+                                   std::vector<typed_tape<T>*> const& src, std::vector<typed_tape<T>*> const& dst,
+                                   direction read_dir = direction::left,
+                                   size_t limit = std::numeric_limits<size_t>::max()) {
+        auto k = src.size();
+        auto n_groups = (runs.size() + k - 1) / k;
+        auto merged = std::vector<size_t>(n_groups);
+        auto remaining = std::vector<size_t>(k);
+        auto tree = loser_tree<T, Compare>(k);
+        // ties in the tree are won by lower sources, which stand for src tapes in the order of preference
+        auto source = [k, read_dir](size_t t) {
+            return read_dir == direction::right ? t : k - 1 - t;
+        };
+        for (size_t out_id = 0; out_id < n_groups; ++out_id) {
+            auto g = read_dir == direction::right ? out_id : n_groups - 1 - out_id;
+            size_t total = 0;
+            for (size_t t = 0; t < k; ++t) {
+                auto j = g * k + t;
+                remaining[t] = j < runs.size() ? runs[j] : 0;
+                total += remaining[t];
+                if (remaining[t] > 0) {
+                    tree.set(source(t), src[t]->read());
+                } else {
+                    tree.reset(source(t));
+                }
+            }
+            tree.build();
+
+            auto* out = dst[out_id % k];
+            bool last_run_on_tape = out_id + k >= n_groups;
+            auto n_out = std::min(total, limit);
+            for (size_t written = 0; written < n_out; ++written) {
+                auto t = source(tree.winner());
+                out->write(tree.top());
+                if (written + 1 < n_out || !last_run_on_tape) {
+                    out->move_right();
+                }
+                src[t]->move(read_dir);
+                if (--remaining[t] > 0) {
+                    tree.replace(src[t]->read());
+                } else {
+                    tree.pop();
+                }
+            }
+            if (n_out < total) {
+                // each src tape points at the current element of its run
+                for (size_t t = 0; t < k; ++t) {
+                    src[t]->move_n(remaining[t], read_dir);
+                }
+            }
+            merged[out_id] = n_out;
+        }
+        return merged;
+    }
+
+    /**
+     * Performs balanced k-way merge sort. On each step, groups of k runs from k src tapes
+     * are merged into single runs which are distributed among the other k tapes (see kway_merge);
+     * then src and dst tapes swap their roles.
+     * As in merge_sort, no rewinds are needed: the order of elements alternates between steps.
+     * @param runs lengths of sorted runs on src tapes in order of writing (run j is stored on src[j % k])
+     * @param src k tapes with runs, each must point at its last element
+     * @param dst k tapes, each must point at the beginning
+     * @param ascending whether runs on src are sorted in ascending order
+     * @param timer records each step as a "merge" phase
+     * @return the tape which stores all the elements and whether they are sorted in ascending order
+     */
+    template <tape_element T>
+    std::pair<typed_tape<T>*, bool> kway_merge_sort(std::vector<size_t> runs,
+                                                 std::vector<typed_tape<T>*> src, std::vector<typed_tape<T>*> dst,
+                                                 bool ascending, phase_timer& timer) {
+        while (runs.size() > 1) {
+            if (ascending) {
+                runs = kway_merge<element_greater<T>>(runs, src, dst);
+            } else {
+                runs = kway_merge<element_less<T>>(runs, src, dst);
+            }
+            timer.finish("merge");
+            std::swap(src, dst);
+            ascending = !ascending;
+        }
+        return { src[0], ascending };
+    }
+
+    /**
+     * Copies `count` elements from `from` to `to` reversing their order.
+     * @param from must point at the last element to copy
+     * @param to must point at the first element to write
+     * @param buffer_size max number of elements which are copied at once
+     * @param memory resource for the buffer
+     */
+    template <tape_element T>
+    void copy_reversed(typed_tape<T> const& from, size_t count, typed_tape<T>& to, size_t buffer_size,
+                       std::pmr::memory_resource* memory) {
+        auto buf = std::pmr::vector<T>(std::min(count, buffer_size), memory);
+        for (size_t i = 0; i < count; i += buf.size()) {
+            auto chunk = std::span(buf).first(std::min(buf.size(), count - i));
+            from.read_n(chunk, direction::left);
+            to.write_n(chunk, direction::right);
+            from.move_left();
+            to.move_right();
+        }
+    }
+
+    /**
+     * Copies `count` elements from `from` to `to` keeping their order.
+     * @param from must point at the first element to copy
+     * @param to must point at the first element to write
+     * @param buffer_size max number of elements which are copied at once
+     * @param memory resource for the buffer
+     */
+    template <tape_element T>
+    void copy_forward(typed_tape<T> const& from, size_t count, typed_tape<T>& to, size_t buffer_size,
+                      std::pmr::memory_resource* memory) {
+        auto buf = std::pmr::vector<T>(std::min(count, buffer_size), memory);
+        for (size_t i = 0; i < count; i += buf.size()) {
+            auto chunk = std::span(buf).first(std::min(buf.size(), count - i));
+            from.read_n(chunk, direction::right);
+            to.write_n(chunk, direction::right);
+            from.move_right();
+            to.move_right();
+        }
+    }
+
+    /**
+     * Same as kway_merge_sort, but before each step the tapes are rewound, and src tapes are read
+     * from left to right (see kway_merge), so the runs always keep the order of `Compare`.
+     * The last step writes the only run directly to `result`.
+     * @tparam Compare order of the elements in the runs (ascending by default)
+     * @param runs lengths of sorted runs on src tapes in order of writing (run j is stored on src[j % k])
+     * @param src k tapes with runs sorted in the order of `Compare`
+     * @param dst k tapes
+     * @param result must point at the first element to write
+     * @param limit max length of a merged run, see kway_merge. Runs on src must not be longer.
+     * @param buffer_size max number of elements which are copied at once if there is only one run
+     * @param memory resource for the copy buffer
+     * @param timer records each step as a "merge" phase and the copy as a "copy" phase
+     */
+    template <typename Compare, tape_element T>
+    void rewinding_merge_sort(std::vector<size_t> runs,
+                              std::vector<typed_tape<T>*> src, std::vector<typed_tape<T>*> dst,
+                              typed_tape<T>& result, size_t limit, size_t buffer_size,
+                              std::pmr::memory_resource* memory, phase_timer& timer) {
+        for (bool dst_used = false;; dst_used = true) {
+            for (auto* tape : src) {
+                tape->rewind();
+            }
+            if (runs.size() == 1) {
+                copy_forward(*src[0], runs[0], result, buffer_size, memory);
+                timer.finish("copy");
+                return;
+            }
+            if (runs.size() <= src.size()) {
+                // the last step produces a single run on dst[0]
+                dst[0] = &result;
+            } else if (dst_used) {
+                for (auto* tape : dst) {
+                    tape->rewind();
+                }
+            }
+            runs = kway_merge<Compare>(runs, src, dst, direction::right, limit);
+            timer.finish("merge");
+            if (runs.size() == 1) {
+                return;
+            }
+            std::swap(src, dst);
+        }
+    }
+
+    /**
+     * @return how many merge passes less than `n_passes` are needed with fixed runs of `cutoff` elements
+     */
+    size_t saved_passes(size_t n_elems, size_t cutoff, size_t k, size_t n_passes) {
+        auto fixed_passes = count_merge_passes((n_elems + cutoff - 1) / cutoff, k);
+        return fixed_passes > n_passes ? fixed_passes - n_passes : 0;
+    }
+
+    /**
+     * Number of sampled elements per partition of sample_sort. More samples give more even partitions.
+     */
+    const size_t SAMPLES_PER_PARTITION = 128;
+
+    /**
+     * Reads a random element of each of equal strides of src: enough of them to choose splitters of
+     * `n_partitions` partitions, but at most `max_samples`. The head of src is returned to the first element.
+     * @return the sample in ascending order
+     */
+    template <tape_element T>
+    std::pmr::vector<T> take_sample(typed_tape<T> const& src, size_t count, size_t n_partitions,
+                                    size_t max_samples, std::pmr::memory_resource* memory) {
+        auto n_samples = std::min({ count, n_partitions * SAMPLES_PER_PARTITION, std::max<size_t>(1, max_samples) });
+        auto sample = std::pmr::vector<T>(memory);
+        sample.reserve(n_samples);
+        std::mt19937_64 gen(count);
+        size_t pos = 0;
+        for (size_t i = 0; i < n_samples; ++i) {
+            auto stride_begin = i * count / n_samples;
+            auto stride_end = (i + 1) * count / n_samples;
+            auto target = std::uniform_int_distribution<size_t>(stride_begin, stride_end - 1)(gen);
+            src.move_n(target - pos, direction::right);
+            pos = target;
+            sample.push_back(src.read());
+        }
+        src.move_n(pos, direction::left);
+        std::sort(sample.begin(), sample.end(), element_less<T>());
+        return sample;
+    }
+
+    /**
+     * Chooses splitters of `n_partitions` partitions of equal size by the sample (see take_sample).
+     * @return n_partitions-1 splitters in ascending order
+     */
+    template <tape_element T>
+    std::pmr::vector<T> choose_splitters(std::pmr::vector<T> const& sample, size_t n_partitions,
+                                         std::pmr::memory_resource* memory) {
+        auto splitters = std::pmr::vector<T>(memory);
+        splitters.reserve(n_partitions - 1);
+        for (size_t i = 1; i < n_partitions; ++i) {
+            splitters.push_back(sample[i * sample.size() / n_partitions]);
+        }
+        return splitters;
+    }
+
+    /**
+     * Estimates the sizes of the parts of `count` elements split by the splitters (see distribute)
+     * by the shares of the sample which fall into the parts. The estimates have a margin for the error
+     * of sampling, so a part rarely outgrows its estimate.
+     */
+    template <tape_element T>
+    std::vector<size_t> estimate_part_sizes(std::pmr::vector<T> const& sample, std::pmr::vector<T> const& splitters,
+                                            size_t count) {
+        auto estimates = std::vector<size_t>();
+        auto part_begin = sample.begin();
+        for (size_t p = 0; p <= splitters.size(); ++p) {
+            auto part_end = p == splitters.size() ? sample.end()
+                                                  : std::lower_bound(part_begin, sample.end(), splitters[p],
+                                                                     element_less<T>());
+            auto n = static_cast<size_t>(part_end - part_begin);
+            auto estimate = (n * count + sample.size() - 1) / sample.size();
+            estimates.push_back(std::min(count, estimate + estimate / 4 + 1));
+            part_begin = part_end;
+        }
+        return estimates;
+    }
+
+    /**
+     * Tapes of a part of distribute(). The first tape is created when the first element is routed to the part,
+     * with the estimated size of the part. If the part outgrows its tapes, a tape of their total size is added.
+     */
+    template <tape_element T>
+    struct part_tapes {
+        std::vector<std::unique_ptr<typed_tape<T>>> tapes;
+        std::vector<size_t> capacities; // sizes of the tapes
+        size_t capacity = 0;            // total size of the tapes
+        size_t size = 0;                // number of elements of the part
+    };
+
+    /**
+     * Distributes `count` elements of src among parts by the splitters:
+     * an element goes to the part whose index is the number of splitters not greater than it.
+     * src is read by chunks of at most `buffer_size` elements.
+     * @param src must point at the first element to distribute
+     * @param splitters splitters in ascending order
+     * @param estimates estimated sizes of splitters.size()+1 parts, see estimate_part_sizes
+     * @param part_factory returns the factory of the tapes of the given part
+     * @param memory resource for the buffer
+     * @return the parts. Each tape of a part points at its last written element.
+     */
+    template <tape_element T, typename PartFactory>
+    std::vector<part_tapes<T>> distribute(typed_tape<T> const& src, size_t count,
+                                          std::pmr::vector<T> const& splitters, std::vector<size_t> const& estimates,
+                                          PartFactory const& part_factory, size_t buffer_size,
+                                          std::pmr::memory_resource* memory) {
+        auto parts = std::vector<part_tapes<T>>(splitters.size() + 1);
+        auto buf = std::pmr::vector<T>(std::min(count, buffer_size), memory);
+        for (size_t i = 0; i < count; i += buf.size()) {
+            auto chunk = std::span(buf).first(std::min(buf.size(), count - i));
+            src.read_n(chunk, direction::right);
+            src.move_right();
+            for (size_t j = 0; j < chunk.size(); ++j) {
+                auto e = chunk[j];
+                auto p = std::upper_bound(splitters.begin(), splitters.end(), e, element_less<T>()) - splitters.begin();
+                auto& part = parts[p];
+                if (part.size == part.capacity) {
+                    // no more than the rest of src can be routed to the part
+                    auto n = std::clamp<size_t>(part.tapes.empty() ? estimates[p] : part.capacity, 1, count - i - j);
+                    part.tapes.push_back(part_factory(p)(n));
+                    part.capacities.push_back(n);
+                    part.capacity += n;
+                } else {
+                    part.tapes.back()->move_right();
+                }
+                part.tapes.back()->write(e);
+                part.size++;
+            }
+        }
+        return parts;
+    }
+
+    /**
+     * Makes a single tape of a part of distribute(): if the part is stored on several tapes,
+     * they are copied (by chunks of at most `buffer_size` elements) to a new tape of `factory` and released.
+     * @param memory resource for the copy buffer
+     * @return the tape with the elements of the part, pointing at the first one
+     */
+    template <tape_element T>
+    std::unique_ptr<typed_tape<T>> join_part(part_tapes<T>& part, typed_tape_factory<T> const& factory,
+                                             size_t buffer_size, std::pmr::memory_resource* memory) {
+        if (part.tapes.size() == 1) {
+            auto tape = std::move(part.tapes.front());
+            part.tapes.clear();
+            tape->rewind();
+            return tape;
+        }
+        auto joined = factory(part.size);
+        auto left = part.size;
+        for (size_t i = 0; i < part.tapes.size(); ++i) {
+            auto n = std::min(left, part.capacities[i]);
+            part.tapes[i]->rewind();
+            copy_forward(*part.tapes[i], n, *joined, buffer_size, memory);
+            // the tape's file can be reused by the following tapes
+            part.tapes[i].reset();
+            left -= n;
+        }
+        part.tapes.clear();
+        joined->rewind();
+        return joined;
+    }
+
+    /**
+     * Max number of distribution passes over an element. Larger buckets are sorted by the merge engine.
+     */
+    const size_t MAX_DISTRIBUTION_PASSES = 2;
+
+    /**
+     * Max number of buckets of a distribution pass chosen automatically (see sort_options::n_buckets).
+     */
+    const size_t MAX_AUTO_BUCKETS = 256;
+
+    /**
+     * @return whether `a` and `b` are equal in the order of element_traits::less
+     */
+    template <tape_element T>
+    bool equivalent(T a, T b) {
+        return !element_traits<T>::less(a, b) && !element_traits<T>::less(b, a);
+    }
+
+    /**
+     * @return whether [lo, hi) contains a single key (unset bounds are unbounded)
+     */
+    template <tape_element T>
+    bool single_key(std::optional<T> lo, std::optional<T> hi) {
+        if (!lo) {
+            return false;
+        }
+        auto next = next_element(*lo);
+        return next ? hi && equivalent(*next, *hi) : !hi;
+    }
+
+    /**
+     * Chooses splitters of a distribution pass over `count` elements of src, all of which are less than `hi`
+     * (if it is set).
+     * A key which is chosen several times is frequent, so the next key is added as a splitter too:
+     * the key gets a bucket of its own, which needs no sorting.
+     * The head of src is returned to the first element.
+     * @param estimates set to the estimated sizes of the buckets, see estimate_part_sizes
+     * @return splitters in ascending order without duplicates
+     */
+    template <tape_element T>
+    std::pmr::vector<T> choose_bucket_splitters(typed_tape<T> const& src, size_t count, std::optional<T> hi,
+                                                sort_options const& options, std::vector<size_t>& estimates) {
+        auto n_buckets = options.n_buckets;
+        if (n_buckets == 0) {
+            n_buckets = std::clamp<size_t>(2 * ((count + options.cutoff - 1) / options.cutoff), 2, MAX_AUTO_BUCKETS);
+        }
+        auto sample = take_sample(src, count, std::max<size_t>(n_buckets, 2), options.cutoff, options.memory);
+        auto splitters = choose_splitters(sample, std::max<size_t>(n_buckets, 2), options.memory);
+        // room for the next keys of the frequent ones
+        splitters.reserve(2 * splitters.size());
+        for (size_t i = 1, n = splitters.size(); i < n; ++i) {
+            if (!equivalent(splitters[i], splitters[i - 1])) {
+                continue;
+            }
+            auto next = next_element(splitters[i]);
+            if (next && (!hi || element_traits<T>::less(*next, *hi))) {
+                splitters.push_back(*next);
+            }
+        }
+        std::sort(splitters.begin(), splitters.end(), element_less<T>());
+        splitters.erase(std::unique(splitters.begin(), splitters.end(), equivalent<T>), splitters.end());
+        estimates = estimate_part_sizes(sample, splitters, count);
+        return splitters;
+    }
+
+    /**
+     * Sorts `count` elements of src, all of which are in [lo, hi), and writes them to dst (see sort_engine::distribution).
+     * Unset `lo` and `hi` mean that the range is not bounded from that side.
+     * - a bucket of a single key is written as is;
+     * - a bucket which fits into `cutoff` is sorted in RAM;
+     * - a bucket which was distributed MAX_DISTRIBUTION_PASSES times is sorted by the merge engine
+     *   to a temporary tape and copied to dst;
+     * - otherwise, the bucket is distributed into smaller buckets, which are sorted in order of their keys.
+     * @param src must point at the first element to sort
+     * @param dst must point at the first element to write. After the call, it points after the last written element
+     * (or at it, if it is the last element of dst)
+     * @param depth number of distribution passes made over the elements of src
+     * @param timer records the first distribution pass if depth is zero
+     */
+    template <tape_element T>
+    void distribution_sort(typed_tape<T> const& src, size_t count, std::optional<T> lo, std::optional<T> hi,
+                           typed_tape<T>& dst, size_t depth, sort_options const& options,
+                           typed_tape_factory<T> const& factory, sort_report& report, phase_timer& timer) {
+        if (single_key(lo, hi)) {
+            if constexpr (element_traits<T>::has_payload) {
+                copy_forward(src, count, dst, options.cutoff, options.memory);
+            } else {
+                auto buf = std::pmr::vector<T>(std::min(count, options.cutoff), *lo, options.memory);
+                for (size_t i = 0; i < count; i += buf.size()) {
+                    dst.write_n(std::span(buf).first(std::min(buf.size(), count - i)), direction::right);
+                    dst.move_right();
+                }
+            }
+            report.n_runs++;
+            return;
+        }
+        if (count <= options.cutoff) {
+            auto buf = std::pmr::vector<T>(count, options.memory);
+            src.read_n(buf, direction::right);
+            sort_block<T>(buf);
+            dst.write_n(buf, direction::right);
+            dst.move_right();
+            report.n_runs++;
+            return;
+        }
+        if (depth == MAX_DISTRIBUTION_PASSES) {
+            auto merge_options = options;
+            merge_options.engine = sort_engine::merge;
+            auto sorted = factory(count);
+            auto merge_report = sort(src, count, *sorted, merge_options, factory);
+            sorted->rewind();
+            copy_forward(*sorted, count, dst, options.cutoff, options.memory);
+            report.n_runs += merge_report.n_runs;
+            report.n_passes = std::max(report.n_passes, merge_report.n_passes);
+            report.n_merged_buckets++;
+            return;
+        }
+
+        auto estimates = std::vector<size_t>();
+        auto splitters = choose_bucket_splitters(src, count, hi, options, estimates);
+        auto buckets = distribute(src, count, splitters, estimates, [&](size_t) -> auto const& { return factory; },
+                                  options.cutoff, options.memory);
+        report.n_distribution_passes = std::max(report.n_distribution_passes, depth + 1);
+        if (depth == 0) {
+            timer.finish("distribute");
+        }
+        for (size_t i = 0; i < buckets.size(); ++i) {
+            if (buckets[i].size != 0) {
+                auto bucket_lo = i == 0 ? lo : splitters[i - 1];
+                auto bucket_hi = i == splitters.size() ? hi : splitters[i];
+                auto bucket = join_part(buckets[i], factory, options.cutoff, options.memory);
+                distribution_sort(*bucket, buckets[i].size, bucket_lo, bucket_hi, dst, depth + 1,
+                                  options, factory, report, timer);
+            } // the bucket's file can be reused by the next buckets
+        }
+    }
+
+    /**
+     * Sorts a block in RAM in the order of `Before` (element_less or element_greater), see sort_block.
+     */
+    template <typename Before, tape_element T>
+    void sort_block_by(std::span<T> data) {
+        if constexpr (std::is_same_v<Before, element_less<T>>) {
+            sort_block(data);
+        } else if constexpr (element_traits<T>::has_payload) {
+            std::stable_sort(data.begin(), data.end(), Before());
+        } else {
+            // equal elements are indistinguishable, so reversing the ascending order is enough
+            sort_block(data);
+            std::reverse(data.begin(), data.end());
+        }
+    }
+
+    /**
+     * Selects the first `top` elements of src in the order of `Before` in a single pass,
+     * keeping at most `capacity` (at least 2*top) elements in RAM.
+     * Elements are collected into a buffer; when it is full, only the first `top` of them are kept,
+     * and the last kept one becomes the bound: the following elements which don't precede it are skipped.
+     * Records are kept by a stable sort, so the earliest of equal keys are selected and keep their order.
+     * @param src must point at the first element
+     * @param memory resource for the buffer and the chunk
+     * @return the selected elements in the order of `Before`
+     */
+    template <typename Before, tape_element T>
+    std::pmr::vector<T> select_top(typed_tape<T> const& src, size_t count, size_t top, size_t capacity,
+                                   size_t chunk_size, std::pmr::memory_resource* memory) {
+        auto before = Before();
+        auto reader = chunk_reader(src, count, chunk_size, memory);
+        auto buf = std::pmr::vector<T>(memory);
+        buf.reserve(std::min(count, capacity));
+        auto keep_top = [&] {
+            if constexpr (element_traits<T>::has_payload) {
+                std::stable_sort(buf.begin(), buf.end(), before);
+            } else {
+                std::nth_element(buf.begin(), buf.begin() + static_cast<std::ptrdiff_t>(top - 1), buf.end(), before);
+            }
+            buf.resize(top);
+        };
+        std::optional<T> bound;
+        while (!reader.empty()) {
+            auto e = reader.next();
+            if (bound && !before(e, *bound)) {
+                continue;
+            }
+            buf.push_back(e);
+            if (buf.size() == capacity) {
+                keep_top();
+                bound = buf.back();
+            }
+        }
+        if (buf.size() > top) {
+            keep_top();
+        }
+        sort_block_by<Before>(std::span(buf));
+        return buf;
+    }
+
+    /**
+     * Sorted run written by pruned_top, summarized by its length and its last element.
+     */
+    template <tape_element T>
+    struct run_summary {
+        T last;
+        size_t size;
+    };
+
+    /**
+     * @return the element such that the runs have at least `top` elements which don't follow it in the order
+     * of `Before`, or null optional if there are less than `top` elements. The elements which don't precede it
+     * and come later in the input can't be among the first `top` elements.
+     */
+    template <typename Before, tape_element T>
+    std::optional<T> top_bound(std::vector<run_summary<T>> runs, size_t top) {
+        std::stable_sort(runs.begin(), runs.end(), [](run_summary<T> const& a, run_summary<T> const& b) {
+            return Before()(a.last, b.last);
+        });
+        size_t covered = 0;
+        for (auto const& run : runs) {
+            covered += run.size;
+            if (covered >= top) {
+                return run.last;
+            }
+        }
+        return {};
+    }
+
+    /**
+     * Number of runs merged at once by pruned_top.
+     */
+    size_t top_k_merge_ways(sort_options const& options) {
+        return std::max<size_t>(2, (options.n_tapes - 1) / 2);
+    }
+
+    /**
+     * Writes the first `top` elements of src in the order of `Before` to dst by a pruned external sort:
+     * blocks of `cutoff` elements are sorted and only their first `top` elements are written as runs;
+     * the elements of later blocks which can't reach the first `top` (see top_bound) are discarded before sorting;
+     * the runs are merged by rewinding k-way merges which write only the first `top` elements of each group
+     * and skip the tails of the runs.
+     * @param src must point at the first element
+     * @param dst must point at the first element to write
+     */
+    template <typename Before, tape_element T>
+    void pruned_top(typed_tape<T> const& src, size_t count, size_t top, typed_tape<T>& dst,
+                    sort_options const& options, typed_tape_factory<T> const& factory, sort_report& report,
+                    phase_timer& timer) {
+        auto before = Before();
+        auto k = top_k_merge_ways(options);
+        auto temp_tapes = std::vector<std::unique_ptr<typed_tape<T>>>();
+        auto group1 = std::vector<typed_tape<T>*>();
+        auto group2 = std::vector<typed_tape<T>*>();
+        for (size_t i = 0; i < 2 * k; ++i) {
+            temp_tapes.push_back(factory(count));
+            (i < k ? group1 : group2).push_back(temp_tapes.back().get());
+        }
+
+        auto writer = run_writer(group1);
+        size_t n_written = 0;
+        {
+            // the block is released before the merges, which take the memory
+            auto summaries = std::vector<run_summary<T>>();
+            std::optional<T> bound;
+            auto block = std::pmr::vector<T>(std::min(options.cutoff, count), options.memory);
+            for (size_t i = 0; i < count; i += options.cutoff) {
+                block.resize(std::min(options.cutoff, count - i));
+                src.read_n(block, direction::right);
+                src.move_right();
+                if (bound) {
+                    std::erase_if(block, [&](T const& e) { return !before(e, *bound); });
+                }
+                sort_block_by<Before>(std::span(block));
+                auto n_kept = std::min(block.size(), top);
+                if (n_kept == 0) {
+                    continue;
+                }
+                writer.write_n(std::span(block).first(n_kept));
+                writer.finish_run();
+                n_written += n_kept;
+                summaries.push_back({ block[n_kept - 1], n_kept });
+                bound = top_bound<Before>(summaries, top);
+            }
+        }
+        report.n_pruned = count - n_written;
+        auto runs = writer.finish();
+        timer.finish("runs");
+        report.n_runs = runs.size();
+        report.n_passes = count_merge_passes(runs.size(), k);
+        rewinding_merge_sort<Before>(std::move(runs), group1, group2, dst, top, options.cutoff, options.memory, timer);
     }
 }
 
-void sort(basic_tape const& src, size_t count, basic_tape& dst, size_t cutoff, tape_factory const& factory) {
+run_generation parse_run_generation(std::string const& name) {
+    if (name == "fixed") {
+        return run_generation::fixed;
+    }
+    if (name == "replacement") {
+        return run_generation::replacement_selection;
+    }
+    if (name == "natural") {
+        return run_generation::natural;
+    }
+    throw std::invalid_argument("unknown run generation '" + name + "', expected 'fixed', 'replacement' or 'natural'");
+}
+
+sort_engine parse_sort_engine(std::string const& name) {
+    if (name == "merge") {
+        return sort_engine::merge;
+    }
+    if (name == "distribution") {
+        return sort_engine::distribution;
+    }
+    throw std::invalid_argument("unknown sort engine '" + name + "'");
+}
+
+size_t count_merge_passes(size_t n_runs, size_t k) {
+    size_t passes = 0;
+    for (; n_runs > 1; n_runs = (n_runs + k - 1) / k) {
+        passes++;
+    }
+    return passes;
+}
+
+sort_footprint estimate_sort_footprint(sort_options const& options) {
+    if (options.engine == sort_engine::distribution) {
+        // the splitters of each nested pass: frequent keys double them, and they are reallocated once
+        // while the sample is alive (see choose_bucket_splitters)
+        auto n_buckets = std::max<size_t>(2, options.n_buckets == 0 ? MAX_AUTO_BUCKETS : options.n_buckets);
+        return { .unbounded_tapes = true, .n_extra_elements = MAX_DISTRIBUTION_PASSES * 3 * n_buckets };
+    }
+    // the shapes of sort()
+    if (options.rewind) {
+        return { .n_temp_tapes = 2 * ((options.n_tapes - 1) / 2) };
+    }
+    if (options.n_tapes < 6 && options.runs == run_generation::fixed) {
+        return { .n_temp_tapes = 3 };
+    }
+    return { .n_temp_tapes = 2 * (options.n_tapes / 2) - 1 };
+}
+
+template <tape_element T>
+std::vector<size_t> generate_runs(typed_tape<T> const& src, size_t count, sort_options const& options,
+                                  std::vector<typed_tape<T>*> const& dst) {
+    if (options.runs == run_generation::replacement_selection && !element_traits<T>::has_payload) {
+        return replacement_selection(src, count, options.cutoff, dst, options.memory);
+    }
+    if (options.runs == run_generation::natural) {
+        return natural_runs(src, count, options.cutoff, dst, options.memory);
+    }
+    if (options.pipelined_split) {
+        auto n_threads = options.n_threads != 0 ? options.n_threads
+                                                : std::max(1u, std::thread::hardware_concurrency());
+        return pipelined_split_tape(src, count, std::max<size_t>(1, options.cutoff / 3), dst, n_threads,
+                                    options.memory);
+    }
+    return split_tape(src, count, options.cutoff, dst, options.memory);
+}
+
+template <tape_element T>
+std::vector<size_t> merge_pass(std::vector<size_t> const& runs, std::vector<typed_tape<T>*> const& src,
+                               std::vector<typed_tape<T>*> const& dst, bool ascending) {
+    if (src.size() != dst.size()) {
+        throw std::invalid_argument("numbers of src and dst tapes must be equal");
+    }
+    return ascending ? kway_merge<element_greater<T>>(runs, src, dst) : kway_merge<element_less<T>>(runs, src, dst);
+}
+
+template <tape_element T>
+sort_report sort(typed_tape<T> const& src, size_t count, typed_tape<T>& dst, sort_options const& options,
+                 std::type_identity_t<typed_tape_factory<T>> const& factory) {
+    auto report = sort_report();
     if (count == 0) {
-        return;
+        return report;
     }
-    if (cutoff == 0) {
+    if (options.cutoff == 0) {
         throw std::invalid_argument("cutoff must be positive integer");
     }
+    if (options.n_tapes < 4) {
+        throw std::invalid_argument("at least 4 tapes are required");
+    }
+    bool checkpoints = !options.checkpoint.empty();
+    if (options.resume && !checkpoints) {
+        throw std::invalid_argument("a checkpoint file is required to resume");
+    }
+    if (checkpoints && (options.rewind || options.n_tapes >= 6 || options.runs != run_generation::fixed
+                        || options.engine != sort_engine::merge)) {
+        throw std::invalid_argument("checkpoints are supported only by 2-way merge sort with fixed runs");
+    }
+    auto timer = phase_timer(report.phases);
 
-    auto tt1 = factory(count);
-    auto tt2 = factory(count);
-    auto tt3 = factory(count);
+    if (options.engine == sort_engine::distribution) {
+        distribution_sort<T>(src, count, std::nullopt, std::nullopt, dst, 0, options, factory, report, timer);
+        timer.finish("buckets");
+        return report;
+    }
 
-    split_tape(src, count, cutoff, &dst, tt1.get());
-    auto n_steps = merge_sort(count, cutoff, &dst, tt1.get(), tt2.get(), tt3.get());
-    if (n_steps % 2 == 0) {
-        // sorted data is stored in tt2 but reversed
-        for (size_t i = 0; i < count; ++i) {
-            dst.write(tt2->read());
-            tt2->move_left();
-            dst.move_right();
+    if (options.rewind) {
+        if (options.n_tapes < 5) {
+            throw std::invalid_argument("at least 5 tapes are required for rewinding merge");
+        }
+        auto k = (options.n_tapes - 1) / 2;
+        auto temp_tapes = std::vector<std::unique_ptr<typed_tape<T>>>();
+        auto group1 = std::vector<typed_tape<T>*>();
+        auto group2 = std::vector<typed_tape<T>*>();
+        for (size_t i = 0; i < 2 * k; ++i) {
+            temp_tapes.push_back(factory(count));
+            (i < k ? group1 : group2).push_back(temp_tapes.back().get());
         }
+        auto runs = generate_runs(src, count, options, group1);
+        timer.finish("runs");
+        report.n_runs = runs.size();
+        report.n_passes = count_merge_passes(runs.size(), k);
+        rewinding_merge_sort<element_less<T>>(std::move(runs), group1, group2, dst, std::numeric_limits<size_t>::max(),
+                                              options.cutoff, options.memory, timer);
+        report.n_passes_saved = saved_passes(count, options.cutoff, k, report.n_passes);
+        return report;
     }
+
+    if (options.n_tapes < 6 && options.runs == run_generation::fixed) {
+        auto tt1 = factory(count);
+        auto tt2 = factory(count);
+        auto tt3 = factory(count);
+        auto tapes = std::array<typed_tape<T>*, 4>{ &dst, tt1.get(), tt2.get(), tt3.get() };
+
+        auto on_step = [&](merge_sort_state const& state) {
+            if (checkpoints) {
+                for (auto* tape : tapes) {
+                    tape->flush();
+                }
+                save_checkpoint(options.checkpoint, count, options.cutoff, state);
+            }
+        };
+        auto state = options.resume ? load_checkpoint(options.checkpoint, count, options.cutoff) : std::nullopt;
+        if (state) {
+            // the heads of the new tapes are at the beginning
+            for (size_t i = 0; i < tapes.size(); ++i) {
+                if (state->lengths[i] > 1) {
+                    tapes[i]->move_n(state->lengths[i] - 1, direction::right);
+                }
+            }
+            timer.finish("resume");
+        } else {
+            auto runs = generate_runs(src, count, options, { &dst, tt1.get() });
+            timer.finish("runs");
+            state = merge_sort_state{ .n_runs = runs.size(), .block_size = runs.front(), .n_blocks = runs.size(), .n_steps = 1,
+                                      .roles = { 0, 1, 2, 3 }, .lengths = {} };
+            for (size_t i = 0; i < runs.size(); ++i) {
+                state->lengths[i % 2] += runs[i];
+            }
+            on_step(*state);
+        }
+        report.n_runs = state->n_runs;
+        // four rings must fit into the memory limit
+        auto ring_size = options.pipelined_merge ? std::clamp<size_t>(options.cutoff / 4, 1, 4096) : 0;
+        // two chunks and the merged ones must fit into the memory limit
+        auto chunk_size = std::min<size_t>(options.cutoff / 4, 1 << 16);
+        merge_sort(count, tapes, *state, ring_size, chunk_size, options.memory, timer, on_step);
+        if (state->n_steps % 2 == 0) {
+            // sorted data is stored in tt2 but reversed
+            copy_reversed(*tt2, count, dst, options.cutoff, options.memory);
+            timer.finish("copy");
+        }
+        if (checkpoints) {
+            std::filesystem::remove(options.checkpoint);
+        }
+        report.n_passes = state->n_steps - 1;
+        report.n_passes_saved = saved_passes(count, options.cutoff, 2, report.n_passes);
+        return report;
+    }
+
+    auto k = options.n_tapes / 2;
+    auto temp_tapes = std::vector<std::unique_ptr<typed_tape<T>>>();
+    auto group1 = std::vector<typed_tape<T>*>{ &dst };
+    auto group2 = std::vector<typed_tape<T>*>();
+    for (size_t i = 1; i < 2 * k; ++i) {
+        temp_tapes.push_back(factory(count));
+        (i < k ? group1 : group2).push_back(temp_tapes.back().get());
+    }
+
+    auto runs = generate_runs(src, count, options, group1);
+    timer.finish("runs");
+    report.n_runs = runs.size();
+    report.n_passes = count_merge_passes(runs.size(), k);
+    auto [sorted, ascending] = kway_merge_sort(std::move(runs), group1, group2, true, timer);
+    if (!ascending) {
+        copy_reversed(*sorted, count, dst, options.cutoff, options.memory);
+        timer.finish("copy");
+    }
+    report.n_passes_saved = saved_passes(count, options.cutoff, k, report.n_passes);
+    return report;
+}
+
+template <tape_element T>
+void sort(typed_tape<T> const& src, size_t count, typed_tape<T>& dst, size_t cutoff,
+          std::type_identity_t<typed_tape_factory<T>> const& factory) {
+    sort<T>(src, count, dst, sort_options{ .cutoff = cutoff }, factory);
+}
+
+template <tape_element T>
+sort_report sample_sort(typed_tape<T> const& src, size_t count, typed_tape<T>& dst, sort_options const& options,
+                        std::type_identity_t<std::vector<typed_tape_factory<T>>> const& factories) {
+    if (factories.empty()) {
+        throw std::invalid_argument("at least one partition is required");
+    }
+    if (factories.size() == 1) {
+        return sort<T>(src, count, dst, options, factories[0]);
+    }
+    if (!options.checkpoint.empty() || options.resume) {
+        throw std::invalid_argument("checkpoints are not supported by sample sort");
+    }
+    auto report = sort_report();
+    if (count == 0) {
+        return report;
+    }
+    if (options.cutoff == 0) {
+        throw std::invalid_argument("cutoff must be positive integer");
+    }
+    auto n_partitions = factories.size();
+    auto timer = phase_timer(report.phases);
+
+    auto splitters = std::pmr::vector<T>(options.memory);
+    auto estimates = std::vector<size_t>();
+    {
+        // the sample is released before the distribution, which takes the memory
+        auto sample = take_sample(src, count, n_partitions, options.cutoff, options.memory);
+        splitters = choose_splitters(sample, n_partitions, options.memory);
+        estimates = estimate_part_sizes(sample, splitters, count);
+    }
+    timer.finish("sample");
+
+    auto parts = distribute(src, count, splitters, estimates,
+                            [&](size_t p) -> auto const& { return factories[p]; }, options.cutoff, options.memory);
+    timer.finish("distribute");
+
+    auto part_options = options;
+    part_options.cutoff = std::max<size_t>(1, options.cutoff / n_partitions);
+    auto sorted = std::vector<std::unique_ptr<typed_tape<T>>>(n_partitions);
+    auto reports = std::vector<sort_report>(n_partitions);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto threads = std::vector<std::thread>();
+    for (size_t i = 0; i < n_partitions; ++i) {
+        if (parts[i].size == 0) {
+            continue;
+        }
+        threads.emplace_back([&, i] {
+            try {
+                auto size = parts[i].size;
+                auto part = join_part(parts[i], factories[i], part_options.cutoff, options.memory);
+                sorted[i] = factories[i](size);
+                reports[i] = sort<T>(*part, size, *sorted[i], part_options, factories[i]);
+                // the partition's file can be reused by other tapes of the factory
+                part.reset();
+            } catch (...) {
+                std::lock_guard lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    timer.finish("partitions");
+
+    report.n_passes_saved = std::numeric_limits<size_t>::max();
+    for (size_t i = 0; i < n_partitions; ++i) {
+        if (parts[i].size == 0) {
+            continue;
+        }
+        report.n_runs += reports[i].n_runs;
+        report.n_passes = std::max(report.n_passes, reports[i].n_passes);
+        report.n_passes_saved = std::min(report.n_passes_saved, reports[i].n_passes_saved);
+        report.n_distribution_passes = std::max(report.n_distribution_passes, reports[i].n_distribution_passes);
+        report.n_merged_buckets += reports[i].n_merged_buckets;
+        sorted[i]->rewind();
+        copy_forward(*sorted[i], parts[i].size, dst, options.cutoff, options.memory);
+        sorted[i].reset();
+    }
+    timer.finish("concat");
+    return report;
 }
+
+sort_footprint estimate_sample_sort_footprint(sort_options const& options, size_t n_partitions) {
+    auto footprint = estimate_sort_footprint(options);
+    if (n_partitions > 1) {
+        // the partition's tape and the sorted partition
+        footprint.n_temp_tapes += 2;
+    }
+    return footprint;
+}
+
+sort_footprint estimate_top_k_footprint(sort_options const& options) {
+    return { .n_temp_tapes = 2 * top_k_merge_ways(options) };
+}
+
+template <tape_element T>
+sort_report top_k(typed_tape<T> const& src, size_t count, size_t top, bool largest, typed_tape<T>& dst,
+                  sort_options const& options, std::type_identity_t<typed_tape_factory<T>> const& factory) {
+    if (!options.checkpoint.empty() || options.resume) {
+        throw std::invalid_argument("checkpoints are not supported by top-k selection");
+    }
+    auto report = sort_report();
+    top = std::min(top, count);
+    if (top == 0) {
+        return report;
+    }
+    if (options.cutoff == 0) {
+        throw std::invalid_argument("cutoff must be positive integer");
+    }
+    auto timer = phase_timer(report.phases);
+
+    // a small part of memory is used to read src by chunks
+    auto chunk_size = std::min<size_t>(4096, options.cutoff / 8);
+    auto capacity = options.cutoff - chunk_size;
+    if (2 * top <= capacity) {
+        auto selected = largest
+                ? select_top<element_greater<T>>(src, count, top, capacity, chunk_size, options.memory)
+                : select_top<element_less<T>>(src, count, top, capacity, chunk_size, options.memory);
+        dst.write_n(selected, direction::right);
+        report.n_pruned = count - top;
+        timer.finish("select");
+        return report;
+    }
+    if (largest) {
+        pruned_top<element_greater<T>>(src, count, top, dst, options, factory, report, timer);
+    } else {
+        pruned_top<element_less<T>>(src, count, top, dst, options, factory, report, timer);
+    }
+    return report;
+}
+
+#define INSTANTIATE_SORT(T) \
+    template std::vector<size_t> generate_runs(typed_tape<T> const&, size_t, sort_options const&, \
+                                               std::vector<typed_tape<T>*> const&); \
+    template std::vector<size_t> merge_pass(std::vector<size_t> const&, std::vector<typed_tape<T>*> const&, \
+                                            std::vector<typed_tape<T>*> const&, bool); \
+    template sort_report sort(typed_tape<T> const&, size_t, typed_tape<T>&, sort_options const&, \
+                              typed_tape_factory<T> const&); \
+    template void sort(typed_tape<T> const&, size_t, typed_tape<T>&, size_t, typed_tape_factory<T> const&); \
+    template sort_report sample_sort(typed_tape<T> const&, size_t, typed_tape<T>&, sort_options const&, \
+                                     std::vector<typed_tape_factory<T>> const&); \
+    template sort_report top_k(typed_tape<T> const&, size_t, size_t, bool, typed_tape<T>&, sort_options const&, \
+                               typed_tape_factory<T> const&);
+FOR_EACH_TAPE_ELEMENT(INSTANTIATE_SORT)
@@ -3,6 +3,345 @@
 
 #include "basic_tape.h"
 
+#include <chrono>
+#include <memory_resource>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Algorithm which splits the source tape into initial sorted runs.
+ */
+enum class run_generation {
+    /**
+     * Runs of exactly `cutoff` elements sorted in RAM.
+     */
+    fixed,
+    /**
+     * Replacement selection with a heap of `cutoff` elements.
+     * Produces runs of 2*cutoff elements on average for random input, and longer runs for partially sorted input.
+     * Records are split into fixed runs instead, since the heap would change the order of equal keys.
+     */
+    replacement_selection,
+    /**
+     * Blocks of `cutoff` elements which are sorted in descending order are reversed, other blocks are sorted,
+     * and consecutive blocks extend the current run while they continue its order.
+     * Sorted input gives a single run, so it is copied to dst in a single pass.
+     */
+    natural
+};
+
+/**
+ * Parses name of a run generation algorithm: "fixed", "replacement" or "natural".
+ * @throws std::invalid_argument if the name is unknown
+ */
+run_generation parse_run_generation(std::string const& name);
+
+/**
+ * Algorithm which sorts the data which doesn't fit into RAM.
+ */
+enum class sort_engine {
+    /**
+     * Initial runs are merged by passes over the data (see sort_options::n_tapes).
+     */
+    merge,
+    /**
+     * Elements are distributed into buckets of key ranges chosen by sampling until each bucket fits into `cutoff`,
+     * then the buckets are sorted in RAM one by one. Buckets which still don't fit after
+     * two distribution passes are sorted by the merge engine.
+     */
+    distribution
+};
+
+/**
+ * Parses name of a sort engine: "merge" or "distribution".
+ * @throws std::invalid_argument if the name is unknown
+ */
+sort_engine parse_sort_engine(std::string const& name);
+
+/**
+ * Parameters of the sorting algorithm.
+ */
+struct sort_options {
+    /**
+     * Number of elements that can be sorted in RAM. Cannot be zero.
+     */
+    size_t cutoff = 10000000;
+
+    /**
+     * Total number of tapes used by the algorithm, including dst. Cannot be less than 4.
+     * 4 (or 5) tapes means balanced 2-way merge sort,
+     * 2k (or 2k+1) tapes means balanced k-way merge sort which needs ceil(log_k(count/cutoff)) passes.
+     */
+    size_t n_tapes = 4;
+
+    /**
+     * How to split src into initial sorted runs.
+     */
+    run_generation runs = run_generation::fixed;
+
+    /**
+     * Whether to overlap reading, sorting and writing of blocks when generating fixed runs.
+     * One thread reads block i+1 while block i is sorted and another thread writes block i-1.
+     * To stay within `cutoff` elements of RAM, the runs are three times shorter.
+     * Ignored for replacement selection.
+     */
+    bool pipelined_split = false;
+
+    /**
+     * Number of threads used to sort a block in RAM when `pipelined_split` is set.
+     * Zero means std::thread::hardware_concurrency().
+     */
+    size_t n_threads = 0;
+
+    /**
+     * Whether each tape taking part in a step of the balanced 2-way merge sort
+     * (4 or 5 tapes and fixed runs) is accessed by its own I/O thread, so the delays of the tapes overlap.
+     * The result is the same as without it.
+     */
+    bool pipelined_merge = false;
+
+    /**
+     * Whether tapes are rewound before each merge step and always read from left to right,
+     * instead of being scanned backwards. Uses floor((n_tapes-1)/2)-way merge:
+     * dst is written only by the last step, so it does not need to be rewound. Requires at least 5 tapes.
+     * Pays off when rewinds are cheap compared to moving the head left.
+     */
+    bool rewind = false;
+
+    /**
+     * If not empty, the state of the sort is saved to this file after the initial runs are generated
+     * and after each merge step, and the file is removed when the sort is finished.
+     * Supported only by the balanced 2-way merge sort (4 or 5 tapes, fixed runs, no rewinds).
+     */
+    std::string checkpoint{};
+
+    /**
+     * Whether to continue the sort from the state saved to `checkpoint` (if the file exists)
+     * instead of starting from scratch. The temporary tapes created by the factory must be the same
+     * (in the same order) as in the interrupted sort, and dst must keep its content.
+     */
+    bool resume = false;
+
+    /**
+     * Resource for the buffers of the algorithm (blocks, chunks, heaps and rings).
+     * Their total size at any moment doesn't exceed `cutoff` elements (plus several elements for tiny cutoffs),
+     * so a memory_arena of that size can be used to bound the memory usage.
+     */
+    std::pmr::memory_resource* memory = std::pmr::get_default_resource();
+
+    /**
+     * Algorithm used to sort the data. The other options (except `n_buckets`) apply to the merge engine,
+     * which the distribution engine uses for the buckets that don't fit into `cutoff`.
+     * Checkpoints are supported only by the merge engine.
+     */
+    sort_engine engine = sort_engine::merge;
+
+    /**
+     * Number of buckets of a distribution pass, each is a temporary tape.
+     * Zero means enough buckets for the average bucket to fit into `cutoff` after a single pass (at most 256).
+     * Frequent keys get additional buckets of their own.
+     */
+    size_t n_buckets = 0;
+};
+
+/**
+ * Time spent by a phase of a sort.
+ */
+struct sort_phase {
+    /**
+     * "runs" (generation of initial runs), "resume" (restoring the state from a checkpoint),
+     * "merge" (a merge pass) or "copy" (copying the result to dst).
+     * The distribution engine has "distribute" (the first distribution pass) and "buckets" (sorting all buckets)
+     * phases.
+     * sample_sort has "sample", "distribute", "partitions" (sorting all partitions) and "concat" phases.
+     * top_k has a single "select" phase if the selected elements fit into RAM.
+     */
+    std::string name;
+
+    std::chrono::duration<double> wall_time{0};
+
+    /**
+     * Time charged to the device clocks of all tapes during the phase, see device_clock::total.
+     */
+    std::chrono::duration<double> device_time{0};
+};
+
+/**
+ * Statistics of a finished sort.
+ */
+struct sort_report {
+    /**
+     * Number of initial sorted runs.
+     */
+    size_t n_runs = 0;
+
+    /**
+     * Number of merge passes over the data.
+     */
+    size_t n_passes = 0;
+
+    /**
+     * How many merge passes less were made compared to fixed runs of `cutoff` elements.
+     */
+    size_t n_passes_saved = 0;
+
+    /**
+     * Max number of distribution passes over an element made by the distribution engine.
+     */
+    size_t n_distribution_passes = 0;
+
+    /**
+     * Number of buckets which were sorted by the merge engine because they didn't fit into `cutoff`.
+     */
+    size_t n_merged_buckets = 0;
+
+    /**
+     * Number of elements which top_k discarded without sorting or merging them,
+     * because they couldn't be among the selected ones.
+     */
+    size_t n_pruned = 0;
+
+    /**
+     * Phases of the sort in order of execution.
+     */
+    std::vector<sort_phase> phases;
+};
+
+/**
+ * @return number of k-way merge passes needed to merge `n_runs` runs into one
+ */
+size_t count_merge_passes(size_t n_runs, size_t k);
+
+/**
+ * Splits src into sorted runs as requested by `options` (the first step of sort).
+ * Run j is written to dst[j % dst.size()] in ascending order.
+ * @param src source tape. It must points to the first element of the runs.
+ * @param count number of elements to split.
+ * @param dst tapes for the runs, each must point at the beginning. After the call, each of them
+ * points at its last written element.
+ * @return lengths of the runs in order of writing
+ */
+template <tape_element T>
+std::vector<size_t> generate_runs(typed_tape<T> const& src, size_t count, sort_options const& options,
+                                  std::vector<typed_tape<T>*> const& dst);
+
+/**
+ * Performs a single pass of balanced k-way merge sort (k = src.size() = dst.size()):
+ * merges groups of k runs from src into single runs distributed among dst.
+ * src tapes are scanned backwards, so the merged runs have the reversed order (descending for ascending runs).
+ * @param runs lengths of the runs in order of writing, run j is stored on src[j % k]
+ * @param src tapes with runs, each must point at its last element
+ * @param dst tapes for merged runs, each must point at the beginning
+ * @param ascending whether runs on src are sorted in ascending order
+ * @return lengths of merged runs in order of writing
+ */
+template <tape_element T>
+std::vector<size_t> merge_pass(std::vector<size_t> const& runs, std::vector<typed_tape<T>*> const& src,
+                               std::vector<typed_tape<T>*> const& dst, bool ascending);
+
+/**
+ * Sorts src using merge sort algorithm. The sort is stable: records (see record) with equal keys
+ * keep their input order, and their payloads are moved along with the keys.
+ * Uses 2*floor(options.n_tapes/2) - 1 additional tapes
+ * (2*floor((options.n_tapes-1)/2) with options.rewind) created by `factory`.
+ * With sort_engine::distribution, uses distribution sort instead: up to two levels of buckets are alive at once,
+ * and each bucket tape is created with the size of the data being distributed.
+ * @param src source (input) tape. It must points to the first element from which to start sorting numbers.
+ * @param count number of elements to sort.
+ * @param dst destination tape. It must points to the first element from which to start writing numbers.
+ * @param options parameters of the algorithm.
+ * @param factory function to create temporary tapes.
+ * @return statistics of the sort
+ */
+template <tape_element T>
+sort_report sort(typed_tape<T> const& src, size_t count, typed_tape<T>& dst, sort_options const& options,
+                 std::type_identity_t<typed_tape_factory<T>> const& factory);
+
+/**
+ * Memory which a sort needs besides the `cutoff` elements of its own buffers (see sort_options::memory).
+ */
+struct sort_footprint {
+    /**
+     * Max number of temporary tapes open at once. Each of them may be buffered (see buffered_tape).
+     */
+    size_t n_temp_tapes = 0;
+
+    /**
+     * Whether the number of temporary tapes open at once is not bounded in advance, so they can't be buffered
+     * within a memory budget. The distribution engine has a tape for each bucket of two nested passes,
+     * and a bucket which outgrows its estimate takes more of them.
+     */
+    bool unbounded_tapes = false;
+
+    /**
+     * Max number of elements kept in RAM besides the `cutoff` ones (the splitters of the distribution passes).
+     */
+    size_t n_extra_elements = 0;
+};
+
+/**
+ * @return footprint of sort() with the given options
+ */
+sort_footprint estimate_sort_footprint(sort_options const& options);
+
+/**
+ * Sorts src using parallel sample sort. Each factory stands for an independent set of tapes (e.g. a drive group),
+ * and the number of factories P is the number of partitions:
+ * 1. src is sampled at random positions (a single pass of moves), and P-1 splitters are chosen from the sample;
+ * 2. src is distributed by the splitters into P partition tapes, the i-th one is created by factories[i];
+ * 3. the partitions are sorted concurrently by sort(), each in its own thread, with tapes from its factory
+ *    and options.cutoff/P elements of RAM;
+ * 4. the sorted partitions are concatenated into dst.
+ * Elements equal to a splitter fall into the same partition, so many duplicates can unbalance the partitions.
+ * The sort is stable, as sort() is.
+ * With a single factory, it is the same as sort(). Checkpoints are not supported.
+ * @param src source (input) tape. It must points to the first element from which to start sorting numbers.
+ * @param count number of elements to sort.
+ * @param dst destination tape. It must points to the first element from which to start writing numbers.
+ * @param options parameters of the algorithm used for each partition.
+ * @param factories functions to create temporary tapes, one per partition. Each is called from a single thread
+ * at a time, but different factories are called concurrently.
+ * @return statistics of the sort: total number of initial runs and maximal number of merge passes of partitions
+ */
+template <tape_element T>
+sort_report sample_sort(typed_tape<T> const& src, size_t count, typed_tape<T>& dst, sort_options const& options,
+                        std::type_identity_t<std::vector<typed_tape_factory<T>>> const& factories);
+
+/**
+ * @return footprint of each partition of sample_sort() with the given options, including the partition's tape
+ * and the tape of the sorted partition. The partitions need options.cutoff elements of RAM altogether.
+ */
+sort_footprint estimate_sample_sort_footprint(sort_options const& options, size_t n_partitions);
+
+/**
+ * Writes the `top` least elements of src (or the greatest ones, if `largest` is set) to dst in sorted order:
+ * ascending for the least elements and descending for the greatest ones, so the first element is the best.
+ * Of equal elements, the earlier ones in src are selected, and they keep their order.
+ * If 2*top elements fit into options.cutoff, the elements are selected in a single pass over src
+ * by a bounded buffer, and no temporary tapes are used. Otherwise, a pruned external sort is used:
+ * only the first `top` elements of each sorted block of `cutoff` elements are written as a run,
+ * the elements which can't be selected because the runs already have `top` better ones are discarded
+ * before sorting, and the runs are merged by rewinding merges (as with options.rewind)
+ * which write only the first `top` elements of each group of runs.
+ * It uses 2*max(2, floor((options.n_tapes-1)/2)) additional tapes created by `factory`.
+ * options.runs, options.engine and the options of pipelining are ignored, checkpoints are not supported.
+ * @param src source (input) tape. It must points to the first element from which to start selecting numbers.
+ * @param count number of elements of src.
+ * @param top number of elements to select. If it is greater than `count`, all elements are sorted.
+ * @param dst destination tape of at least min(top, count) elements. It must points to the first element
+ * from which to start writing numbers.
+ * @return statistics of the selection
+ */
+template <tape_element T>
+sort_report top_k(typed_tape<T> const& src, size_t count, size_t top, bool largest, typed_tape<T>& dst,
+                  sort_options const& options, std::type_identity_t<typed_tape_factory<T>> const& factory);
+
+/**
+ * @return footprint of top_k() with the given options if the selected elements don't fit into RAM
+ */
+sort_footprint estimate_top_k_footprint(sort_options const& options);
+
 /**
  * Sorts src1 using merge sort algorithm. Uses three additional tapes created by `factory`.
  * @param src source (input) tape. It must points to the first element from which to start sorting numbers.
@@ -11,6 +350,8 @@
  * @param cutoff number of elements that can be sorted in RAM. Cannot be zero.
  * @param factory function to create temporary tapes.
  */
-void sort(basic_tape const& src, size_t count, basic_tape& dst, size_t cutoff, tape_factory const& factory);
+template <tape_element T>
+void sort(typed_tape<T> const& src, size_t count, typed_tape<T>& dst, size_t cutoff,
+          std::type_identity_t<typed_tape_factory<T>> const& factory);
 
 #endif //YADRO_TATLIN_TEST_TASK_TAPE_ALGORITHM_H
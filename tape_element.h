@@ -0,0 +1,250 @@
+#ifndef YADRO_TATLIN_TEST_TASK_TAPE_ELEMENT_H
+#define YADRO_TATLIN_TEST_TASK_TAPE_ELEMENT_H
+
+#include <array>
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <type_traits>
+
+/**
+ * Properties of a type of the elements stored on tapes.
+ * Specialized for int (int32_t), int64_t, uint32_t, double and records (see record).
+ */
+template <typename T>
+struct element_traits;
+
+namespace detail {
+    /**
+     * Common part of element_traits of the types whose values are ordered as the values of `Key`
+     * returned by `to_key`.
+     */
+    template <typename T, typename Key, Key (*to_key)(T)>
+    struct ordered_element_traits {
+        /**
+         * Unsigned integer which has the same order as the elements (see radix_key) and the same width.
+         */
+        using key_type = Key;
+
+        /**
+         * Number of bytes occupied by an element in binary formats.
+         */
+        static constexpr size_t width = sizeof(T);
+
+        /**
+         * Whether elements which are equal in the order of `less` can still differ,
+         * so the sort must keep their input order.
+         */
+        static constexpr bool has_payload = false;
+
+        /**
+         * Maps an element to an unsigned integer so that the order is preserved, for radix sorting.
+         */
+        static Key radix_key(T x) {
+            return to_key(x);
+        }
+
+        /**
+         * Strict total order of the elements used by sorting. Integers are compared as is,
+         * and floating-point numbers are compared by their keys, so NaNs are ordered too.
+         */
+        static bool less(T a, T b) {
+            if constexpr (std::is_integral_v<T>) {
+                return a < b;
+            } else {
+                return to_key(a) < to_key(b);
+            }
+        }
+
+        /**
+         * Stores an element as `width` bytes of its representation in little-endian order.
+         */
+        static void encode(T data, char* buf) {
+            auto u = std::bit_cast<Key>(data);
+            for (size_t i = 0; i < width; ++i) {
+                buf[i] = static_cast<char>((u >> (8 * i)) & 0xFF);
+            }
+        }
+
+        /**
+         * Restores an element stored by encode.
+         */
+        static T decode(char const* buf) {
+            Key u = 0;
+            for (size_t i = 0; i < width; ++i) {
+                u |= static_cast<Key>(static_cast<uint8_t>(buf[i])) << (8 * i);
+            }
+            return std::bit_cast<T>(u);
+        }
+    };
+
+    template <typename T>
+    using unsigned_of = std::conditional_t<sizeof(T) == 8, uint64_t, uint32_t>;
+
+    template <typename T>
+    unsigned_of<T> signed_key(T x) {
+        return static_cast<unsigned_of<T>>(x) ^ (unsigned_of<T>{1} << (8 * sizeof(T) - 1));
+    }
+
+    template <typename T>
+    T unsigned_key(T x) {
+        return x;
+    }
+
+    /**
+     * Negative values have all the bits flipped, positive ones only the sign bit,
+     * so -NaN < -inf < ... < -0.0 < +0.0 < ... < +inf < +NaN.
+     */
+    inline uint64_t double_key(double x) {
+        auto u = std::bit_cast<uint64_t>(x);
+        return u & (uint64_t{1} << 63) ? ~u : u | (uint64_t{1} << 63);
+    }
+}
+
+template <>
+struct element_traits<int> : detail::ordered_element_traits<int, uint32_t, detail::signed_key<int>> {};
+
+template <>
+struct element_traits<int64_t> : detail::ordered_element_traits<int64_t, uint64_t, detail::signed_key<int64_t>> {};
+
+template <>
+struct element_traits<uint32_t> : detail::ordered_element_traits<uint32_t, uint32_t, detail::unsigned_key<uint32_t>> {};
+
+template <>
+struct element_traits<double> : detail::ordered_element_traits<double, uint64_t, detail::double_key> {};
+
+/**
+ * Record of a key and a payload (e.g. the id of a row or a part of it) which is sorted by the key.
+ * Records with equal keys keep their input order.
+ * @tparam Key type of the key, one of the element types above
+ * @tparam Payload trivially copyable type which is moved along with the key as raw bytes
+ */
+template <typename Key, typename Payload>
+struct record {
+    Key key;
+    Payload payload;
+};
+
+template <typename Key, typename Payload>
+struct element_traits<record<Key, Payload>> {
+    using key_type = typename element_traits<Key>::key_type;
+
+    /**
+     * The key is stored as by element_traits<Key>, and the payload follows it as is.
+     */
+    static constexpr size_t width = element_traits<Key>::width + sizeof(Payload);
+
+    static constexpr bool has_payload = true;
+
+    /**
+     * Key extractor: the only part of a record which takes part in comparisons.
+     */
+    static Key key(record<Key, Payload> const& r) {
+        return r.key;
+    }
+
+    static key_type radix_key(record<Key, Payload> const& r) {
+        return element_traits<Key>::radix_key(key(r));
+    }
+
+    static bool less(record<Key, Payload> const& a, record<Key, Payload> const& b) {
+        return element_traits<Key>::less(key(a), key(b));
+    }
+
+    static void encode(record<Key, Payload> const& data, char* buf) {
+        element_traits<Key>::encode(data.key, buf);
+        std::memcpy(buf + element_traits<Key>::width, &data.payload, sizeof(Payload));
+    }
+
+    static record<Key, Payload> decode(char const* buf) {
+        auto res = record<Key, Payload>{ element_traits<Key>::decode(buf), {} };
+        std::memcpy(&res.payload, buf + element_traits<Key>::width, sizeof(Payload));
+        return res;
+    }
+
+    static_assert(std::is_trivially_copyable_v<Payload>, "payload is copied as raw bytes");
+};
+
+/**
+ * Key with the id of its row, so that an index is sorted instead of the rows.
+ */
+using row_id_record = record<int64_t, uint64_t>;
+
+/**
+ * Key with a 16-byte payload.
+ */
+using payload_record = record<int64_t, std::array<std::byte, 16>>;
+
+/**
+ * Type which can be stored on tapes and sorted.
+ */
+template <typename T>
+concept tape_element = requires(T x, char* buf) {
+    typename element_traits<T>::key_type;
+    { element_traits<T>::less(x, x) } -> std::same_as<bool>;
+    element_traits<T>::encode(x, buf);
+};
+
+/**
+ * Ascending order of the elements, see element_traits::less.
+ */
+template <tape_element T>
+struct element_less {
+    bool operator()(T a, T b) const {
+        return element_traits<T>::less(a, b);
+    }
+};
+
+/**
+ * Descending order of the elements, see element_traits::less.
+ */
+template <tape_element T>
+struct element_greater {
+    bool operator()(T a, T b) const {
+        return element_traits<T>::less(b, a);
+    }
+};
+
+/**
+ * @return the least element which is greater than `x`, or null optional if there is no such element
+ */
+template <tape_element T>
+std::optional<T> next_element(T x) {
+    auto key = element_traits<T>::radix_key(x);
+    if (key == std::numeric_limits<typename element_traits<T>::key_type>::max()) {
+        return {};
+    }
+    if constexpr (std::is_integral_v<T>) {
+        return x + 1;
+    } else {
+        // the key of the next element is the next key
+        auto next_key = key + 1;
+        auto u = next_key & (uint64_t{1} << 63) ? next_key & ~(uint64_t{1} << 63) : ~next_key;
+        return std::bit_cast<T>(u);
+    }
+}
+
+/**
+ * @return the record with the least key which is greater than the key of `x` (and an empty payload),
+ * or null optional if there is no such key
+ */
+template <typename Key, typename Payload>
+std::optional<record<Key, Payload>> next_element(record<Key, Payload> const& x) {
+    auto key = next_element(x.key);
+    if (!key) {
+        return {};
+    }
+    return record<Key, Payload>{ *key, {} };
+}
+
+/**
+ * Calls `X(T)` for each supported type of elements, e.g. to instantiate templates explicitly.
+ * Other record layouts can be added here.
+ */
+#define FOR_EACH_TAPE_ELEMENT(X) X(int) X(int64_t) X(uint32_t) X(double) X(row_id_record) X(payload_record)
+
+#endif //YADRO_TATLIN_TEST_TASK_TAPE_ELEMENT_H
@@ -1,45 +1,241 @@
+#include "binary_file_tape.h"
+#include "buffered_tape.h"
+#include "compressed_file_tape.h"
 #include "file_tape.h"
+#include "memory_arena.h"
+#include "mmap_file_tape.h"
 #include "tape_utils.h"
+#include "temp_tape_pool.h"
+#include "text_codec.h"
 #include "vector_tape.h"
 
+#include <algorithm>
+#include <charconv>
 #include <filesystem>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
 
-void bulk_write(std::vector<int> const& data, basic_tape& tape) {
-    for (size_t i = 0; i < data.size(); ++i) {
-        tape.write(data[i]);
-        if (i + 1 < data.size()) {
-            tape.move_right();
+tape_format parse_tape_format(std::string const& name) {
+    if (name == "text") {
+        return tape_format::text;
+    }
+    if (name == "binary") {
+        return tape_format::binary;
+    }
+    if (name == "mmap") {
+        return tape_format::mmap;
+    }
+    if (name == "compressed") {
+        return tape_format::compressed;
+    }
+    throw std::invalid_argument("unknown tape format '" + name + "', "
+                                "expected 'text', 'binary', 'mmap' or 'compressed'");
+}
+
+element_type parse_element_type(std::string const& name) {
+    if (name == "int32") {
+        return element_type::int32;
+    }
+    if (name == "int64") {
+        return element_type::int64;
+    }
+    if (name == "uint32") {
+        return element_type::uint32;
+    }
+    if (name == "double") {
+        return element_type::float64;
+    }
+    throw std::invalid_argument("unknown element type '" + name + "', "
+                                "expected 'int32', 'int64', 'uint32' or 'double'");
+}
+
+template <tape_element T>
+size_t element_bytes(tape_format format) {
+    switch (format) {
+        case tape_format::text:
+        case tape_format::mmap:
+            return TEXT_FIELD_LEN + 1;
+        case tape_format::binary:
+            return element_traits<T>::width;
+        default:
+            return 0;
+    }
+}
+
+void bulk_write(std::span<int const> data, basic_tape& tape) {
+    tape.write_n(data, direction::right);
+}
+
+std::vector<std::string> parse_path_list(std::string const& str) {
+    auto paths = std::vector<std::string>();
+    size_t begin = 0;
+    while (true) {
+        auto end = str.find(',', begin);
+        paths.push_back(str.substr(begin, end == std::string::npos ? std::string::npos : end - begin));
+        if (paths.back().empty()) {
+            throw std::invalid_argument("invalid list of paths '" + str + "'");
+        }
+        if (end == std::string::npos) {
+            return paths;
+        }
+        begin = end + 1;
+    }
+}
+
+template <tape_element T>
+std::unique_ptr<typed_tape<T>> create_file_tape(std::string const& filename, size_t size,
+                                                std::string const& path_to_config, tape_format format) {
+    if (format == tape_format::binary) {
+        return std::make_unique<typed_binary_file_tape<T>>(filename, size, path_to_config);
+    }
+    if constexpr (!std::is_same_v<T, int>) {
+        throw std::invalid_argument("only binary tapes can store elements other than 32-bit integers");
+    } else {
+        if (format == tape_format::mmap) {
+            return std::make_unique<mmap_file_tape>(filename, size, path_to_config);
+        }
+        if (format == tape_format::compressed) {
+            return std::make_unique<compressed_file_tape>(filename, size, path_to_config);
         }
+        return std::make_unique<file_tape>(filename, size, path_to_config);
     }
 }
 
-tape_factory create_file_tape_factory(std::string const& path_to_config) {
-    auto factory = [&](size_t size) {
-        static size_t cnt = 0;
-        cnt++;
-        std::filesystem::path path("tmp");
-        std::filesystem::create_directory(path);
-        path /= "tape" + std::to_string(cnt) + ".txt";
-        return std::make_unique<file_tape>(path.string(), size, path_to_config);
+template <tape_element T>
+typed_tape_factory<T> create_file_tape_factory(std::string const& path_to_config, tape_format format,
+                                               std::string const& dir) {
+    return std::make_shared<temp_tape_pool>(dir, path_to_config, format)->factory<T>();
+}
+
+size_t parse_memory_size(std::string const& str) {
+    size_t value = 0;
+    auto [end, ec] = std::from_chars(str.data(), str.data() + str.size(), value);
+    if (ec != std::errc() || end == str.data()) {
+        throw std::invalid_argument("invalid memory size '" + str + "'");
+    }
+    auto suffix = std::string_view(end, str.data() + str.size() - end);
+    size_t multiplier;
+    if (suffix.empty() || suffix == "B") {
+        multiplier = 1;
+    } else if (suffix == "K" || suffix == "KiB") {
+        multiplier = size_t{1} << 10;
+    } else if (suffix == "M" || suffix == "MiB") {
+        multiplier = size_t{1} << 20;
+    } else if (suffix == "G" || suffix == "GiB") {
+        multiplier = size_t{1} << 30;
+    } else {
+        throw std::invalid_argument("invalid memory size '" + str + "', expected suffix K, M or G");
+    }
+    if (value > std::numeric_limits<size_t>::max() / multiplier) {
+        throw std::invalid_argument("memory size '" + str + "' is too large");
+    }
+    return value * multiplier;
+}
+
+memory_budget divide_memory_budget(size_t bytes, sort_footprint const& footprint, size_t buffer_size,
+                                   size_t element_size) {
+    constexpr size_t reserve = 4096;
+    auto n_buffers = footprint.unbounded_tapes ? 0 : 2 * footprint.n_temp_tapes;
+    buffer_size = n_buffers == 0 ? 0 : std::min(buffer_size, bytes / 4 / n_buffers / element_size);
+    auto io_bytes = buffer_size == 0 ? 0 : n_buffers * (buffer_size * element_size + memory_arena::ALIGNMENT);
+    auto fixed_bytes = io_bytes + footprint.n_extra_elements * element_size + reserve;
+    if (bytes < fixed_bytes + element_size) {
+        throw std::invalid_argument("memory budget of " + std::to_string(bytes) + " bytes is too small");
+    }
+    return { .cutoff = (bytes - fixed_bytes) / element_size, .buffer_size = buffer_size, .io_bytes = io_bytes };
+}
+
+template <tape_element T>
+typed_tape_factory<T> create_buffered_tape_factory(std::type_identity_t<typed_tape_factory<T>> factory,
+                                                   size_t block_size, std::pmr::memory_resource* memory) {
+    if (block_size == 0) {
+        throw std::invalid_argument("size of a block cannot be zero");
+    }
+    return [factory = std::move(factory), block_size, memory](size_t size) -> std::unique_ptr<typed_tape<T>> {
+        return std::make_unique<typed_buffered_tape<T>>(factory(size), size, block_size, memory);
+    };
+}
+
+template <tape_element T>
+typed_tape_factory<T> create_counting_tape_factory(std::type_identity_t<typed_tape_factory<T>> factory,
+                                                   std::deque<tape_counters>& counters,
+                                                   std::string prefix, size_t element_bytes) {
+    return [factory = std::move(factory), &counters, prefix = std::move(prefix), element_bytes,
+            cnt = size_t{0}](size_t size) mutable -> std::unique_ptr<typed_tape<T>> {
+        counters.push_back({ .name = prefix + std::to_string(++cnt), .element_bytes = element_bytes });
+        return std::make_unique<typed_counting_tape<T>>(factory(size), counters.back());
     };
-    return factory;
 }
 
 std::unique_ptr<vector_tape> create_temp_vector_tape(size_t size) {
     return std::make_unique<vector_tape>(size);
 }
 
-void print_tape(const basic_tape &tape, std::ostream& out) {
+template <tape_element T>
+void print_tape(typed_tape<T> const& tape, std::ostream& out) {
     tape.rewind();
+    // doubles are printed with enough digits to be parsed back exactly
+    auto precision = out.precision(std::numeric_limits<T>::max_digits10);
     out << "tape = { ";
+    auto buf = std::vector<std::optional<T>>(4096);
+    size_t n;
     do {
-        auto v = tape.read_safe();
-        if (v) {
-            out << *v << ' ';
-        } else {
-            out << "_ ";
+        n = tape.read_safe_n(buf, direction::right);
+        for (size_t i = 0; i < n; ++i) {
+            if (buf[i]) {
+                out << *buf[i] << ' ';
+            } else {
+                out << "_ ";
+            }
         }
-    } while (tape.move_right());
+    } while (n == buf.size() && tape.move_right());
     out << "}" << std::endl;
+    out.precision(precision);
 }
+
+void print_stats(sort_report const& report, std::deque<tape_counters> const& counters, std::ostream& out) {
+    out << "{\n  \"phases\": [";
+    for (size_t i = 0; i < report.phases.size(); ++i) {
+        auto const& phase = report.phases[i];
+        out << (i == 0 ? "\n" : ",\n") << "    { \"name\": \"" << phase.name << "\""
+            << ", \"wall_time\": " << phase.wall_time.count()
+            << ", \"device_time\": " << phase.device_time.count() << " }";
+    }
+    out << "\n  ],\n  \"tapes\": [";
+    for (size_t i = 0; i < counters.size(); ++i) {
+        auto const& c = counters[i];
+        out << (i == 0 ? "\n" : ",\n") << "    { \"name\": \"" << c.name << "\""
+            << ", \"reads\": " << c.reads << ", \"writes\": " << c.writes
+            << ", \"moves_left\": " << c.moves_left << ", \"moves_right\": " << c.moves_right
+            << ", \"reversals\": " << c.reversals << ", \"rewinds\": " << c.rewinds;
+        if (c.bytes) {
+            out << ", \"bytes_read\": " << c.bytes->read << ", \"bytes_written\": " << c.bytes->written << " }";
+        } else if (c.element_bytes != 0) {
+            out << ", \"bytes_read\": " << c.reads * c.element_bytes
+                << ", \"bytes_written\": " << c.writes * c.element_bytes << " }";
+        } else {
+            out << ", \"bytes_read\": null, \"bytes_written\": null }";
+        }
+    }
+    out << "\n  ]\n}" << std::endl;
+}
+
+#define INSTANTIATE_TAPE_UTILS(T) \
+    template size_t element_bytes<T>(tape_format); \
+    template std::unique_ptr<typed_tape<T>> create_file_tape<T>(std::string const&, size_t, std::string const&, \
+                                                                tape_format); \
+    template typed_tape_factory<T> create_file_tape_factory<T>(std::string const&, tape_format, std::string const&); \
+    template typed_tape_factory<T> create_buffered_tape_factory<T>(typed_tape_factory<T>, size_t, \
+                                                                   std::pmr::memory_resource*); \
+    template typed_tape_factory<T> create_counting_tape_factory<T>(typed_tape_factory<T>, std::deque<tape_counters>&, \
+                                                                   std::string, size_t);
+FOR_EACH_TAPE_ELEMENT(INSTANTIATE_TAPE_UTILS)
+
+// elements which can be printed
+#define INSTANTIATE_PRINT_TAPE(T) template void print_tape<T>(typed_tape<T> const&, std::ostream&);
+INSTANTIATE_PRINT_TAPE(int)
+INSTANTIATE_PRINT_TAPE(int64_t)
+INSTANTIATE_PRINT_TAPE(uint32_t)
+INSTANTIATE_PRINT_TAPE(double)
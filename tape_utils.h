@@ -2,17 +2,162 @@
 #define YADRO_TATLIN_TEST_TASK_TAPE_UTILS_H
 
 #include "basic_tape.h"
+#include "counting_tape.h"
+#include "tape_algorithm.h"
 #include "vector_tape.h"
 
+#include <deque>
+#include <memory_resource>
+#include <span>
+#include <string>
+#include <type_traits>
 #include <vector>
 
-void bulk_write(std::vector<int> const& data, basic_tape& tape);
+/**
+ * Format of a file which stores tape data.
+ * text -- see file_tape, binary -- see binary_file_tape,
+ * mmap -- the same text format, but the file is memory-mapped (see mmap_file_tape),
+ * compressed -- blocks of delta-encoded and bit-packed elements, see compressed_file_tape.
+ */
+enum class tape_format {
+    text,
+    binary,
+    mmap,
+    compressed
+};
 
-tape_factory create_file_tape_factory(std::string const& path_to_config);
+/**
+ * Parses name of a tape format: "text", "binary", "mmap" or "compressed".
+ * @throws std::invalid_argument if the name is unknown
+ */
+tape_format parse_tape_format(std::string const& name);
+
+/**
+ * Type of the elements of the tapes sorted by the CLI.
+ * Text, mmap and compressed tapes store 32-bit integers only, the other types need binary tapes.
+ */
+enum class element_type {
+    int32,
+    int64,
+    uint32,
+    float64
+};
+
+/**
+ * Parses name of an element type: "int32", "int64", "uint32" or "double".
+ * @throws std::invalid_argument if the name is unknown
+ */
+element_type parse_element_type(std::string const& name);
+
+/**
+ * @return number of bytes an element of type `T` occupies in a file of the given format (not counting the bitmap of
+ * a binary file), or zero if it is not fixed (compressed files)
+ */
+template <tape_element T = int>
+size_t element_bytes(tape_format format);
+
+void bulk_write(std::span<int const> data, basic_tape& tape);
+
+/**
+ * Splits a comma-separated list of paths, e.g. "/mnt/a/tmp,/mnt/b/tmp".
+ * @throws std::invalid_argument if the list or any of the paths is empty
+ */
+std::vector<std::string> parse_path_list(std::string const& str);
+
+/**
+ * Creates a tape which stores its data in `filename` using the given format.
+ * Timings are parsed from `path_to_config`.
+ * @throws std::invalid_argument if the format cannot store elements of type `T` (only binary tapes store
+ * elements other than int)
+ */
+template <tape_element T = int>
+std::unique_ptr<typed_tape<T>> create_file_tape(std::string const& filename, size_t size,
+                                                std::string const& path_to_config, tape_format format);
+
+/**
+ * Creates a factory of temporary file tapes in `dir` (see temp_tape_pool).
+ * The files are recycled while the factory or any of its tapes is alive, and removed afterwards.
+ */
+template <tape_element T = int>
+typed_tape_factory<T> create_file_tape_factory(std::string const& path_to_config,
+                                               tape_format format = tape_format::text,
+                                               std::string const& dir = "tmp");
+
+/**
+ * Parses size of memory: a number of bytes optionally followed by a suffix
+ * "K", "KiB", "M", "MiB", "G", "GiB" (powers of 1024) or "B", e.g. "4GiB" or "512M".
+ * @throws std::invalid_argument if the string is not a valid size
+ */
+size_t parse_memory_size(std::string const& str);
+
+/**
+ * Division of a memory budget between the buffers of sorting.
+ */
+struct memory_budget {
+    /**
+     * Number of elements for run generation and merges, see sort_options::cutoff.
+     */
+    size_t cutoff;
+
+    /**
+     * Number of elements in each of two buffers of a buffered temporary tape, see buffered_tape.
+     */
+    size_t buffer_size;
+
+    /**
+     * Number of bytes taken by the buffers of all temporary tapes (with the alignment of memory_arena).
+     */
+    size_t io_bytes;
+};
+
+/**
+ * Divides `bytes` of memory between the buffers of a sort of elements of `element_size` bytes
+ * with the given footprint (see estimate_sort_footprint):
+ * at most a quarter goes to the buffers of its temporary tapes (`buffer_size` is reduced if needed,
+ * zero means no buffering; the tapes aren't buffered if their number is not bounded), and the rest
+ * (except the extra elements and a small reserve for alignment of the blocks, see memory_arena)
+ * goes to the algorithm.
+ * @throws std::invalid_argument if the budget is too small (e.g. for the splitters of too many buckets)
+ */
+memory_budget divide_memory_budget(size_t bytes, sort_footprint const& footprint, size_t buffer_size,
+                                   size_t element_size = sizeof(int));
+
+/**
+ * Creates a factory which wraps tapes created by `factory` into buffered_tape.
+ * @param factory underlying factory
+ * @param block_size number of elements which are read ahead or written behind at once. Cannot be zero.
+ * @param memory resource for the buffers of the tapes
+ */
+template <tape_element T = int>
+typed_tape_factory<T> create_buffered_tape_factory(std::type_identity_t<typed_tape_factory<T>> factory,
+                                                   size_t block_size,
+                                                   std::pmr::memory_resource* memory = std::pmr::get_default_resource());
+
+/**
+ * Creates a factory which wraps tapes created by `factory` into counting_tape.
+ * Counters of the created tapes are appended to `counters` and named "<prefix>1", "<prefix>2", ...
+ * @param element_bytes see tape_counters::element_bytes
+ */
+template <tape_element T = int>
+typed_tape_factory<T> create_counting_tape_factory(std::type_identity_t<typed_tape_factory<T>> factory,
+                                                   std::deque<tape_counters>& counters,
+                                                   std::string prefix = "tmp", size_t element_bytes = 0);
 
 std::unique_ptr<vector_tape> create_temp_vector_tape(size_t size);
 
-void print_tape(basic_tape const& tape, std::ostream& out);
+/**
+ * Prints the statistics of a sort as a JSON object:
+ * the phases of `report` with their wall and device time in seconds,
+ * and the operations of each tape in `counters` with the number of bytes read and written
+ * (null if tape_counters::element_bytes is unknown).
+ */
+void print_stats(sort_report const& report, std::deque<tape_counters> const& counters, std::ostream& out);
+
+/**
+ * Prints the elements of a tape of numbers (int, int64_t, uint32_t or double), "_" for empty ones.
+ */
+template <tape_element T>
+void print_tape(typed_tape<T> const& tape, std::ostream& out);
 
 
 #endif //YADRO_TATLIN_TEST_TASK_TAPE_UTILS_H
@@ -0,0 +1,163 @@
+#include "temp_tape_pool.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+/**
+ * Tape which returns its file to the pool when destroyed.
+ */
+template <tape_element T>
+class typed_pooled_tape : public typed_tape<T> {
+public:
+    typed_pooled_tape(std::unique_ptr<typed_tape<T>> tape, std::shared_ptr<temp_tape_pool> pool,
+                      std::filesystem::path path)
+                     : tape(std::move(tape)), pool(std::move(pool)), path(std::move(path)) {}
+
+    ~typed_pooled_tape() override {
+        tape.reset();
+        pool->release(std::move(path));
+    }
+
+    T read() const override {
+        return tape->read();
+    }
+
+    std::optional<T> read_safe() const override {
+        return tape->read_safe();
+    }
+
+    void write(T data) override {
+        tape->write(data);
+    }
+
+    bool move_left() const override {
+        return tape->move_left();
+    }
+
+    bool move_right() const override {
+        return tape->move_right();
+    }
+
+    void rewind() const override {
+        tape->rewind();
+    }
+
+    void flush() override {
+        tape->flush();
+    }
+
+    size_t read_n(std::span<T> out, direction dir) const override {
+        return tape->read_n(out, dir);
+    }
+
+    size_t read_safe_n(std::span<std::optional<T>> out, direction dir) const override {
+        return tape->read_safe_n(out, dir);
+    }
+
+    size_t write_n(std::span<T const> data, direction dir) override {
+        return tape->write_n(data, dir);
+    }
+
+    size_t move_n(size_t n, direction dir) const override {
+        return tape->move_n(n, dir);
+    }
+
+    std::optional<tape_bytes> bytes_transferred() const override {
+        return tape->bytes_transferred();
+    }
+
+private:
+    std::unique_ptr<typed_tape<T>> tape;
+    std::shared_ptr<temp_tape_pool> pool;
+    std::filesystem::path path;
+};
+
+temp_tape_pool::temp_tape_pool(std::filesystem::path dir, std::string path_to_config, tape_format format,
+                               bool adopt_existing)
+                              : dir(std::move(dir)), path_to_config(std::move(path_to_config)), format(format),
+                                adopt_existing(adopt_existing) {
+    std::filesystem::create_directories(this->dir);
+}
+
+temp_tape_pool::~temp_tape_pool() {
+    if (keep_on_exit) {
+        return;
+    }
+    for (auto const& path : all_files) {
+        std::error_code ignored;
+        std::filesystem::remove(path, ignored);
+    }
+}
+
+std::filesystem::path temp_tape_pool::create_file() {
+    auto extension = format == tape_format::binary ? ".bin" : format == tape_format::compressed ? ".cmp" : ".txt";
+    for (;; ++next_id) {
+        auto path = dir / ("tape" + std::to_string(next_id) + extension);
+        if (adopt_existing && std::filesystem::exists(path)) {
+            next_id++;
+            return path;
+        }
+        // "x" fails if the file exists, so the file is never shared with another pool
+        if (auto* file = std::fopen(path.string().c_str(), "wx")) {
+            std::fclose(file);
+            next_id++;
+            return path;
+        }
+        if (!std::filesystem::exists(path)) {
+            throw std::runtime_error("cannot create file " + path.string());
+        }
+    }
+}
+
+template <tape_element T>
+std::unique_ptr<typed_tape<T>> temp_tape_pool::acquire(size_t size) {
+    std::filesystem::path path;
+    bool reused = false;
+    {
+        std::lock_guard lock(mutex);
+        if (!free_files.empty()) {
+            path = std::move(free_files.back());
+            free_files.pop_back();
+            reused = true;
+        } else {
+            path = create_file();
+            all_files.push_back(path);
+        }
+    }
+    if (reused) {
+        // the tape pre-allocates an empty file
+        std::filesystem::resize_file(path, 0);
+    }
+    try {
+        auto tape = create_file_tape<T>(path.string(), size, path_to_config, format);
+        return std::make_unique<typed_pooled_tape<T>>(std::move(tape), shared_from_this(), path);
+    } catch (...) {
+        release(path);
+        throw;
+    }
+}
+
+template <tape_element T>
+typed_tape_factory<T> temp_tape_pool::factory() {
+    return [pool = shared_from_this()](size_t size) { return pool->acquire<T>(size); };
+}
+
+void temp_tape_pool::keep_files(bool keep) {
+    std::lock_guard lock(mutex);
+    keep_on_exit = keep;
+}
+
+std::vector<std::filesystem::path> temp_tape_pool::files() const {
+    std::lock_guard lock(mutex);
+    return all_files;
+}
+
+void temp_tape_pool::release(std::filesystem::path path) {
+    std::lock_guard lock(mutex);
+    free_files.push_back(std::move(path));
+}
+
+#define INSTANTIATE_TEMP_TAPE_POOL(T) \
+    template std::unique_ptr<typed_tape<T>> temp_tape_pool::acquire<T>(size_t size); \
+    template typed_tape_factory<T> temp_tape_pool::factory<T>();
+FOR_EACH_TAPE_ELEMENT(INSTANTIATE_TEMP_TAPE_POOL)
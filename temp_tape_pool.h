@@ -0,0 +1,83 @@
+#ifndef YADRO_TATLIN_TEST_TASK_TEMP_TAPE_POOL_H
+#define YADRO_TATLIN_TEST_TASK_TEMP_TAPE_POOL_H
+
+#include "basic_tape.h"
+#include "tape_utils.h"
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Pool of files for temporary file tapes.
+ * The files are named tape1, tape2, ... in the given directory. A new file is created exclusively,
+ * so pools of several processes can share the directory. When a tape is destroyed, its file is returned to the pool
+ * and reused (truncated, so it is pre-allocated again) by the next tape, for instance by the next sort.
+ * The files of the pool are removed when the pool is destroyed.
+ * Thread-safe. Must be owned by std::shared_ptr: the tapes keep the pool alive.
+ */
+class temp_tape_pool : public std::enable_shared_from_this<temp_tape_pool> {
+public:
+    /**
+     * @param dir directory for the files. It is created if it doesn't exist.
+     * @param path_to_config timings config of the tapes
+     * @param format format of the tapes
+     * @param adopt_existing whether to reuse the files which already exist in `dir` (for instance,
+     * the tapes of an interrupted sort which is resumed) instead of skipping them.
+     */
+    temp_tape_pool(std::filesystem::path dir, std::string path_to_config, tape_format format,
+                   bool adopt_existing = false);
+
+    temp_tape_pool(temp_tape_pool const&) = delete;
+    temp_tape_pool& operator=(temp_tape_pool const&) = delete;
+
+    /**
+     * Removes the files of the pool unless keep_files(true) was called.
+     */
+    ~temp_tape_pool();
+
+    /**
+     * Creates a tape of `size` elements in a free file of the pool.
+     * @throws std::invalid_argument if the format of the pool cannot store elements of type `T`
+     */
+    template <tape_element T = int>
+    std::unique_ptr<typed_tape<T>> acquire(size_t size);
+
+    /**
+     * @return factory which acquires tapes of elements of type `T` from this pool
+     */
+    template <tape_element T = int>
+    typed_tape_factory<T> factory();
+
+    /**
+     * Sets whether the files are left on disk when the pool is destroyed (for instance, to resume the sort later).
+     */
+    void keep_files(bool keep);
+
+    /**
+     * @return paths of all files of the pool
+     */
+    [[nodiscard]] std::vector<std::filesystem::path> files() const;
+
+private:
+    template <tape_element T>
+    friend class typed_pooled_tape;
+
+    void release(std::filesystem::path path);
+    std::filesystem::path create_file();
+
+    const std::filesystem::path dir;
+    const std::string path_to_config;
+    const tape_format format;
+    const bool adopt_existing;
+
+    mutable std::mutex mutex;
+    std::vector<std::filesystem::path> all_files;
+    std::vector<std::filesystem::path> free_files;
+    size_t next_id = 1;
+    bool keep_on_exit = false;
+};
+
+#endif //YADRO_TATLIN_TEST_TASK_TEMP_TAPE_POOL_H
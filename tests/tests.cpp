@@ -1,9 +1,24 @@
 #include <filesystem>
 #include <gtest/gtest.h>
+#include <numeric>
 #include <random>
+#include <thread>
+#include <binary_file_tape.h>
+#include <buffered_tape.h>
+#include <compressed_file_tape.h>
+#include <counting_tape.h>
+#include <device_clock.h>
 #include <file_tape.h>
+#include <loser_tree.h>
+#include <memory_arena.h>
+#include <merge_kernel.h>
+#include <mmap_file_tape.h>
+#include <radix_sort.h>
+#include <sort_planner.h>
 #include <tape_algorithm.h>
 #include <tape_utils.h>
+#include <temp_tape_pool.h>
+#include <text_codec.h>
 #include <vector_tape.h>
 
 
@@ -96,11 +111,15 @@ TEST(file_tape, ctor_empty_file) {
     auto filename = create_temp_filename();
     {
         file_tape tape(filename, 2, FILE_TAPE_CONFIG_NAME);
+        EXPECT_EQ(tape.read_safe(), std::nullopt);
+        ASSERT_TRUE(tape.move_right());
+        EXPECT_EQ(tape.read_safe(), std::nullopt);
     }
+    // pre-allocated with empty elements
     std::ifstream file(filename);
     std::string line;
     std::getline(file, line);
-    EXPECT_EQ(line, "                        ");
+    EXPECT_EQ(line, std::string(24, ' '));
 }
 
 TEST(file_tape, ctor_created_empty) {
@@ -392,8 +411,441 @@ TEST_F(file_tape_fixture, rewind) {
     EXPECT_FALSE(tape->move_left());
 }
 
+TEST(binary_file_tape, ctor_empty_file) {
+    auto filename = create_temp_filename();
+    {
+        binary_file_tape tape(filename, 9, FILE_TAPE_CONFIG_NAME);
+    }
+    EXPECT_EQ(std::filesystem::file_size(filename), 9 * 4 + 2);
+}
+
+TEST(binary_file_tape, ctor_invalid_file) {
+    auto filename = create_temp_filename();
+    {
+        std::ofstream file(filename);
+        file << "          1";
+    }
+    EXPECT_ANY_THROW({
+        binary_file_tape tape(filename, 3, FILE_TAPE_CONFIG_NAME);
+    });
+}
+
+TEST(binary_file_tape, read_not_filled) {
+    binary_file_tape tape(create_temp_filename(), 3, FILE_TAPE_CONFIG_NAME);
+    EXPECT_FALSE(tape.read_safe().has_value());
+    EXPECT_TRUE(tape.move_right());
+    EXPECT_FALSE(tape.read_safe().has_value());
+    EXPECT_TRUE(tape.move_right());
+    EXPECT_FALSE(tape.read_safe().has_value());
+    EXPECT_FALSE(tape.move_right());
+}
+
+TEST(binary_file_tape, write_read) {
+    auto filename = create_temp_filename();
+    const int int_min = std::numeric_limits<int>::min();
+    const int int_max = std::numeric_limits<int>::max();
+    size_t size = 10;
+    {
+        binary_file_tape tape(filename, size, FILE_TAPE_CONFIG_NAME);
+        tape.write(int_min);
+        for (size_t i = 2; i + 1 < size; i += 2) {
+            ASSERT_TRUE(tape.move_right());
+            ASSERT_TRUE(tape.move_right());
+            tape.write(static_cast<int>(i) - 5);
+        }
+        ASSERT_TRUE(tape.move_right());
+        tape.write(int_max);
+        ASSERT_FALSE(tape.move_right());
+    }
+    binary_file_tape tape(filename, size, FILE_TAPE_CONFIG_NAME);
+    ASSERT_TRUE(tape.read_safe().has_value());
+    EXPECT_EQ(tape.read(), int_min);
+    for (size_t i = 2; i + 1 < size; i += 2) {
+        ASSERT_TRUE(tape.move_right());
+        EXPECT_FALSE(tape.read_safe().has_value());
+        ASSERT_TRUE(tape.move_right());
+        ASSERT_TRUE(tape.read_safe().has_value());
+        EXPECT_EQ(tape.read_safe().value(), static_cast<int>(i) - 5);
+    }
+    ASSERT_TRUE(tape.move_right());
+    ASSERT_TRUE(tape.read_safe().has_value());
+    EXPECT_EQ(tape.read(), int_max);
+    tape.rewind();
+    EXPECT_EQ(tape.read(), int_min);
+}
+
+TEST(binary_file_tape, little_endian) {
+    auto filename = create_temp_filename();
+    {
+        binary_file_tape tape(filename, 2, FILE_TAPE_CONFIG_NAME);
+        tape.move_right();
+        tape.write(0x01020304);
+    }
+    std::ifstream file(filename, std::ios::binary);
+    std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(content, std::string("\0\0\0\0\x04\x03\x02\x01\x02", 9));
+}
+
+TEST(compressed_file_tape, ctor_empty_file) {
+    auto filename = create_temp_filename();
+    {
+        compressed_file_tape tape(filename, compressed_file_tape::BLOCK_LEN + 1, FILE_TAPE_CONFIG_NAME);
+        EXPECT_FALSE(tape.read_safe().has_value());
+    }
+    EXPECT_EQ(std::filesystem::file_size(filename), 2 * compressed_file_tape::SLOT_LEN);
+}
+
+TEST(compressed_file_tape, corrupted) {
+    auto filename = create_temp_filename();
+    {
+        std::ofstream file(filename, std::ios::binary);
+        file << std::string("\x05\0\x28\0", 4) << std::string(compressed_file_tape::SLOT_LEN - 4, '\0');
+    }
+    compressed_file_tape tape(filename, 3, FILE_TAPE_CONFIG_NAME);
+    EXPECT_THROW(tape.read_safe(), std::runtime_error);
+}
+
+TEST(compressed_file_tape, same_as_vector_tape) {
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<> op_distrib(0, 7);
+    std::uniform_int_distribution<> value_distrib(std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+    auto filename = create_temp_filename();
+    // the tape must start empty, as the vector one
+    std::filesystem::remove(filename);
+    size_t size = 3 * compressed_file_tape::BLOCK_LEN + 5;
+    vector_tape expected(size);
+    {
+        compressed_file_tape tape(filename, size, FILE_TAPE_CONFIG_NAME);
+        std::vector<int> buf(300);
+        for (int i = 0; i < 20000; ++i) {
+            auto dir = i % 3 == 0 ? direction::left : direction::right;
+            switch (op_distrib(gen)) {
+                case 0:
+                    ASSERT_EQ(tape.move_right(), expected.move_right());
+                    break;
+                case 1:
+                    ASSERT_EQ(tape.move_n(i % 700, dir), expected.move_n(i % 700, dir));
+                    break;
+                case 2: {
+                    // extreme deltas alternate with small ones
+                    int value = i % 2 == 0 ? value_distrib(gen) : i;
+                    tape.write(value);
+                    expected.write(value);
+                    break;
+                }
+                case 3: {
+                    std::iota(buf.begin(), buf.end(), i);
+                    ASSERT_EQ(tape.write_n(buf, dir), expected.write_n(buf, dir));
+                    break;
+                }
+                case 4:
+                    ASSERT_EQ(tape.read_safe(), expected.read_safe());
+                    break;
+                case 5: {
+                    std::vector<int> actual(buf.size());
+                    ASSERT_EQ(tape.read_n(actual, dir), expected.read_n(buf, dir));
+                    break;
+                }
+                case 6:
+                    tape.flush();
+                    break;
+                default:
+                    if (i % 10 == 0) {
+                        tape.rewind();
+                        expected.rewind();
+                    }
+            }
+        }
+    }
+    compressed_file_tape tape(filename, size, FILE_TAPE_CONFIG_NAME);
+    expected.rewind();
+    std::vector<std::optional<int>> actual(size);
+    std::vector<std::optional<int>> content(size);
+    ASSERT_EQ(tape.read_safe_n(actual, direction::right), size);
+    ASSERT_EQ(expected.read_safe_n(content, direction::right), size);
+    EXPECT_EQ(actual, content);
+}
+
+TEST(compressed_file_tape, compresses_sorted_runs) {
+    size_t size = 1 << 16;
+    std::vector<int> content(size);
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<> distrib(0, 1000);
+    // an ascending run followed by a descending one, which is as compact
+    content[0] = std::numeric_limits<int>::min();
+    for (size_t i = 1; i < size; ++i) {
+        content[i] = i < size / 2 ? content[i - 1] + distrib(gen) : content[i - 1] - distrib(gen);
+    }
+    compressed_file_tape tape(create_temp_filename(), size, FILE_TAPE_CONFIG_NAME);
+    ASSERT_EQ(tape.write_n(content, direction::right), size);
+    tape.flush();
+    // 11 bits per element instead of 32 (plus headers)
+    EXPECT_LT(tape.bytes_written(), size * 12 / 8);
+    EXPECT_EQ(tape.bytes_read(), 0);
+    std::vector<int> res(size);
+    ASSERT_EQ(tape.read_n(res, direction::left), size);
+    std::reverse(content.begin(), content.end());
+    EXPECT_EQ(res, content);
+    EXPECT_LT(tape.bytes_read(), size * 12 / 8);
+}
+
+TEST(buffered_tape, same_as_unbuffered) {
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<> op_distrib(0, 5);
+    size_t size = 50;
+    for (size_t block_size : { 1, 2, 3, 7, 64 }) {
+        vector_tape expected(size);
+        auto inner = std::make_unique<vector_tape>(size);
+        auto const* inner_ptr = inner.get();
+        buffered_tape tape(std::move(inner), size, block_size);
+        for (int i = 0; i < 5000; ++i) {
+            switch (op_distrib(gen)) {
+                case 0:
+                case 1:
+                    ASSERT_EQ(tape.move_right(), expected.move_right());
+                    break;
+                case 2:
+                    ASSERT_EQ(tape.move_left(), expected.move_left());
+                    break;
+                case 3:
+                    tape.write(i);
+                    expected.write(i);
+                    break;
+                case 4:
+                    ASSERT_EQ(tape.read_safe(), expected.read_safe());
+                    if (expected.read_safe()) {
+                        ASSERT_EQ(tape.read(), expected.read());
+                    }
+                    break;
+                default:
+                    if (i % 100 == 0) {
+                        tape.rewind();
+                        expected.rewind();
+                    }
+            }
+        }
+        tape.flush();
+        expected.rewind();
+        inner_ptr->rewind();
+        do {
+            ASSERT_EQ(inner_ptr->read_safe(), expected.read_safe());
+            expected.move_right();
+        } while (inner_ptr->move_right());
+    }
+}
+
+TEST(buffered_tape, backward_scan) {
+    std::vector<int> content = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+    buffered_tape tape(std::make_unique<vector_tape>(content), content.size(), 3);
+    while (tape.move_right());
+    for (size_t i = content.size(); i > 0; --i) {
+        EXPECT_EQ(tape.read(), content[i - 1]);
+        EXPECT_EQ(tape.read(), content[i - 1]);
+        EXPECT_EQ(tape.move_left(), i > 1);
+    }
+}
+
+TEST(buffered_tape, reads_ahead_in_direction_of_bulk_read) {
+    std::vector<int> content = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+    tape_counters counters;
+    auto inner = std::make_unique<counting_tape>(std::make_unique<vector_tape>(content), counters);
+    buffered_tape tape(std::move(inner), content.size(), 4);
+    ASSERT_EQ(tape.move_n(5, direction::right), 5);
+    std::vector<int> out(3);
+    ASSERT_EQ(tape.read_n(out, direction::left), 3);
+    EXPECT_EQ(out, (std::vector<int>{ 6, 5, 4 }));
+    EXPECT_EQ(counters.reads, 4);
+}
+
+namespace {
+    void test_bulk_operations(basic_tape& tape, size_t size) {
+        std::vector<int> data(size);
+        for (size_t i = 0; i < size; ++i) {
+            data[i] = static_cast<int>(i * 7) - 11;
+        }
+        tape.rewind();
+        ASSERT_EQ(tape.write_n(data, direction::right), size);
+        ASSERT_FALSE(tape.move_right());
+        EXPECT_EQ(tape.read(), data.back());
+
+        std::vector<int> out(size + 3);
+        ASSERT_EQ(tape.read_n(out, direction::left), size);
+        EXPECT_FALSE(tape.move_left());
+        for (size_t i = 0; i < size; ++i) {
+            EXPECT_EQ(out[i], data[size - 1 - i]);
+        }
+
+        ASSERT_EQ(tape.move_n(size, direction::right), size - 1);
+        ASSERT_EQ(tape.move_n(2, direction::left), 2);
+        std::vector<int> rev = { 100, 200, 300 };
+        ASSERT_EQ(tape.write_n(rev, direction::left), 3);
+        EXPECT_EQ(tape.read(), 300);
+        ASSERT_TRUE(tape.move_left());
+        std::vector<std::optional<int>> opt(2);
+        ASSERT_EQ(tape.read_safe_n(opt, direction::right), 2);
+        EXPECT_EQ(opt[0], data[size - 6]);
+        EXPECT_EQ(opt[1], 300);
+        std::vector<int> fwd(3);
+        ASSERT_EQ(tape.read_n(fwd, direction::right), 3);
+        EXPECT_EQ(fwd, (std::vector<int>{ 300, 200, 100 }));
+        EXPECT_EQ(tape.read_n(fwd, direction::right), 3);
+        EXPECT_EQ(fwd, (std::vector<int>{ 100, data[size - 2], data[size - 1] }));
+        EXPECT_FALSE(tape.move_right());
+    }
+}
+
+TEST(bulk_operations, vector_tape) {
+    vector_tape tape(20);
+    test_bulk_operations(tape, 20);
+}
+
+TEST(bulk_operations, file_tape) {
+    auto filename = create_temp_filename();
+    {
+        file_tape tape(filename, 20, FILE_TAPE_CONFIG_NAME);
+        test_bulk_operations(tape, 20);
+    }
+    file_tape tape(filename, 20, FILE_TAPE_CONFIG_NAME);
+    std::vector<std::optional<int>> res(20);
+    ASSERT_EQ(tape.read_safe_n(res, direction::right), 20);
+    EXPECT_EQ(res[17], 100);
+    EXPECT_EQ(res[0], -11);
+}
+
+TEST(bulk_operations, file_tape_truncated) {
+    auto filename = create_temp_filename();
+    {
+        std::ofstream file(filename);
+        file << "        123         456         789\n";
+    }
+    file_tape tape(filename, 3, FILE_TAPE_CONFIG_NAME);
+    std::filesystem::resize_file(filename, 20);
+    std::vector<int> out(3);
+    EXPECT_THROW(tape.read_n(out, direction::right), std::runtime_error);
+}
+
+TEST(bulk_operations, binary_file_tape) {
+    binary_file_tape tape(create_temp_filename(), 20, FILE_TAPE_CONFIG_NAME);
+    test_bulk_operations(tape, 20);
+}
+
+TEST(bulk_operations, several_chunks) {
+    size_t size = 1300;
+    file_tape text(create_temp_filename(), size, FILE_TAPE_CONFIG_NAME);
+    test_bulk_operations(text, size);
+    binary_file_tape binary(create_temp_filename(), size, FILE_TAPE_CONFIG_NAME);
+    test_bulk_operations(binary, size);
+}
+
+TEST(bulk_operations, compressed_file_tape) {
+    compressed_file_tape tape(create_temp_filename(), 20, FILE_TAPE_CONFIG_NAME);
+    test_bulk_operations(tape, 20);
+}
+
+TEST(bulk_operations, mmap_file_tape) {
+    mmap_file_tape tape(create_temp_filename(), 20, FILE_TAPE_CONFIG_NAME);
+    test_bulk_operations(tape, 20);
+}
+
+TEST(bulk_operations, buffered_tape) {
+    for (size_t block_size : { 1, 2, 3, 16 }) {
+        buffered_tape tape(std::make_unique<vector_tape>(20), 20, block_size);
+        test_bulk_operations(tape, 20);
+    }
+}
+
+TEST(bulk_operations, print_tape) {
+    vector_tape tape(5000);
+    tape.write(1);
+    ASSERT_EQ(tape.move_n(5000, direction::right), 4999);
+    tape.write(2);
+    std::stringstream ss;
+    print_tape(tape, ss);
+    std::string expected = "tape = { 1 ";
+    for (size_t i = 0; i < 4998; ++i) {
+        expected += "_ ";
+    }
+    expected += "2 }\n";
+    EXPECT_EQ(ss.str(), expected);
+
+    typed_vector_tape<double> doubles(std::vector<double>{ 0.1, -2.5 });
+    std::stringstream ds;
+    print_tape(doubles, ds);
+    EXPECT_EQ(ds.str(), "tape = { 0.10000000000000001 -2.5 }\n");
+}
+
+namespace {
+    std::string read_file(std::string const& filename) {
+        std::ifstream file(filename, std::ios::binary);
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        return buffer.str();
+    }
+}
+
+TEST(mmap_file_tape, ctor_empty_file) {
+    auto filename = create_temp_filename();
+    auto expected_filename = create_temp_filename();
+    {
+        mmap_file_tape tape(filename, 5, FILE_TAPE_CONFIG_NAME);
+        file_tape expected(expected_filename, 5, FILE_TAPE_CONFIG_NAME);
+    }
+    EXPECT_EQ(read_file(filename), read_file(expected_filename));
+}
+
+TEST(mmap_file_tape, read_existing) {
+    auto filename = create_temp_filename();
+    {
+        std::ofstream file(filename);
+        file << "        123             -2147483648\n";
+    }
+    mmap_file_tape tape(filename, 3, FILE_TAPE_CONFIG_NAME);
+    ASSERT_TRUE(tape.read_safe().has_value());
+    EXPECT_EQ(tape.read(), 123);
+    EXPECT_TRUE(tape.move_right());
+    EXPECT_FALSE(tape.read_safe().has_value());
+    EXPECT_TRUE(tape.move_right());
+    EXPECT_EQ(tape.read(), std::numeric_limits<int>::min());
+    EXPECT_FALSE(tape.move_right());
+    EXPECT_TRUE(tape.move_left());
+    tape.rewind();
+    EXPECT_EQ(tape.read(), 123);
+}
+
+TEST(mmap_file_tape, corrupted) {
+    auto filename = create_temp_filename();
+    {
+        std::ofstream file(filename);
+        file << "        1x3 \n";
+    }
+    mmap_file_tape tape(filename, 1, FILE_TAPE_CONFIG_NAME);
+    EXPECT_THROW(tape.read_safe(), std::runtime_error);
+}
+
+TEST(mmap_file_tape, same_as_file_tape) {
+    auto filename = create_temp_filename();
+    auto expected_filename = create_temp_filename();
+    {
+        size_t size = 7;
+        mmap_file_tape tape(filename, size, FILE_TAPE_CONFIG_NAME);
+        file_tape expected(expected_filename, size, FILE_TAPE_CONFIG_NAME);
+        for (size_t i = 0; i < size; i += 2) {
+            tape.write(static_cast<int>(i * 1000) - 3000);
+            expected.write(static_cast<int>(i * 1000) - 3000);
+            tape.move_right();
+            tape.move_right();
+            expected.move_right();
+            expected.move_right();
+        }
+        tape.write(std::numeric_limits<int>::min());
+        expected.write(std::numeric_limits<int>::min());
+        tape.flush();
+    }
+    EXPECT_EQ(read_file(filename), read_file(expected_filename));
+}
+
 namespace {
-    void test_sorted(std::vector<int> content, size_t cutoff) {
+    void test_sorted(std::vector<int> content, size_t cutoff, tape_format format = tape_format::text) {
         auto src_filename = create_temp_filename();
         {
             std::ofstream file(src_filename);
@@ -402,9 +854,9 @@ namespace {
         auto dst_filename = create_temp_filename();
         {
             auto size = content.size();
-            file_tape src(src_filename, size, FILE_TAPE_CONFIG_NAME);
-            file_tape dst(dst_filename, size, FILE_TAPE_CONFIG_NAME);
-            sort(src, size, dst, cutoff, create_file_tape_factory(FILE_TAPE_CONFIG_NAME));
+            auto src = create_file_tape(src_filename, size, FILE_TAPE_CONFIG_NAME, format);
+            auto dst = create_file_tape(dst_filename, size, FILE_TAPE_CONFIG_NAME, format);
+            sort(*src, size, *dst, cutoff, create_file_tape_factory(FILE_TAPE_CONFIG_NAME, format));
         }
         std::sort(content.begin(), content.end());
         std::ifstream file(dst_filename);
@@ -493,3 +945,1580 @@ TEST(sort, vector_tapes) {
     std::sort(content.begin(), content.end());
     ASSERT_EQ(res, content);
 }
+
+TEST(sort, binary_tapes) {
+    std::random_device rd;
+    std::default_random_engine gen(rd());
+    std::uniform_int_distribution<> distrib(std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+
+    std::vector<int> content(1000);
+    for (int& i : content) {
+        i = distrib(gen);
+    }
+    auto src_filename = create_temp_filename();
+    auto dst_filename = create_temp_filename();
+    {
+        binary_file_tape src(src_filename, content.size(), FILE_TAPE_CONFIG_NAME);
+        bulk_write(content, src);
+        src.rewind();
+        binary_file_tape dst(dst_filename, content.size(), FILE_TAPE_CONFIG_NAME);
+        sort(src, content.size(), dst, 7, create_file_tape_factory(FILE_TAPE_CONFIG_NAME, tape_format::binary));
+    }
+    binary_file_tape dst(dst_filename, content.size(), FILE_TAPE_CONFIG_NAME);
+    std::vector<int> res(content.size());
+    for (int& i : res) {
+        ASSERT_TRUE(dst.read_safe().has_value());
+        i = dst.read();
+        dst.move_right();
+    }
+    std::sort(content.begin(), content.end());
+    ASSERT_EQ(res, content);
+}
+
+TEST(sort, mmap_tapes) {
+    std::vector<int> content = { 3, 4, 2, 9, 4, 8, 0, 8, 1, 8, 9, 2, 6, 4, 7, 5 };
+    for (size_t cutoff = 1; cutoff <= content.size(); ++cutoff) {
+        test_sorted(content, cutoff, tape_format::mmap);
+    }
+}
+
+TEST(sort, compressed_tapes) {
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<> distrib(std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+    std::vector<int> content(5000);
+    for (int& i : content) {
+        i = distrib(gen);
+    }
+    auto factory = create_file_tape_factory(FILE_TAPE_CONFIG_NAME, tape_format::compressed);
+    for (size_t n_tapes : { 4, 8 }) {
+        vector_tape src(content);
+        vector_tape dst(content.size());
+        sort(src, content.size(), dst, { .cutoff = 100, .n_tapes = n_tapes }, factory);
+        std::vector<int> res(content.size());
+        dst.rewind();
+        dst.read_n(res, direction::right);
+        auto expected = content;
+        std::sort(expected.begin(), expected.end());
+        EXPECT_EQ(res, expected);
+    }
+}
+
+TEST(sort, buffered_tapes) {
+    std::random_device rd;
+    std::default_random_engine gen(rd());
+    std::uniform_int_distribution<> distrib(-10000, 10000);
+
+    std::vector<int> content(10000);
+    for (int& i : content) {
+        i = distrib(gen);
+    }
+    for (size_t block_size : { 1, 5, 100, 20000 }) {
+        vector_tape src(content);
+        vector_tape dst(content.size());
+        sort(src, content.size(), dst, 37, create_buffered_tape_factory(create_temp_vector_tape, block_size));
+
+        std::vector<int> res(content.size());
+        dst.rewind();
+        for (int& i : res) {
+            i = dst.read();
+            dst.move_right();
+        }
+        auto expected = content;
+        std::sort(expected.begin(), expected.end());
+        ASSERT_EQ(res, expected);
+    }
+}
+
+TEST(loser_tree, merge) {
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<> distrib(-100, 100);
+    for (size_t k = 1; k <= 9; ++k) {
+        std::vector<std::vector<int>> sources(k);
+        std::vector<int> expected;
+        for (size_t i = 0; i < k; ++i) {
+            sources[i].resize(i * 3);
+            for (int& x : sources[i]) {
+                x = distrib(gen);
+                expected.push_back(x);
+            }
+            std::sort(sources[i].begin(), sources[i].end());
+        }
+        std::sort(expected.begin(), expected.end());
+
+        loser_tree<int> tree(k);
+        std::vector<size_t> next(k, 1);
+        for (size_t i = 0; i < k; ++i) {
+            if (!sources[i].empty()) {
+                tree.set(i, sources[i][0]);
+            }
+        }
+        tree.build();
+        std::vector<int> res;
+        while (!tree.empty()) {
+            auto i = tree.winner();
+            res.push_back(tree.top());
+            if (next[i] < sources[i].size()) {
+                tree.replace(sources[i][next[i]++]);
+            } else {
+                tree.pop();
+            }
+        }
+        ASSERT_EQ(res, expected);
+    }
+}
+
+TEST(loser_tree, ties_won_by_lower_index) {
+    loser_tree<int, std::greater<>> tree(5);
+    for (size_t i = 0; i < 5; ++i) {
+        tree.set(i, 7);
+    }
+    tree.build();
+    for (size_t i = 0; i < 5; ++i) {
+        ASSERT_FALSE(tree.empty());
+        EXPECT_EQ(tree.winner(), i);
+        tree.pop();
+    }
+    EXPECT_TRUE(tree.empty());
+}
+
+namespace {
+    template <tape_element T>
+    std::unique_ptr<typed_tape<T>> create_temp_typed_vector_tape(size_t size) {
+        return std::make_unique<typed_vector_tape<T>>(size);
+    }
+
+    /**
+     * Runs `sort_tapes` on a vector tape with `content` and checks that the other vector tape receives
+     * the first `n_selected` elements of `content` stably sorted by `Before`.
+     * Elements are compared bitwise, so records must keep the order of their payloads.
+     * @return the report of `sort_tapes`
+     */
+    template <tape_element T, typename Before = element_less<T>, typename SortTapes>
+    sort_report test_sorted_by(std::vector<T> content, SortTapes const& sort_tapes,
+                               size_t n_selected = std::numeric_limits<size_t>::max()) {
+        n_selected = std::min(n_selected, content.size());
+        typed_vector_tape<T> src(content);
+        typed_vector_tape<T> dst(std::max<size_t>(n_selected, 1));
+        auto report = sort_tapes(src, dst);
+        std::vector<T> res(n_selected);
+        dst.rewind();
+        dst.read_n(res, direction::right);
+        std::stable_sort(content.begin(), content.end(), Before());
+        auto mismatch = std::mismatch(res.begin(), res.end(), content.begin(), [](T const& a, T const& b) {
+            return std::memcmp(&a, &b, sizeof(T)) == 0;
+        }).first;
+        EXPECT_TRUE(mismatch == res.end()) << "mismatch at element " << mismatch - res.begin();
+        return report;
+    }
+
+    template <tape_element T>
+    sort_report test_sorted_vector(std::vector<T> content, sort_options const& options) {
+        auto count = content.size();
+        return test_sorted_by(std::move(content), [&](typed_tape<T> const& src, typed_tape<T>& dst) {
+            return sort(src, count, dst, options, create_temp_typed_vector_tape<T>);
+        });
+    }
+}
+
+TEST(sort, kway_all_cutoffs) {
+    std::random_device rd;
+    std::default_random_engine gen(rd());
+    std::uniform_int_distribution<> distrib(-50, 50);
+    for (size_t n_tapes = 4; n_tapes <= 11; ++n_tapes) {
+        for (size_t count = 1; count < 70; ++count) {
+            std::vector<int> content(count);
+            for (int& i : content) {
+                i = distrib(gen);
+            }
+            for (size_t cutoff = 1; cutoff <= count; ++cutoff) {
+                test_sorted_vector(content, { .cutoff = cutoff, .n_tapes = n_tapes });
+            }
+        }
+    }
+}
+
+TEST(sort, kway_file_tapes) {
+    std::vector<int> content = { 3, 4, 2, 9, 4, 8, 0, 8, 1, 8, 9, 2, 6, 4, 7, 5 };
+    for (size_t cutoff = 1; cutoff <= content.size(); ++cutoff) {
+        auto src_filename = create_temp_filename();
+        {
+            std::ofstream file(src_filename);
+            file << file_tape_content_from_vec(content) << '\n';
+        }
+        auto dst_filename = create_temp_filename();
+        {
+            file_tape src(src_filename, content.size(), FILE_TAPE_CONFIG_NAME);
+            file_tape dst(dst_filename, content.size(), FILE_TAPE_CONFIG_NAME);
+            sort(src, content.size(), dst, { .cutoff = cutoff, .n_tapes = 6 },
+                 create_file_tape_factory(FILE_TAPE_CONFIG_NAME));
+        }
+        auto expected = content;
+        std::sort(expected.begin(), expected.end());
+        ASSERT_EQ(read_file(dst_filename), file_tape_content_from_vec(expected));
+    }
+}
+
+TEST(sort, kway_big) {
+    std::random_device rd;
+    std::default_random_engine gen(rd());
+    std::uniform_int_distribution<> distrib;
+    std::vector<int> content(300000);
+    for (int& i : content) {
+        i = distrib(gen);
+    }
+    test_sorted_vector(content, { .cutoff = 100, .n_tapes = 8 });
+    test_sorted_vector(content, { .cutoff = 1000, .n_tapes = 16 });
+}
+
+TEST(sort, replacement_selection_all_cutoffs) {
+    std::random_device rd;
+    std::default_random_engine gen(rd());
+    std::uniform_int_distribution<> distrib(-50, 50);
+    for (size_t n_tapes : { 4, 6, 7 }) {
+        for (size_t count = 1; count < 70; ++count) {
+            std::vector<int> content(count);
+            for (int& i : content) {
+                i = distrib(gen);
+            }
+            for (size_t cutoff = 1; cutoff <= count; ++cutoff) {
+                test_sorted_vector(content, { .cutoff = cutoff, .n_tapes = n_tapes,
+                                              .runs = run_generation::replacement_selection });
+            }
+        }
+    }
+}
+
+TEST(sort, replacement_selection_big) {
+    std::random_device rd;
+    std::default_random_engine gen(rd());
+    std::uniform_int_distribution<> distrib;
+    std::vector<int> content(300000);
+    for (int& i : content) {
+        i = distrib(gen);
+    }
+    test_sorted_vector(content, { .cutoff = 100, .runs = run_generation::replacement_selection });
+    test_sorted_vector(content, { .cutoff = 1000, .n_tapes = 8, .runs = run_generation::replacement_selection });
+    std::sort(content.begin(), content.begin() + 200000);
+    test_sorted_vector(content, { .cutoff = 1000, .runs = run_generation::replacement_selection });
+}
+
+TEST(sort, pipelined_all_cutoffs) {
+    std::random_device rd;
+    std::default_random_engine gen(rd());
+    std::uniform_int_distribution<> distrib(-50, 50);
+    for (size_t n_tapes : { 4, 6 }) {
+        for (size_t count = 1; count < 70; ++count) {
+            std::vector<int> content(count);
+            for (int& i : content) {
+                i = distrib(gen);
+            }
+            for (size_t cutoff = 1; cutoff <= count; ++cutoff) {
+                test_sorted_vector(content, { .cutoff = cutoff, .n_tapes = n_tapes,
+                                              .pipelined_split = true, .n_threads = 2 });
+            }
+        }
+    }
+}
+
+TEST(sort, pipelined_big) {
+    std::random_device rd;
+    std::default_random_engine gen(rd());
+    std::uniform_int_distribution<> distrib;
+    std::vector<int> content(1000000);
+    for (int& i : content) {
+        i = distrib(gen);
+    }
+    test_sorted_vector(content, { .cutoff = 300000, .pipelined_split = true, .n_threads = 4 });
+    test_sorted_vector(content, { .cutoff = 30000, .n_tapes = 8, .pipelined_split = true });
+}
+
+namespace {
+    class failing_tape : public vector_tape {
+    public:
+        using vector_tape::vector_tape;
+
+        size_t write_n(std::span<int const>, direction) override {
+            throw std::runtime_error("write failed");
+        }
+    };
+}
+
+TEST(sort, pipelined_error) {
+    vector_tape src({ 5, 4, 3, 2, 1, 0 });
+    failing_tape dst(6);
+    sort_options options{ .cutoff = 3, .pipelined_split = true };
+    ASSERT_THROW(sort(src, 6, dst, options, create_temp_vector_tape), std::runtime_error);
+}
+
+TEST(sort, pipelined_merge_all_cutoffs) {
+    std::random_device rd;
+    std::default_random_engine gen(rd());
+    std::uniform_int_distribution<> distrib(-50, 50);
+    for (size_t count = 1; count < 70; ++count) {
+        std::vector<int> content(count);
+        for (int& i : content) {
+            i = distrib(gen);
+        }
+        for (size_t cutoff = 1; cutoff <= count; ++cutoff) {
+            test_sorted_vector(content, { .cutoff = cutoff, .pipelined_merge = true });
+        }
+    }
+}
+
+TEST(sort, pipelined_merge_same_files) {
+    std::random_device rd;
+    std::default_random_engine gen(rd());
+    std::uniform_int_distribution<> distrib(-1000, 1000);
+    std::vector<int> content(500);
+    for (int& i : content) {
+        i = distrib(gen);
+    }
+    auto src_filename = create_temp_filename();
+    {
+        std::ofstream file(src_filename);
+        file << file_tape_content_from_vec(content) << '\n';
+    }
+    for (size_t cutoff : { 7, 50, 64 }) {
+        std::vector<std::string> results;
+        for (bool pipelined : { false, true }) {
+            auto dst_filename = create_temp_filename();
+            {
+                file_tape src(src_filename, content.size(), FILE_TAPE_CONFIG_NAME);
+                file_tape dst(dst_filename, content.size(), FILE_TAPE_CONFIG_NAME);
+                sort(src, content.size(), dst, { .cutoff = cutoff, .pipelined_merge = pipelined },
+                     create_file_tape_factory(FILE_TAPE_CONFIG_NAME));
+            }
+            results.push_back(read_file(dst_filename));
+        }
+        ASSERT_EQ(results[0], results[1]);
+    }
+}
+
+TEST(device_clock, virtual_mode) {
+    auto config_name = create_temp_filename();
+    {
+        std::ofstream config(config_name);
+        config << "r=1000 w=2000 ml=30 mr=40 rewind=500\n";
+    }
+    device_clock::set_virtual(true);
+    device_clock::reset_total();
+    auto start = std::chrono::steady_clock::now();
+    {
+        file_tape tape(create_temp_filename(), 10, config_name);
+        binary_file_tape other(create_temp_filename(), 10, config_name);
+        tape.write(1);
+        tape.move_right();
+        tape.move_left();
+        EXPECT_EQ(tape.read(), 1);
+        std::vector<int> data(10);
+        tape.write_n(data, direction::right);
+        tape.rewind();
+        other.move_right();
+        EXPECT_EQ(tape.elapsed_time(), std::chrono::milliseconds(2000 + 40 + 30 + 1000 + 2000 * 10 + 40 * 9 + 500));
+        EXPECT_EQ(other.elapsed_time(), std::chrono::milliseconds(40));
+        EXPECT_EQ(device_clock::total(), tape.elapsed_time() + other.elapsed_time());
+    }
+    device_clock::set_virtual(false);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(10));
+}
+
+TEST(sort, rewind_all_cutoffs) {
+    std::random_device rd;
+    std::default_random_engine gen(rd());
+    std::uniform_int_distribution<> distrib(-50, 50);
+    for (size_t n_tapes = 5; n_tapes <= 9; ++n_tapes) {
+        for (size_t count = 1; count < 70; ++count) {
+            std::vector<int> content(count);
+            for (int& i : content) {
+                i = distrib(gen);
+            }
+            for (size_t cutoff = 1; cutoff <= count; ++cutoff) {
+                test_sorted_vector(content, { .cutoff = cutoff, .n_tapes = n_tapes, .rewind = true });
+                test_sorted_vector(content, { .cutoff = cutoff, .n_tapes = n_tapes,
+                                              .runs = run_generation::replacement_selection, .rewind = true });
+            }
+        }
+    }
+}
+
+TEST(sort_planner, zero_timings) {
+    auto plans = plan_sort(1000, 10, 8, timings_config());
+    ASSERT_EQ(plans.size(), 10);
+    for (auto const& plan : plans) {
+        EXPECT_EQ(plan.device_time.count(), 0);
+    }
+    auto best = choose_sort_plan(1000, 10, 8, timings_config());
+    EXPECT_EQ(best.options.n_tapes, 4);
+    EXPECT_EQ(best.options.runs, run_generation::fixed);
+    EXPECT_FALSE(best.options.rewind);
+}
+
+TEST(sort_planner, chooses_by_timings) {
+    timings_config timings;
+    timings.read = timings.write = timings.move_right = std::chrono::milliseconds(1);
+    timings.move_left = std::chrono::milliseconds(100);
+    EXPECT_TRUE(choose_sort_plan(100000, 100, 7, timings).options.rewind);
+    timings.move_left = std::chrono::milliseconds(1);
+    timings.rewind = std::chrono::milliseconds(1000000);
+    auto best = choose_sort_plan(100000, 100, 7, timings);
+    EXPECT_FALSE(best.options.rewind);
+    EXPECT_EQ(best.options.n_tapes, 6);
+}
+
+TEST(sort_planner, matches_device_clock) {
+    auto config_name = create_temp_filename();
+    {
+        std::ofstream config(config_name);
+        config << "r=2 w=3 ml=5 mr=1 rewind=100\n";
+    }
+    std::random_device rd;
+    std::default_random_engine gen(rd());
+    std::uniform_int_distribution<> distrib;
+    std::vector<int> content(2000);
+    for (int& i : content) {
+        i = distrib(gen);
+    }
+    auto src_filename = create_temp_filename();
+    {
+        std::ofstream file(src_filename);
+        file << file_tape_content_from_vec(content) << '\n';
+    }
+    device_clock::set_virtual(true);
+    for (auto const& plan : plan_sort(content.size(), 50, 7, timings_config(config_name))) {
+        device_clock::reset_total();
+        {
+            file_tape src(src_filename, content.size(), config_name);
+            file_tape dst(create_temp_filename(), content.size(), config_name);
+            sort(src, content.size(), dst, plan.options, create_file_tape_factory(config_name));
+        }
+        auto actual = std::chrono::duration<double>(device_clock::total()).count();
+        EXPECT_NEAR(plan.device_time.count(), actual, actual * 0.1) << plan.to_string();
+    }
+    device_clock::set_virtual(false);
+}
+
+TEST(radix_sort, edge_values) {
+    std::vector<int> data = { 0, std::numeric_limits<int>::max(), -1, std::numeric_limits<int>::min(), 1,
+                              std::numeric_limits<int>::min(), 256, -256, 65536, -65536 };
+    for (int i = 0; i < 1000; ++i) {
+        data.push_back(i % 2 ? std::numeric_limits<int>::min() + i : std::numeric_limits<int>::max() - i);
+    }
+    auto expected = data;
+    std::sort(expected.begin(), expected.end());
+    radix_sort(data);
+    ASSERT_EQ(data, expected);
+}
+
+TEST(radix_sort, random) {
+    std::random_device rd;
+    std::default_random_engine gen(rd());
+    for (int max : { 1, 100, 100000, std::numeric_limits<int>::max() }) {
+        std::uniform_int_distribution<> distrib(-max, max);
+        for (size_t size : { 0, 1, 63, 64, 65, 1000, 100000 }) {
+            std::vector<int> data(size);
+            for (int& i : data) {
+                i = distrib(gen);
+            }
+            auto expected = data;
+            std::sort(expected.begin(), expected.end());
+            radix_sort(data);
+            ASSERT_EQ(data, expected);
+        }
+    }
+}
+
+TEST(merge_kernel, random) {
+    std::random_device rd;
+    std::default_random_engine gen(rd());
+    for (int range : { 3, 100, std::numeric_limits<int>::max() }) {
+        std::uniform_int_distribution<> distrib(-range, range);
+        for (size_t size_a = 0; size_a < 40; ++size_a) {
+            for (size_t size_b : { 0, 1, 4, 7, 8, 9, 17, 100 }) {
+                std::vector<int> a(size_a), b(size_b);
+                for (int& i : a) {
+                    i = distrib(gen);
+                }
+                for (int& i : b) {
+                    i = distrib(gen);
+                }
+                for (bool descending : { false, true }) {
+                    auto cmp = [descending](int x, int y) { return descending ? x > y : x < y; };
+                    std::sort(a.begin(), a.end(), cmp);
+                    std::sort(b.begin(), b.end(), cmp);
+                    std::vector<int> expected(a.size() + b.size());
+                    std::merge(a.begin(), a.end(), b.begin(), b.end(), expected.begin(), cmp);
+                    std::vector<int> res(expected.size());
+                    merge_sorted(a, b, res, descending);
+                    ASSERT_EQ(res, expected);
+                    merge_sorted_scalar(a, b, res, descending);
+                    ASSERT_EQ(res, expected);
+                }
+            }
+        }
+    }
+}
+
+TEST(sort, natural_all_cutoffs) {
+    std::random_device rd;
+    std::default_random_engine gen(rd());
+    std::uniform_int_distribution<> distrib(-50, 50);
+    for (size_t n_tapes : { 4, 6, 7 }) {
+        for (size_t count = 1; count < 70; ++count) {
+            std::vector<int> content(count);
+            for (int& i : content) {
+                i = distrib(gen);
+            }
+            std::sort(content.begin(), content.begin() + static_cast<std::ptrdiff_t>(count / 3));
+            std::sort(content.end() - static_cast<std::ptrdiff_t>(count / 3), content.end(), std::greater<>());
+            for (size_t cutoff = 1; cutoff <= count; ++cutoff) {
+                test_sorted_vector(content, { .cutoff = cutoff, .n_tapes = n_tapes,
+                                              .runs = run_generation::natural, .rewind = n_tapes % 2 == 1 });
+            }
+        }
+    }
+}
+
+TEST(sort, natural_runs_cross_blocks) {
+    // two ascending runs of 150 elements, the first one ends in the middle of the second block
+    std::vector<int> content(300);
+    std::iota(content.begin(), content.begin() + 150, 0);
+    std::iota(content.begin() + 150, content.end(), 0);
+    vector_tape src(content);
+    vector_tape dst(content.size());
+    auto report = sort(src, content.size(), dst, { .cutoff = 100, .runs = run_generation::natural },
+                       create_temp_vector_tape);
+    EXPECT_EQ(report.n_runs, 2);
+    dst.rewind();
+    std::vector<int> res(content.size());
+    dst.read_n(res, direction::right);
+    std::sort(content.begin(), content.end());
+    EXPECT_EQ(res, content);
+}
+
+TEST(sort, natural_presorted) {
+    std::vector<int> content(10000);
+    std::iota(content.begin(), content.end(), -5000);
+    vector_tape src(content);
+    vector_tape dst(content.size());
+    auto report = sort(src, content.size(), dst, { .cutoff = 100, .runs = run_generation::natural },
+                       create_temp_vector_tape);
+    EXPECT_EQ(report.n_runs, 1);
+    EXPECT_EQ(report.n_passes, 0);
+    EXPECT_EQ(report.n_passes_saved, 7);
+
+    // reversed batches of cutoff elements
+    for (size_t i = 0; i < content.size(); i += 100) {
+        std::reverse(content.begin() + static_cast<std::ptrdiff_t>(i),
+                     content.begin() + static_cast<std::ptrdiff_t>(i + 100));
+    }
+    vector_tape reversed_src(content);
+    vector_tape reversed_dst(content.size());
+    report = sort(reversed_src, content.size(), reversed_dst,
+                  { .cutoff = 100, .n_tapes = 6, .runs = run_generation::natural }, create_temp_vector_tape);
+    EXPECT_EQ(report.n_runs, 1);
+    reversed_dst.rewind();
+    std::vector<int> res(content.size());
+    reversed_dst.read_n(res, direction::right);
+    std::sort(content.begin(), content.end());
+    EXPECT_EQ(res, content);
+}
+
+TEST(tape_utils, parse_memory_size) {
+    EXPECT_EQ(parse_memory_size("100"), 100);
+    EXPECT_EQ(parse_memory_size("100B"), 100);
+    EXPECT_EQ(parse_memory_size("64K"), 64 << 10);
+    EXPECT_EQ(parse_memory_size("512MiB"), size_t(512) << 20);
+    EXPECT_EQ(parse_memory_size("4G"), size_t(4) << 30);
+    EXPECT_THROW(parse_memory_size(""), std::invalid_argument);
+    EXPECT_THROW(parse_memory_size("M"), std::invalid_argument);
+    EXPECT_THROW(parse_memory_size("10X"), std::invalid_argument);
+    EXPECT_THROW(parse_memory_size("-1K"), std::invalid_argument);
+}
+
+TEST(tape_utils, divide_memory_budget) {
+    auto budget = divide_memory_budget(size_t(1) << 20, { .n_temp_tapes = 3 }, 4096);
+    EXPECT_LE(6 * budget.buffer_size * sizeof(int), (size_t(1) << 20) / 4);
+    EXPECT_GE(budget.cutoff * sizeof(int), (size_t(1) << 20) * 3 / 4 - 4096);
+    EXPECT_LE(budget.io_bytes, (size_t(1) << 20) / 4 + 6 * memory_arena::ALIGNMENT);
+    EXPECT_EQ(budget.cutoff * sizeof(int) + budget.io_bytes + 4096, size_t(1) << 20);
+    EXPECT_EQ(divide_memory_budget(size_t(1) << 30, { .n_temp_tapes = 5 }, 4096).buffer_size, 4096);
+    EXPECT_EQ(divide_memory_budget(size_t(1) << 20, { .n_temp_tapes = 3 }, 0).buffer_size, 0);
+    // without buffers, all but the reserve goes to the algorithm
+    EXPECT_EQ(divide_memory_budget(size_t(1) << 20, {}, 4096).io_bytes, 0);
+    EXPECT_EQ(divide_memory_budget(size_t(1) << 20, {}, 4096).cutoff, ((size_t(1) << 20) - 4096) / sizeof(int));
+    EXPECT_THROW(divide_memory_budget(1000, { .n_temp_tapes = 3 }, 4096), std::invalid_argument);
+}
+
+TEST(memory_arena, reuses_freed_blocks) {
+    memory_arena arena(4096);
+    auto* a = arena.allocate(1000);
+    auto* b = arena.allocate(1000);
+    auto* c = arena.allocate(1000);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(a) % memory_arena::ALIGNMENT, 0);
+    EXPECT_THROW({
+        auto* p = arena.allocate(2000);
+        arena.deallocate(p, 2000);
+    }, std::bad_alloc);
+    arena.deallocate(a, 1000);
+    arena.deallocate(b, 1000);
+    auto* d = arena.allocate(2000); // a and b are coalesced
+    EXPECT_EQ(d, a);
+    arena.deallocate(c, 1000);
+    arena.deallocate(d, 2000);
+    EXPECT_EQ(arena.used(), 0);
+    EXPECT_GE(arena.peak(), 3000);
+    EXPECT_LE(arena.peak(), arena.capacity());
+    auto* all = arena.allocate(4096);
+    arena.deallocate(all, 4096);
+}
+
+TEST(sort, arena_bounded) {
+    std::random_device rd;
+    std::default_random_engine gen(rd());
+    std::uniform_int_distribution<> distrib;
+    std::vector<int> content(100000);
+    for (int& i : content) {
+        i = distrib(gen);
+    }
+    size_t cutoff = 5000;
+    std::vector<sort_options> all_options = {
+        { .cutoff = cutoff },
+        { .cutoff = cutoff, .n_tapes = 8 },
+        { .cutoff = cutoff, .runs = run_generation::replacement_selection },
+        { .cutoff = cutoff, .n_tapes = 6, .runs = run_generation::natural },
+        { .cutoff = cutoff, .pipelined_split = true, .n_threads = 2 },
+        { .cutoff = cutoff, .pipelined_merge = true },
+        { .cutoff = cutoff, .n_tapes = 7, .rewind = true },
+    };
+    for (auto options : all_options) {
+        memory_arena arena(cutoff * sizeof(int) + 4096);
+        options.memory = &arena;
+        test_sorted_vector(content, options);
+        EXPECT_EQ(arena.used(), 0);
+    }
+}
+
+TEST(sort, budget_bounded) {
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<> distrib;
+    std::vector<int> content(200000);
+    for (int& i : content) {
+        i = distrib(gen);
+    }
+    auto bytes = size_t(1) << 18;
+    std::vector<sort_options> all_options = {
+        {},
+        { .n_tapes = 8 },
+        { .n_tapes = 6, .runs = run_generation::natural },
+        { .pipelined_merge = true },
+        { .n_tapes = 7, .rewind = true },
+    };
+    for (auto options : all_options) {
+        // the buffered temporary tapes and the algorithm share the arena
+        memory_arena arena(bytes);
+        auto budget = divide_memory_budget(bytes, estimate_sort_footprint(options), 4096);
+        options.cutoff = budget.cutoff;
+        options.memory = &arena;
+        auto factory = create_buffered_tape_factory(create_temp_vector_tape, budget.buffer_size, &arena);
+        test_sorted_by(content, [&](basic_tape const& src, basic_tape& dst) {
+            return sort(src, content.size(), dst, options, factory);
+        });
+        EXPECT_EQ(arena.used(), 0);
+    }
+}
+
+TEST(counting_tape, counts) {
+    tape_counters counters;
+    counting_tape tape(std::make_unique<vector_tape>(10), counters);
+    std::vector<int> data = { 1, 2, 3, 4, 5 };
+    tape.write_n(data, direction::right);
+    ASSERT_TRUE(tape.move_right());
+    tape.write(6);
+    ASSERT_TRUE(tape.move_left());
+    std::vector<int> res(6);
+    EXPECT_EQ(tape.read_n(res, direction::left), 5);
+    tape.rewind();
+    ASSERT_EQ(tape.read(), 1);
+    ASSERT_TRUE(tape.move_right());
+    EXPECT_EQ(counters.writes, 6);
+    EXPECT_EQ(counters.reads, 6);
+    EXPECT_EQ(counters.moves_right, 6);
+    EXPECT_EQ(counters.moves_left, 5);
+    EXPECT_EQ(counters.reversals, 1);
+    EXPECT_EQ(counters.rewinds, 1);
+}
+
+TEST(counting_tape, stats_bytes) {
+    auto counters = std::deque<tape_counters>();
+    counters.push_back({ .name = "src", .element_bytes = element_bytes(tape_format::text), .reads = 5 });
+    counters.push_back({ .name = "dst", .element_bytes = element_bytes(tape_format::binary), .writes = 5 });
+    counters.push_back({ .name = "tmp1", .element_bytes = element_bytes(tape_format::compressed), .reads = 5 });
+    counters.push_back({ .name = "tmp2", .element_bytes = element_bytes(tape_format::compressed), .reads = 5,
+                         .bytes = tape_bytes{ .read = 123, .written = 45 } });
+    std::stringstream ss;
+    print_stats(sort_report{}, counters, ss);
+    auto stats = ss.str();
+    EXPECT_NE(stats.find("\"bytes_read\": 60, \"bytes_written\": 0"), std::string::npos);
+    EXPECT_NE(stats.find("\"bytes_read\": 0, \"bytes_written\": 20"), std::string::npos);
+    EXPECT_NE(stats.find("\"bytes_read\": null, \"bytes_written\": null"), std::string::npos);
+    EXPECT_NE(stats.find("\"bytes_read\": 123, \"bytes_written\": 45"), std::string::npos);
+}
+
+TEST(counting_tape, compressed_bytes) {
+    auto filename = create_temp_filename();
+    tape_counters counters{ .name = "tmp1" };
+    std::vector<int> content(5000);
+    std::iota(content.begin(), content.end(), 0);
+    uint64_t written = 0;
+    {
+        auto compressed = std::make_unique<compressed_file_tape>(filename, content.size());
+        auto* raw = compressed.get();
+        // the pool and the buffers pass the bytes through
+        auto factory = create_buffered_tape_factory([&](size_t) -> std::unique_ptr<basic_tape> {
+            return std::make_unique<counting_tape>(std::move(compressed), counters);
+        }, 100);
+        auto tape = factory(content.size());
+        tape->write_n(content, direction::right);
+        tape->rewind();
+        std::vector<int> res(content.size());
+        tape->read_n(res, direction::right);
+        EXPECT_EQ(res, content);
+        ASSERT_TRUE(tape->bytes_transferred().has_value());
+        EXPECT_EQ(tape->bytes_transferred()->read, raw->bytes_read());
+        tape->flush();
+        written = raw->bytes_written();
+    }
+    ASSERT_TRUE(counters.bytes.has_value());
+    EXPECT_GT(counters.bytes->read, 0);
+    EXPECT_EQ(counters.bytes->written, written);
+    // much less than 4 bytes per element
+    EXPECT_LT(counters.bytes->written, content.size() * sizeof(int));
+}
+
+TEST(sort, report_phases) {
+    std::vector<int> content(1000);
+    std::iota(content.rbegin(), content.rend(), 0);
+    for (auto options : { sort_options{ .cutoff = 10 }, sort_options{ .cutoff = 10, .n_tapes = 6 },
+                          sort_options{ .cutoff = 10, .n_tapes = 7, .rewind = true } }) {
+        vector_tape src(content);
+        vector_tape dst(content.size());
+        auto counters = std::deque<tape_counters>();
+        auto factory = create_counting_tape_factory(create_temp_vector_tape, counters);
+        auto report = sort(src, content.size(), dst, options, factory);
+        ASSERT_FALSE(report.phases.empty());
+        EXPECT_EQ(report.phases.front().name, "runs");
+        auto n_merges = std::count_if(report.phases.begin(), report.phases.end(),
+                                      [](auto const& phase) { return phase.name == "merge"; });
+        EXPECT_EQ(n_merges, report.n_passes);
+        EXPECT_EQ(counters.size(), options.rewind ? 6 : options.n_tapes - 1);
+        size_t writes = 0;
+        for (auto const& c : counters) {
+            writes += c.writes;
+        }
+        EXPECT_GE(writes, content.size());
+    }
+}
+
+TEST(text_codec, round_trip) {
+    char field[TEXT_FIELD_LEN + 1] = {};
+    for (int value : { 0, 1, -1, 9, 10, -10, 123456789, std::numeric_limits<int>::max(),
+                       std::numeric_limits<int>::min() }) {
+        encode_field(value, field);
+        std::stringstream ss;
+        ss << std::setw(TEXT_FIELD_LEN) << value;
+        EXPECT_EQ(std::string(field), ss.str());
+        EXPECT_EQ(decode_field(field), value);
+    }
+    EXPECT_EQ(decode_field("           "), std::nullopt);
+    EXPECT_THROW(decode_field("         1a"), std::runtime_error);
+    EXPECT_THROW(decode_field("          -"), std::runtime_error);
+    EXPECT_THROW(decode_field("  1       2"), std::runtime_error);
+    EXPECT_THROW(decode_field(" 2147483648"), std::runtime_error);
+    EXPECT_EQ(decode_field("-2147483648"), std::numeric_limits<int>::min());
+}
+
+TEST_F(file_tape_fixture, empty_elements) {
+    tape->move_right();
+    tape->write(-5);
+    auto filename = create_temp_filename();
+    {
+        std::ofstream file(filename);
+        file << std::setw(TEXT_FIELD_LEN) << 1 << ' ' << std::string(TEXT_FIELD_LEN, ' ') << ' '
+             << std::setw(TEXT_FIELD_LEN) << 3 << '\n';
+    }
+    file_tape with_empty(filename, 3);
+    EXPECT_EQ(with_empty.read_safe(), 1);
+    with_empty.move_right();
+    EXPECT_EQ(with_empty.read_safe(), std::nullopt);
+    EXPECT_EQ(with_empty.read(), 0);
+    with_empty.move_right();
+    EXPECT_EQ(with_empty.read(), 3);
+    tape->rewind();
+    std::vector<int> res(3);
+    tape->read_n(res, direction::right);
+    EXPECT_EQ(res, std::vector<int>({ 123, -5, 789 }));
+}
+
+namespace {
+    /**
+     * file_tape which throws when the shared budget of writes is exhausted, as if the process died.
+     */
+    class crashing_file_tape : public file_tape {
+    public:
+        crashing_file_tape(std::string const& filename, size_t size, size_t& budget)
+                          : file_tape(filename, size), budget(budget) {}
+
+        void write(int data) override {
+            spend(1);
+            file_tape::write(data);
+        }
+
+        size_t write_n(std::span<int const> data, direction dir) override {
+            spend(data.size());
+            return file_tape::write_n(data, dir);
+        }
+
+    private:
+        void spend(size_t n) {
+            if (budget < n) {
+                throw std::runtime_error("crash");
+            }
+            budget -= n;
+        }
+
+        size_t& budget;
+    };
+}
+
+TEST(sort, checkpoint_resume) {
+    std::random_device rd;
+    std::default_random_engine gen(rd());
+    std::uniform_int_distribution<> distrib;
+    std::vector<int> content(1000);
+    for (int& i : content) {
+        i = distrib(gen);
+    }
+    auto dst_name = create_temp_filename();
+    auto checkpoint = create_temp_filename();
+    auto tmp_names = std::vector<std::string>{ create_temp_filename(), create_temp_filename(),
+                                               create_temp_filename() };
+    size_t budget = 3500; // the split and two merge passes
+    size_t n_created = 0;
+    auto factory = [&](size_t size) {
+        return std::make_unique<crashing_file_tape>(tmp_names[n_created++ % 3], size, budget);
+    };
+    sort_options options{ .cutoff = 10, .checkpoint = checkpoint };
+    {
+        vector_tape src(content);
+        crashing_file_tape dst(dst_name, content.size(), budget);
+        ASSERT_THROW(sort(src, content.size(), dst, options, factory), std::runtime_error);
+    }
+    ASSERT_TRUE(std::filesystem::exists(checkpoint));
+
+    budget = std::numeric_limits<size_t>::max();
+    vector_tape src(content);
+    file_tape dst(dst_name, content.size());
+    EXPECT_THROW(sort(src, content.size(), dst, { .cutoff = 20, .checkpoint = checkpoint, .resume = true }, factory),
+                 std::invalid_argument);
+    options.resume = true;
+    auto report = sort(src, content.size(), dst, options, factory);
+    EXPECT_EQ(report.phases.front().name, "resume");
+    EXPECT_EQ(report.n_runs, 100);
+    EXPECT_EQ(report.n_passes, 7);
+    auto n_merges = std::count_if(report.phases.begin(), report.phases.end(),
+                                  [](auto const& phase) { return phase.name == "merge"; });
+    EXPECT_EQ(n_merges, 5);
+    EXPECT_FALSE(std::filesystem::exists(checkpoint));
+
+    std::vector<int> res(content.size());
+    dst.rewind();
+    dst.read_n(res, direction::right);
+    std::sort(content.begin(), content.end());
+    EXPECT_EQ(res, content);
+}
+
+TEST(temp_tape_pool, recycles_files) {
+    std::filesystem::path dir = "tmp/testing/temp_tape_pool_recycles";
+    std::filesystem::remove_all(dir);
+    std::vector<std::filesystem::path> files;
+    {
+        auto pool = std::make_shared<temp_tape_pool>(dir, FILE_TAPE_CONFIG_NAME, tape_format::text);
+        auto other = std::make_shared<temp_tape_pool>(dir, FILE_TAPE_CONFIG_NAME, tape_format::text);
+        auto factory = pool->factory();
+        std::vector<int> content(300);
+        std::iota(content.rbegin(), content.rend(), 0);
+        for (size_t i = 0; i < 3; ++i) {
+            vector_tape src(content);
+            vector_tape dst(content.size());
+            sort(src, content.size(), dst, 10, factory);
+            EXPECT_EQ(pool->files().size(), 3);
+        }
+        // a recycled file is empty again
+        auto tape = factory(5);
+        EXPECT_EQ(tape->read_safe(), std::nullopt);
+        // and holds valid text
+        for (auto const& file : pool->files()) {
+            EXPECT_EQ(read_file(file).find('\0'), std::string::npos);
+        }
+        // another pool doesn't take the files of the first one
+        auto other_tape = other->acquire(5);
+        EXPECT_EQ(other->files().size(), 1);
+        files = pool->files();
+        EXPECT_EQ(std::count(files.begin(), files.end(), other->files()[0]), 0);
+        for (auto const& file : files) {
+            EXPECT_TRUE(std::filesystem::exists(file));
+        }
+    }
+    for (auto const& file : files) {
+        EXPECT_FALSE(std::filesystem::exists(file));
+    }
+}
+
+TEST(temp_tape_pool, parallel_sorts) {
+    auto pool = std::make_shared<temp_tape_pool>("tmp/testing/temp_tape_pool_parallel", FILE_TAPE_CONFIG_NAME,
+                                                 tape_format::binary);
+    auto factory = pool->factory();
+    std::vector<std::thread> threads;
+    std::vector<bool> sorted(4);
+    for (size_t t = 0; t < sorted.size(); ++t) {
+        threads.emplace_back([&, t] {
+            std::vector<int> content(2000);
+            std::default_random_engine gen(t);
+            std::uniform_int_distribution<> distrib;
+            for (int& i : content) {
+                i = distrib(gen);
+            }
+            for (size_t i = 0; i < 3; ++i) {
+                vector_tape src(content);
+                vector_tape dst(content.size());
+                sort(src, content.size(), dst, 100, factory);
+                std::vector<int> res(content.size());
+                dst.rewind();
+                dst.read_n(res, direction::right);
+                sorted[t] = std::is_sorted(res.begin(), res.end());
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(sorted, std::vector<bool>(sorted.size(), true));
+    EXPECT_LE(pool->files().size(), 3 * sorted.size());
+}
+
+TEST(tape_utils, parse_path_list) {
+    EXPECT_EQ(parse_path_list("tmp"), std::vector<std::string>{ "tmp" });
+    EXPECT_EQ(parse_path_list("/mnt/a/tmp,/mnt/b/tmp"), (std::vector<std::string>{ "/mnt/a/tmp", "/mnt/b/tmp" }));
+    EXPECT_THROW(parse_path_list(""), std::invalid_argument);
+    EXPECT_THROW(parse_path_list("a,,b"), std::invalid_argument);
+}
+
+TEST(tape_utils, parse_element_type) {
+    EXPECT_EQ(parse_element_type("int32"), element_type::int32);
+    EXPECT_EQ(parse_element_type("int64"), element_type::int64);
+    EXPECT_EQ(parse_element_type("uint32"), element_type::uint32);
+    EXPECT_EQ(parse_element_type("double"), element_type::float64);
+    EXPECT_THROW(parse_element_type("int"), std::invalid_argument);
+    EXPECT_EQ(element_bytes<int64_t>(tape_format::binary), 8);
+    EXPECT_EQ(element_bytes<int64_t>(tape_format::text), element_bytes(tape_format::text));
+}
+
+namespace {
+    void test_sample_sorted(std::vector<int> const& content, size_t cutoff, std::vector<tape_factory> const& factories) {
+        auto report = test_sorted_by(content, [&](basic_tape const& src, basic_tape& dst) {
+            return sample_sort(src, content.size(), dst, { .cutoff = cutoff }, factories);
+        });
+        if (factories.size() > 1) {
+            ASSERT_EQ(report.phases.size(), 4);
+            EXPECT_EQ(report.phases.back().name, "concat");
+        }
+    }
+}
+
+TEST(sample_sort, random) {
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<> distrib(std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+    std::vector<int> content(3000);
+    for (int& i : content) {
+        i = distrib(gen);
+    }
+    for (size_t n_partitions : { 1, 2, 3, 8 }) {
+        for (size_t cutoff : { 1, 10, 100, 5000 }) {
+            test_sample_sorted(content, cutoff, std::vector<tape_factory>(n_partitions, create_temp_vector_tape));
+        }
+    }
+    test_sample_sorted({ 5, 1, 3 }, 10, std::vector<tape_factory>(8, create_temp_vector_tape));
+}
+
+TEST(sample_sort, duplicates) {
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<> distrib(0, 2);
+    std::vector<int> content(2000);
+    for (int& i : content) {
+        i = distrib(gen);
+    }
+    test_sample_sorted(content, 50, std::vector<tape_factory>(4, create_temp_vector_tape));
+    test_sample_sorted(std::vector<int>(500, 7), 50, std::vector<tape_factory>(4, create_temp_vector_tape));
+}
+
+TEST(sample_sort, own_tapes_per_partition) {
+    std::vector<int> content(4000);
+    std::iota(content.rbegin(), content.rend(), -2000);
+    std::vector<std::deque<tape_counters>> counters(4);
+    std::vector<tape_factory> factories;
+    for (size_t i = 0; i < counters.size(); ++i) {
+        auto dir = "tmp/testing/sample_sort_" + std::to_string(i);
+        factories.push_back(create_counting_tape_factory(create_file_tape_factory(FILE_TAPE_CONFIG_NAME,
+                                                                                  tape_format::binary, dir),
+                                                         counters[i]));
+    }
+    test_sample_sorted(content, 100, factories);
+    for (auto const& partition_counters : counters) {
+        // the partition, its sorted copy and the temporary tapes of sort()
+        ASSERT_EQ(partition_counters.size(), 5);
+        for (auto const& c : partition_counters) {
+            EXPECT_GT(c.writes, 0);
+        }
+    }
+}
+
+TEST(sample_sort, partitions_sized_by_estimates) {
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<> distrib(-100000, 100000);
+    std::vector<int> content(8000);
+    for (int& i : content) {
+        i = distrib(gen);
+    }
+    std::vector<std::vector<size_t>> sizes(4);
+    std::vector<tape_factory> factories;
+    for (auto& partition_sizes : sizes) {
+        factories.emplace_back([&partition_sizes](size_t size) {
+            partition_sizes.push_back(size);
+            return create_temp_vector_tape(size);
+        });
+    }
+    test_sample_sorted(content, 1000, factories);
+    for (auto const& partition_sizes : sizes) {
+        ASSERT_FALSE(partition_sizes.empty());
+        EXPECT_LT(partition_sizes.front(), content.size() / 2);
+    }
+}
+
+TEST(sample_sort, budget_bounded) {
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<> distrib;
+    // the partitions generate their runs at the same time
+    std::vector<int> content(1000000);
+    for (int& i : content) {
+        i = distrib(gen);
+    }
+    size_t n_partitions = 3;
+    auto bytes = size_t(3) << 18;
+    std::vector<sort_options> all_options = {
+        {},
+        { .n_tapes = 7, .rewind = true },
+    };
+    for (auto options : all_options) {
+        // each partition gets its share of the budget; the buffers of the tapes have a region of their own
+        auto budget = divide_memory_budget(bytes / n_partitions,
+                                           estimate_sample_sort_footprint(options, n_partitions), 4096);
+        memory_arena arena(bytes - budget.io_bytes * n_partitions);
+        memory_arena io_arena(budget.io_bytes * n_partitions);
+        options.cutoff = budget.cutoff * n_partitions;
+        options.memory = &arena;
+        auto factories = std::vector<tape_factory>(
+                n_partitions, create_buffered_tape_factory(create_temp_vector_tape, budget.buffer_size, &io_arena));
+        auto report = test_sorted_by(content, [&](basic_tape const& src, basic_tape& dst) {
+            return sample_sort(src, content.size(), dst, options, factories);
+        });
+        EXPECT_GT(report.n_runs, n_partitions);
+        EXPECT_EQ(arena.used(), 0);
+        EXPECT_EQ(io_arena.used(), 0);
+    }
+}
+
+namespace {
+    sort_report test_distribution_sorted(std::vector<int> content, sort_options options) {
+        options.engine = sort_engine::distribution;
+        return test_sorted_vector(std::move(content), options);
+    }
+}
+
+TEST(sort, parse_sort_engine) {
+    EXPECT_EQ(parse_sort_engine("merge"), sort_engine::merge);
+    EXPECT_EQ(parse_sort_engine("distribution"), sort_engine::distribution);
+    EXPECT_THROW(parse_sort_engine("bucket"), std::invalid_argument);
+}
+
+TEST(sort, distribution_all_cutoffs) {
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<> distrib(-50, 50);
+    for (size_t count = 1; count < 70; ++count) {
+        std::vector<int> content(count);
+        for (int& i : content) {
+            i = distrib(gen);
+        }
+        for (size_t cutoff = 1; cutoff <= count; ++cutoff) {
+            test_distribution_sorted(content, { .cutoff = cutoff });
+            test_distribution_sorted(content, { .cutoff = cutoff, .n_buckets = 2 });
+        }
+    }
+}
+
+TEST(sort, distribution_random) {
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<> distrib(std::numeric_limits<int>::min(), std::numeric_limits<int>::max());
+    std::vector<int> content(20000);
+    for (int& i : content) {
+        i = distrib(gen);
+    }
+    auto report = test_distribution_sorted(content, { .cutoff = 1000 });
+    EXPECT_LE(report.n_distribution_passes, 2);
+    EXPECT_EQ(report.n_merged_buckets, 0);
+    ASSERT_EQ(report.phases.size(), 2);
+    EXPECT_EQ(report.phases.front().name, "distribute");
+}
+
+TEST(sort, distribution_buckets_sized_by_estimates) {
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<> distrib(-100000, 100000);
+    std::vector<int> content(20000);
+    for (int& i : content) {
+        i = distrib(gen);
+    }
+    std::vector<size_t> sizes;
+    auto factory = [&sizes](size_t size) {
+        sizes.push_back(size);
+        return create_temp_vector_tape(size);
+    };
+    test_sorted_by(content, [&](basic_tape const& src, basic_tape& dst) {
+        return sort(src, content.size(), dst, { .cutoff = 1000, .engine = sort_engine::distribution }, factory);
+    });
+    ASSERT_FALSE(sizes.empty());
+    EXPECT_LT(*std::max_element(sizes.begin(), sizes.end()), content.size() / 10);
+}
+
+TEST(sort, distribution_duplicates) {
+    auto report = test_distribution_sorted(std::vector<int>(5000, 7), { .cutoff = 100 });
+    EXPECT_EQ(report.n_distribution_passes, 1);
+    EXPECT_EQ(report.n_merged_buckets, 0);
+
+    std::vector<int> edges(3000, std::numeric_limits<int>::max());
+    std::fill(edges.begin(), edges.begin() + 1000, std::numeric_limits<int>::min());
+    report = test_distribution_sorted(edges, { .cutoff = 100 });
+    EXPECT_EQ(report.n_merged_buckets, 0);
+
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<> distrib(0, 3);
+    std::vector<int> content(5000);
+    for (int& i : content) {
+        i = distrib(gen);
+    }
+    report = test_distribution_sorted(content, { .cutoff = 100 });
+    EXPECT_EQ(report.n_merged_buckets, 0);
+}
+
+TEST(sort, distribution_overflow_merged) {
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<> distrib;
+    std::vector<int> content(5000);
+    for (int& i : content) {
+        i = distrib(gen);
+    }
+    // two buckets per pass cannot reduce 5000 elements to 100 in two passes
+    auto report = test_distribution_sorted(content, { .cutoff = 100, .n_tapes = 6, .n_buckets = 2 });
+    EXPECT_EQ(report.n_distribution_passes, 2);
+    EXPECT_GT(report.n_merged_buckets, 0);
+    EXPECT_GT(report.n_passes, 0);
+}
+
+TEST(sort, distribution_budget_bounded) {
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<> distrib;
+    std::uniform_int_distribution<> few_keys(0, 50);
+    std::vector<int> random(200000), duplicates(200000);
+    for (size_t i = 0; i < random.size(); ++i) {
+        random[i] = distrib(gen);
+        duplicates[i] = few_keys(gen);
+    }
+    auto bytes = size_t(1) << 17;
+    for (auto const* content : { &random, &duplicates }) {
+        for (size_t n_buckets : { 0, 2, 1000 }) {
+            auto options = sort_options{ .engine = sort_engine::distribution, .n_buckets = n_buckets };
+            auto budget = divide_memory_budget(bytes, estimate_sort_footprint(options), 4096);
+            EXPECT_EQ(budget.buffer_size, 0);
+            memory_arena arena(bytes);
+            options.cutoff = budget.cutoff;
+            options.memory = &arena;
+            test_sorted_vector(*content, options);
+            EXPECT_EQ(arena.used(), 0);
+        }
+    }
+    // the splitters of too many buckets don't fit into the budget
+    auto options = sort_options{ .engine = sort_engine::distribution, .n_buckets = bytes };
+    EXPECT_THROW(divide_memory_budget(bytes, estimate_sort_footprint(options), 4096), std::invalid_argument);
+}
+
+TEST(sort, distribution_no_checkpoints) {
+    vector_tape src({ 3, 1, 2 });
+    vector_tape dst(3);
+    EXPECT_THROW(sort(src, 3, dst, { .cutoff = 1, .checkpoint = "tmp/testing/distribution.ckpt",
+                                     .engine = sort_engine::distribution }, create_temp_vector_tape),
+                 std::invalid_argument);
+}
+
+namespace {
+    template <tape_element T>
+    void test_typed_sorted(std::vector<T> const& content) {
+        for (sort_options options : { sort_options{ .cutoff = 7 },
+                                      sort_options{ .cutoff = 7, .n_tapes = 8 },
+                                      sort_options{ .cutoff = 7, .runs = run_generation::replacement_selection },
+                                      sort_options{ .cutoff = 7, .runs = run_generation::natural },
+                                      sort_options{ .cutoff = 7, .pipelined_merge = true },
+                                      sort_options{ .cutoff = 7, .n_tapes = 6, .rewind = true },
+                                      sort_options{ .cutoff = 7, .engine = sort_engine::distribution } }) {
+            test_sorted_vector(content, options);
+        }
+    }
+}
+
+TEST(typed_sort, int64) {
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<int64_t> distrib(std::numeric_limits<int64_t>::min(),
+                                                   std::numeric_limits<int64_t>::max());
+    std::vector<int64_t> content(1000);
+    for (int64_t& i : content) {
+        i = distrib(gen);
+    }
+    content[0] = std::numeric_limits<int64_t>::max();
+    content[1] = std::numeric_limits<int64_t>::min();
+    test_typed_sorted(content);
+    test_typed_sorted(std::vector<int64_t>(500, std::numeric_limits<int64_t>::max()));
+}
+
+TEST(typed_sort, uint32) {
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<uint32_t> distrib;
+    std::vector<uint32_t> content(1000);
+    for (uint32_t& i : content) {
+        i = distrib(gen);
+    }
+    content[0] = std::numeric_limits<uint32_t>::max();
+    content[1] = 0;
+    test_typed_sorted(content);
+    test_typed_sorted(std::vector<uint32_t>(500, std::numeric_limits<uint32_t>::max()));
+}
+
+TEST(typed_sort, double) {
+    std::default_random_engine gen(42);
+    std::normal_distribution<double> distrib(0, 1e6);
+    std::vector<double> content(1000);
+    for (double& x : content) {
+        x = distrib(gen);
+    }
+    content[0] = std::numeric_limits<double>::infinity();
+    content[1] = -std::numeric_limits<double>::infinity();
+    content[2] = -0.0;
+    content[3] = 0.0;
+    content[4] = std::numeric_limits<double>::denorm_min();
+    test_typed_sorted(content);
+    test_typed_sorted(std::vector<double>(500, -std::numeric_limits<double>::infinity()));
+}
+
+TEST(typed_sort, binary_file_tapes) {
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<int64_t> distrib(std::numeric_limits<int64_t>::min(),
+                                                   std::numeric_limits<int64_t>::max());
+    std::vector<int64_t> content(1000);
+    for (int64_t& i : content) {
+        i = distrib(gen);
+    }
+    auto src_filename = create_temp_filename();
+    auto dst_filename = create_temp_filename();
+    std::filesystem::remove(src_filename);
+    std::filesystem::remove(dst_filename);
+    auto factory = [](size_t size) -> std::unique_ptr<typed_tape<int64_t>> {
+        return std::make_unique<typed_binary_file_tape<int64_t>>(create_temp_filename(), size, FILE_TAPE_CONFIG_NAME);
+    };
+    {
+        typed_binary_file_tape<int64_t> src(src_filename, content.size(), FILE_TAPE_CONFIG_NAME);
+        src.write_n(content, direction::right);
+        src.rewind();
+        typed_binary_file_tape<int64_t> dst(dst_filename, content.size(), FILE_TAPE_CONFIG_NAME);
+        sort(src, content.size(), dst, 7, factory);
+    }
+    // 8 bytes per element and a bit of the filled flag
+    EXPECT_EQ(std::filesystem::file_size(dst_filename), content.size() * 8 + (content.size() + 7) / 8);
+    typed_binary_file_tape<int64_t> dst(dst_filename, content.size(), FILE_TAPE_CONFIG_NAME);
+    std::vector<int64_t> res(content.size());
+    dst.read_n(res, direction::right);
+    std::sort(content.begin(), content.end());
+    ASSERT_EQ(res, content);
+}
+
+TEST(typed_sort, file_tape_factories) {
+    // the tapes of the CLI: file tapes, and temporary ones from a pool, counted and buffered
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<int64_t> distrib(std::numeric_limits<int64_t>::min(),
+                                                   std::numeric_limits<int64_t>::max());
+    std::vector<int64_t> content(1000);
+    for (int64_t& i : content) {
+        i = distrib(gen);
+    }
+    EXPECT_THROW(create_file_tape<int64_t>(create_temp_filename(), 5, FILE_TAPE_CONFIG_NAME, tape_format::text),
+                 std::invalid_argument);
+    auto pool = std::make_shared<temp_tape_pool>("tmp/testing/typed_sort_factories", FILE_TAPE_CONFIG_NAME,
+                                                 tape_format::binary);
+    EXPECT_THROW(std::make_shared<temp_tape_pool>("tmp/testing/typed_sort_factories", FILE_TAPE_CONFIG_NAME,
+                                                  tape_format::compressed)->acquire<int64_t>(5),
+                 std::invalid_argument);
+    std::deque<tape_counters> counters;
+    auto factory = create_counting_tape_factory<int64_t>(pool->factory<int64_t>(), counters, "tmp",
+                                                         element_bytes<int64_t>(tape_format::binary));
+    factory = create_buffered_tape_factory<int64_t>(std::move(factory), 16);
+    auto src_filename = create_temp_filename();
+    auto dst_filename = create_temp_filename();
+    std::filesystem::remove(src_filename);
+    std::filesystem::remove(dst_filename);
+    auto src = create_file_tape<int64_t>(src_filename, content.size(), FILE_TAPE_CONFIG_NAME, tape_format::binary);
+    src->write_n(content, direction::right);
+    src->rewind();
+    auto dst = create_file_tape<int64_t>(dst_filename, content.size(), FILE_TAPE_CONFIG_NAME, tape_format::binary);
+    sort(*src, content.size(), *dst, { .cutoff = 50, .n_tapes = 6 }, factory);
+    dst->rewind();
+    std::vector<int64_t> res(content.size());
+    dst->read_n(res, direction::right);
+    std::sort(content.begin(), content.end());
+    EXPECT_EQ(res, content);
+    ASSERT_FALSE(counters.empty());
+    EXPECT_GT(counters[0].writes, 0);
+    EXPECT_EQ(counters[0].element_bytes, 8);
+}
+
+TEST(radix_sort, typed) {
+    std::vector<double> doubles = { 1.5, -0.0, 0.0, -1.5, std::numeric_limits<double>::infinity(), -1e300, 1e-300,
+                                    -std::numeric_limits<double>::infinity(), std::numeric_limits<double>::lowest() };
+    std::vector<uint32_t> uints = { 0, std::numeric_limits<uint32_t>::max(), 1u << 31, (1u << 31) - 1, 256, 255 };
+    std::vector<int64_t> longs = { 0, std::numeric_limits<int64_t>::max(), -1, std::numeric_limits<int64_t>::min(),
+                                   int64_t{1} << 32, -(int64_t{1} << 32) };
+    for (int i = 0; i < 1000; ++i) {
+        doubles.push_back(i % 2 ? i * 1e10 : -i * 1e-10);
+        uints.push_back(std::numeric_limits<uint32_t>::max() - i * 7919u);
+        longs.push_back(i % 2 ? std::numeric_limits<int64_t>::min() + i * 104729 : std::numeric_limits<int64_t>::max() - i);
+    }
+    auto expected_doubles = doubles;
+    std::sort(expected_doubles.begin(), expected_doubles.end(), element_less<double>());
+    radix_sort(doubles);
+    ASSERT_TRUE(std::equal(doubles.begin(), doubles.end(), expected_doubles.begin(), [](double a, double b) {
+        return std::bit_cast<uint64_t>(a) == std::bit_cast<uint64_t>(b);
+    }));
+    auto expected_uints = uints;
+    std::sort(expected_uints.begin(), expected_uints.end());
+    radix_sort(uints);
+    ASSERT_EQ(uints, expected_uints);
+    auto expected_longs = longs;
+    std::sort(expected_longs.begin(), expected_longs.end());
+    radix_sort(longs);
+    ASSERT_EQ(longs, expected_longs);
+}
+
+TEST(tape_element, next_element) {
+    EXPECT_EQ(next_element(41), 42);
+    EXPECT_FALSE(next_element(std::numeric_limits<int>::max()).has_value());
+    EXPECT_FALSE(next_element(std::numeric_limits<uint32_t>::max()).has_value());
+    EXPECT_EQ(next_element(-0.0), 0.0);
+    EXPECT_EQ(next_element(0.0), std::numeric_limits<double>::denorm_min());
+    EXPECT_EQ(next_element(-std::numeric_limits<double>::denorm_min()), -0.0);
+    EXPECT_EQ(next_element(1.0), std::nextafter(1.0, 2.0));
+    EXPECT_EQ(next_element(-1.0), std::nextafter(-1.0, 0.0));
+}
+
+namespace {
+    /**
+     * Records with keys in [0, n_keys) whose payloads are their input positions.
+     */
+    std::vector<row_id_record> numbered_records(size_t size, int64_t n_keys) {
+        std::default_random_engine gen(42);
+        std::uniform_int_distribution<int64_t> distrib(0, n_keys - 1);
+        std::vector<row_id_record> content(size);
+        for (size_t i = 0; i < size; ++i) {
+            content[i] = { distrib(gen), i };
+        }
+        return content;
+    }
+}
+
+TEST(record_sort, stable_all_cutoffs) {
+    auto content = numbered_records(500, 10);
+    for (size_t cutoff = 1; cutoff < 40; ++cutoff) {
+        test_sorted_vector(content, { .cutoff = cutoff });
+        test_sorted_vector(content, { .cutoff = cutoff, .pipelined_merge = true });
+        test_sorted_vector(content, { .cutoff = cutoff, .n_tapes = 6 });
+        test_sorted_vector(content, { .cutoff = cutoff, .n_tapes = 9 });
+        test_sorted_vector(content, { .cutoff = cutoff, .n_tapes = 7, .rewind = true });
+        test_sorted_vector(content, { .cutoff = cutoff, .runs = run_generation::natural });
+        test_sorted_vector(content, { .cutoff = cutoff, .engine = sort_engine::distribution });
+    }
+}
+
+TEST(record_sort, stable_runs) {
+    auto content = numbered_records(100000, 100);
+    test_sorted_vector(content, { .cutoff = 1000, .runs = run_generation::replacement_selection });
+    test_sorted_vector(content, { .cutoff = 90000, .pipelined_split = true, .n_threads = 4 });
+    // descending blocks with equal keys are not reversed
+    std::sort(content.begin(), content.end(), element_greater<row_id_record>());
+    test_sorted_vector(content, { .cutoff = 1000, .runs = run_generation::natural });
+    for (size_t i = 0; i < content.size(); ++i) {
+        content[i] = { -static_cast<int64_t>(i), i };
+    }
+    test_sorted_vector(content, { .cutoff = 1000, .runs = run_generation::natural });
+}
+
+TEST(record_sort, stable_sample_sort) {
+    auto content = numbered_records(3000, 5);
+    auto factories = std::vector<typed_tape_factory<row_id_record>>(3, create_temp_typed_vector_tape<row_id_record>);
+    test_sorted_by(content, [&](typed_tape<row_id_record> const& src, typed_tape<row_id_record>& dst) {
+        return sample_sort(src, content.size(), dst, { .cutoff = 100 }, factories);
+    });
+}
+
+TEST(record_sort, binary_file_tapes) {
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<int64_t> distrib(-3, 3);
+    std::vector<payload_record> content(1000);
+    for (size_t i = 0; i < content.size(); ++i) {
+        content[i].key = distrib(gen);
+        for (size_t j = 0; j < content[i].payload.size(); ++j) {
+            content[i].payload[j] = static_cast<std::byte>(i * 31 + j);
+        }
+    }
+    auto src_filename = create_temp_filename();
+    auto dst_filename = create_temp_filename();
+    std::filesystem::remove(src_filename);
+    std::filesystem::remove(dst_filename);
+    auto factory = [](size_t size) -> std::unique_ptr<typed_tape<payload_record>> {
+        return std::make_unique<typed_binary_file_tape<payload_record>>(create_temp_filename(), size,
+                                                                        FILE_TAPE_CONFIG_NAME);
+    };
+    {
+        typed_binary_file_tape<payload_record> src(src_filename, content.size(), FILE_TAPE_CONFIG_NAME);
+        src.write_n(content, direction::right);
+        src.rewind();
+        typed_binary_file_tape<payload_record> dst(dst_filename, content.size(), FILE_TAPE_CONFIG_NAME);
+        sort(src, content.size(), dst, 16, factory);
+    }
+    // 8 bytes of a key, 16 bytes of a payload and a bit of the filled flag
+    EXPECT_EQ(std::filesystem::file_size(dst_filename), content.size() * 24 + (content.size() + 7) / 8);
+    typed_binary_file_tape<payload_record> dst(dst_filename, content.size(), FILE_TAPE_CONFIG_NAME);
+    std::vector<payload_record> res(content.size());
+    dst.read_n(res, direction::right);
+    std::stable_sort(content.begin(), content.end(), element_less<payload_record>());
+    for (size_t i = 0; i < res.size(); ++i) {
+        ASSERT_EQ(res[i].key, content[i].key);
+        ASSERT_EQ(res[i].payload, content[i].payload);
+    }
+}
+
+namespace {
+    template <tape_element T>
+    sort_report test_top_k(std::vector<T> const& content, size_t top, bool largest, sort_options const& options) {
+        SCOPED_TRACE("top " + std::to_string(top) + (largest ? " largest" : " least"));
+        auto select = [&](typed_tape<T> const& src, typed_tape<T>& dst) {
+            return top_k(src, content.size(), top, largest, dst, options, create_temp_typed_vector_tape<T>);
+        };
+        return largest ? test_sorted_by<T, element_greater<T>>(content, select, top)
+                       : test_sorted_by<T, element_less<T>>(content, select, top);
+    }
+}
+
+TEST(top_k, all_cutoffs) {
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<> distrib(-1000, 1000);
+    std::vector<int> content(1000);
+    for (int& i : content) {
+        i = distrib(gen);
+    }
+    for (size_t top : { 1, 2, 5, 49, 50, 51, 300, 999, 1000, 5000 }) {
+        for (size_t cutoff : { 1, 2, 3, 7, 100, 1000, 10000 }) {
+            for (bool largest : { false, true }) {
+                test_top_k(content, top, largest, { .cutoff = cutoff });
+                test_top_k(content, top, largest, { .cutoff = cutoff, .n_tapes = 9 });
+            }
+        }
+    }
+}
+
+TEST(top_k, in_ram) {
+    std::vector<int> content(10000);
+    std::iota(content.begin(), content.end(), 0);
+    std::shuffle(content.begin(), content.end(), std::default_random_engine(42));
+    auto report = test_top_k(content, 100, true, { .cutoff = 1000 });
+    ASSERT_EQ(report.phases.size(), 1);
+    EXPECT_EQ(report.phases[0].name, "select");
+    EXPECT_EQ(report.n_runs, 0);
+    EXPECT_EQ(report.n_pruned, 9900);
+}
+
+TEST(top_k, prunes_runs) {
+    // each block is better than the previous ones, so nothing can be pruned
+    std::vector<int> content(10000);
+    std::iota(content.rbegin(), content.rend(), 0);
+    auto report = test_top_k(content, 1000, false, { .cutoff = 500 });
+    EXPECT_EQ(report.n_runs, 20);
+    EXPECT_EQ(report.n_pruned, 0);
+    // the first two blocks are the best, so the others are discarded before sorting
+    std::reverse(content.begin(), content.end());
+    report = test_top_k(content, 1000, false, { .cutoff = 500 });
+    EXPECT_EQ(report.n_runs, 2);
+    EXPECT_EQ(report.n_passes, 1);
+    EXPECT_EQ(report.n_pruned, 9000);
+}
+
+TEST(top_k, budget_bounded) {
+    std::default_random_engine gen(42);
+    std::uniform_int_distribution<> distrib;
+    auto bytes = size_t(1) << 18;
+    // a single run (it is copied to dst) and several runs which are merged
+    for (size_t count : { 40000, 200000 }) {
+        std::vector<int> content(count);
+        for (int& i : content) {
+            i = distrib(gen);
+        }
+        for (size_t n_tapes : { 4, 7 }) {
+            for (bool largest : { false, true }) {
+                // the selected elements don't fit into RAM, so the runs are written to buffered tapes
+                memory_arena arena(bytes);
+                auto options = sort_options{ .n_tapes = n_tapes, .memory = &arena };
+                auto budget = divide_memory_budget(bytes, estimate_top_k_footprint(options), 4096);
+                options.cutoff = budget.cutoff;
+                auto factory = create_buffered_tape_factory(create_temp_vector_tape, budget.buffer_size, &arena);
+                auto select = [&](basic_tape const& src, basic_tape& dst) {
+                    return top_k(src, count, count * 3 / 4, largest, dst, options, factory);
+                };
+                auto report = largest ? test_sorted_by<int, element_greater<int>>(content, select, count * 3 / 4)
+                                      : test_sorted_by<int, element_less<int>>(content, select, count * 3 / 4);
+                EXPECT_EQ(report.n_runs > 1, count > options.cutoff);
+                EXPECT_EQ(arena.used(), 0);
+            }
+        }
+    }
+}
+
+TEST(top_k, stable_records) {
+    auto content = numbered_records(2000, 7);
+    for (size_t top : { 10, 300, 1500 }) {
+        for (size_t cutoff : { 3, 100, 10000 }) {
+            for (bool largest : { false, true }) {
+                test_top_k(content, top, largest, { .cutoff = cutoff });
+            }
+        }
+    }
+}
+
+TEST(top_k, no_checkpoints) {
+    vector_tape src({ 3, 1, 2 });
+    vector_tape dst(1);
+    EXPECT_THROW(top_k(src, 3, 1, false, dst, { .cutoff = 1, .checkpoint = "tmp/testing/top.ckpt" },
+                       create_temp_vector_tape),
+                 std::invalid_argument);
+}
@@ -0,0 +1,153 @@
+#include "text_codec.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+static_assert(TEXT_FIELD_LEN == std::numeric_limits<int>::digits10 + 2, "a field must fit any int with its sign");
+
+namespace {
+    constexpr uint64_t ONES = 0x0101010101010101;
+
+    constexpr auto DIGIT_PAIRS = [] {
+        std::array<char, 200> pairs{};
+        for (size_t i = 0; i < 100; ++i) {
+            pairs[2 * i] = static_cast<char>('0' + i / 10);
+            pairs[2 * i + 1] = static_cast<char>('0' + i % 10);
+        }
+        return pairs;
+    }();
+
+    [[noreturn]] void throw_corrupted(char const* field) {
+        throw std::runtime_error("file corrupted: " + std::string(field, TEXT_FIELD_LEN));
+    }
+
+    std::optional<int> to_int(uint64_t value, bool negative, char const* field) {
+        auto limit = static_cast<uint64_t>(std::numeric_limits<int>::max()) + negative;
+        if (value > limit) {
+            throw_corrupted(field);
+        }
+        return negative ? static_cast<int>(-static_cast<int64_t>(value)) : static_cast<int>(value);
+    }
+
+    std::optional<int> decode_field_scalar(char const* field) {
+        if (std::all_of(field, field + TEXT_FIELD_LEN, [](char c) { return c == '\0'; })) {
+            return {};
+        }
+        size_t i = 0;
+        while (i < TEXT_FIELD_LEN && field[i] == ' ') {
+            i++;
+        }
+        if (i == TEXT_FIELD_LEN) {
+            return {};
+        }
+        bool negative = field[i] == '-';
+        if (negative && ++i == TEXT_FIELD_LEN) {
+            throw_corrupted(field);
+        }
+        uint64_t value = 0;
+        for (; i < TEXT_FIELD_LEN; ++i) {
+            auto digit = static_cast<unsigned>(field[i]) - '0';
+            if (digit > 9) {
+                throw_corrupted(field);
+            }
+            value = value * 10 + digit;
+        }
+        return to_int(value, negative, field);
+    }
+
+    // The functions below work on 8 characters loaded into a little-endian word (the first one is the lowest byte).
+
+    /**
+     * Replaces the lowest `n` characters of `word` with '0'.
+     */
+    uint64_t zero_prefix(uint64_t word, size_t n) {
+        if (n == 0) {
+            return word;
+        }
+        auto mask = n >= 8 ? ~uint64_t{0} : (uint64_t{1} << (8 * n)) - 1;
+        return (word & ~mask) | ('0' * ONES & mask);
+    }
+
+    bool is_eight_digits(uint64_t word) {
+        return ((word & 0xF0F0F0F0F0F0F0F0) | (((word + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4))
+               == 0x3333333333333333;
+    }
+
+    /**
+     * Combines 8 digits pairwise, then by 4 and by 8 with three multiplications.
+     */
+    uint32_t parse_eight_digits(uint64_t word) {
+        word -= '0' * ONES;
+        word = word * 10 + (word >> 8);
+        word = ((word & 0x000000FF000000FF) * (100 + (1000000ULL << 32)) +
+                ((word >> 16) & 0x000000FF000000FF) * (1 + (10000ULL << 32))) >> 32;
+        return static_cast<uint32_t>(word);
+    }
+}
+
+std::optional<int> decode_field(char const* field) {
+    if constexpr (std::endian::native != std::endian::little) {
+        return decode_field_scalar(field);
+    }
+    uint64_t head;
+    uint64_t tail;
+    std::memcpy(&head, field, 8);
+    std::memcpy(&tail, field + TEXT_FIELD_LEN - 8, 8);
+    if ((head | tail) == 0) {
+        return {};
+    }
+
+    size_t start;
+    if (auto non_space = head ^ (' ' * ONES); non_space != 0) {
+        start = static_cast<size_t>(std::countr_zero(non_space)) / 8;
+    } else {
+        start = 8;
+        while (start < TEXT_FIELD_LEN && field[start] == ' ') {
+            start++;
+        }
+        if (start == TEXT_FIELD_LEN) {
+            return {};
+        }
+    }
+    bool negative = field[start] == '-';
+    auto digits_start = start + negative;
+    if (digits_start == TEXT_FIELD_LEN) {
+        throw_corrupted(field);
+    }
+
+    // the first 3 characters preceded by five zeros, and the last 8 characters
+    constexpr size_t n_high = TEXT_FIELD_LEN - 8;
+    auto high = zero_prefix((head << 8 * (8 - n_high)) | ('0' * ONES >> 8 * n_high), 8 - n_high + digits_start);
+    auto low = zero_prefix(tail, digits_start > n_high ? digits_start - n_high : 0);
+    if (!is_eight_digits(high) || !is_eight_digits(low)) {
+        throw_corrupted(field);
+    }
+    auto value = uint64_t{parse_eight_digits(high)} * 100000000 + parse_eight_digits(low);
+    return to_int(value, negative, field);
+}
+
+void encode_field(int value, char* field) {
+    auto u = value < 0 ? 0u - static_cast<unsigned>(value) : static_cast<unsigned>(value);
+    auto i = TEXT_FIELD_LEN;
+    while (u >= 100) {
+        i -= 2;
+        std::memcpy(field + i, &DIGIT_PAIRS[2 * (u % 100)], 2);
+        u /= 100;
+    }
+    if (u >= 10) {
+        i -= 2;
+        std::memcpy(field + i, &DIGIT_PAIRS[2 * u], 2);
+    } else {
+        field[--i] = static_cast<char>('0' + u);
+    }
+    if (value < 0) {
+        field[--i] = '-';
+    }
+    std::memset(field, ' ', i);
+}
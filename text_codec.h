@@ -0,0 +1,33 @@
+#ifndef YADRO_TATLIN_TEST_TASK_TEXT_CODEC_H
+#define YADRO_TATLIN_TEST_TASK_TEXT_CODEC_H
+
+#include <cstddef>
+#include <optional>
+
+/**
+ * Codec of an element of the text tape format (see README.md): a field of TEXT_FIELD_LEN characters
+ * which holds a right-aligned decimal number padded with spaces, or only spaces for an empty element.
+ * A field of zero bytes is read as an empty element too.
+ * Works directly on the field without streams, allocations or exceptions (except for corrupted fields).
+ */
+
+/**
+ * Length of a field, which is enough for any int (the length of "-2147483648").
+ */
+constexpr size_t TEXT_FIELD_LEN = 11;
+
+/**
+ * Parses a field.
+ * @param field TEXT_FIELD_LEN characters
+ * @return the number stored in the field, or null optional if the field is empty
+ * @throws std::runtime_error if the field is corrupted
+ */
+std::optional<int> decode_field(char const* field);
+
+/**
+ * Formats `value` into a field.
+ * @param field where to write TEXT_FIELD_LEN characters
+ */
+void encode_field(int value, char* field);
+
+#endif //YADRO_TATLIN_TEST_TASK_TEXT_CODEC_H
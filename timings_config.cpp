@@ -0,0 +1,65 @@
+#include "timings_config.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wshadow"
+
+timings_config::timings_config(std::string const& filename) {
+    std::ifstream file(filename);
+    if (!file) {
+        throw std::runtime_error("cannot open config file " + filename);
+    }
+    std::string entry;
+    while (file >> entry) {
+        auto pos = entry.find('=');
+        if (pos == std::string::npos) {
+            continue;
+        }
+
+        auto field = std::string_view(entry.begin(), entry.begin() + pos);  // NOLINT(*-narrowing-conversions)
+        try {
+            auto value = std::chrono::milliseconds{std::stoull(entry.substr(pos + 1))};
+            if (field == "rewind") {
+                rewind = value;
+            } else if (field.starts_with('r')) {
+                read = value;
+            } else if (field.starts_with('w')) {
+                write = value;
+            } else if (field == "move_left" || field == "ml") {
+                move_left = value;
+            } else if (field == "move_right" || field == "mr") {
+                move_right = value;
+            }
+        } catch (std::invalid_argument& e) {
+            continue;
+        } catch (std::out_of_range& e) {
+            continue;
+        }
+    }
+}
+
+#pragma clang diagnostic pop
+
+std::string timings_config::to_string() const {
+    std::stringstream ss;
+    ss << "read=" << read << " write=" << write;
+    ss << " move_left=" << move_left << " move_right=" << move_right;
+    ss << " rewind=" << rewind;
+    return ss.str();
+}
+
+timings_config timings_config::load_or_create(std::string const& filename) {
+    try {
+        return timings_config(filename);
+    } catch (std::runtime_error& ignored) {
+        timings_config timings;
+        std::ofstream config_file(filename);
+        if (config_file) {
+            config_file << timings.to_string() << std::endl;
+        }
+        return timings;
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef YADRO_TATLIN_TEST_TASK_TIMINGS_CONFIG_H
+#define YADRO_TATLIN_TEST_TASK_TIMINGS_CONFIG_H
+
+#include <chrono>
+#include <string>
+
+/**
+ * Delays of IO operations which are used to simulate a real tape.
+ */
+struct timings_config {
+    std::chrono::milliseconds read{0};
+    std::chrono::milliseconds write{0};
+    std::chrono::milliseconds move_left{0};
+    std::chrono::milliseconds move_right{0};
+    std::chrono::milliseconds rewind{0};
+
+    timings_config() = default;
+    /**
+     * Attempts to parse `filename` and update default timings values from a content of the file.
+     * Allowed format: 'r' or "read" for read timing, 'w' or "write" for write timing,
+     * "ml" or "move_left" for move_left timing, "mr" or "move_right" for move_right timing,
+     * "rewind" for "rewind" timing.
+     * Timings are measured in milliseconds.
+     * Field name must be followed by '=' and field value.
+     * Optionally, the value can be followed by 'ms' suffix.
+     * Example: "mr=1337 r=123  move_left=42ms rewind=101" (without quotes).
+     * Result: { .read=123, .write=0, .move_left=42, .move_right=1337, .rewind=101 }.
+     * @param filename path to the config file
+     */
+    explicit timings_config(std::string const& filename);
+    [[nodiscard]] std::string to_string() const;
+
+    /**
+     * Attempts to parse timings from `filename`. If the file cannot be opened,
+     * an attempt to write default timings to it is being made, and default timings are returned.
+     * @param filename path to the config file or to the desired location where to create it
+     * @return parsed or default timings
+     */
+    static timings_config load_or_create(std::string const& filename);
+};
+
+#endif //YADRO_TATLIN_TEST_TASK_TIMINGS_CONFIG_H
@@ -1,37 +1,45 @@
 #include "vector_tape.h"
+
+#include <algorithm>
 #include <stdexcept>
 
-vector_tape::vector_tape(size_t size) : v(size), empty(size, true) {
+template <tape_element T>
+typed_vector_tape<T>::typed_vector_tape(size_t size) : v(size), empty(size, true) {
     if (size == 0) {
         throw std::invalid_argument("size of a tape cannot be zero");
     }
 }
 
-vector_tape::vector_tape(std::vector<int> content) : v(std::move(content)), empty(0) {
+template <tape_element T>
+typed_vector_tape<T>::typed_vector_tape(std::vector<T> content) : v(std::move(content)), empty(0) {
     if (v.empty()) {
         throw std::invalid_argument("size of a tape cannot be zero");
     }
 }
 
-int vector_tape::read() const {
+template <tape_element T>
+T typed_vector_tape<T>::read() const {
     return v[pos];
 }
 
-std::optional<int> vector_tape::read_safe() const {
+template <tape_element T>
+std::optional<T> typed_vector_tape<T>::read_safe() const {
     if (!empty.empty() && empty[pos]) {
         return {};
     }
     return v[pos];
 }
 
-void vector_tape::write(int data) {
+template <tape_element T>
+void typed_vector_tape<T>::write(T data) {
     v[pos] = data;
     if (!empty.empty()) {
         empty[pos] = false;
     }
 }
 
-bool vector_tape::move_left() const {
+template <tape_element T>
+bool typed_vector_tape<T>::move_left() const {
     if (pos) {
         pos--;
         return true;
@@ -39,7 +47,8 @@ bool vector_tape::move_left() const {
     return false;
 }
 
-bool vector_tape::move_right() const {
+template <tape_element T>
+bool typed_vector_tape<T>::move_right() const {
     if (pos + 1 < v.size()) {
         pos++;
         return true;
@@ -47,6 +56,72 @@ bool vector_tape::move_right() const {
     return false;
 }
 
-void vector_tape::rewind() const {
+template <tape_element T>
+void typed_vector_tape<T>::rewind() const {
     pos = 0;
 }
+
+template <tape_element T>
+size_t typed_vector_tape<T>::available(size_t n, direction dir) const {
+    return std::min(n, dir == direction::right ? v.size() - pos : pos + 1);
+}
+
+template <tape_element T>
+size_t typed_vector_tape<T>::read_n(std::span<T> out, direction dir) const {
+    auto n = available(out.size(), dir);
+    if (n == 0) {
+        return 0;
+    }
+    if (dir == direction::right) {
+        std::copy_n(v.begin() + static_cast<std::ptrdiff_t>(pos), n, out.begin());
+        pos += n - 1;
+    } else {
+        std::copy_n(v.rbegin() + static_cast<std::ptrdiff_t>(v.size() - 1 - pos), n, out.begin());
+        pos -= n - 1;
+    }
+    return n;
+}
+
+template <tape_element T>
+size_t typed_vector_tape<T>::read_safe_n(std::span<std::optional<T>> out, direction dir) const {
+    auto n = available(out.size(), dir);
+    for (size_t i = 0; i < n; ++i) {
+        out[i] = read_safe();
+        if (i + 1 < n) {
+            dir == direction::right ? pos++ : pos--;
+        }
+    }
+    return n;
+}
+
+template <tape_element T>
+size_t typed_vector_tape<T>::write_n(std::span<T const> data, direction dir) {
+    auto n = available(data.size(), dir);
+    if (n == 0) {
+        return 0;
+    }
+    if (dir == direction::right) {
+        std::copy_n(data.begin(), n, v.begin() + static_cast<std::ptrdiff_t>(pos));
+        if (!empty.empty()) {
+            std::fill_n(empty.begin() + static_cast<std::ptrdiff_t>(pos), n, false);
+        }
+        pos += n - 1;
+    } else {
+        std::copy_n(data.begin(), n, v.rbegin() + static_cast<std::ptrdiff_t>(v.size() - 1 - pos));
+        pos -= n - 1;
+        if (!empty.empty()) {
+            std::fill_n(empty.begin() + static_cast<std::ptrdiff_t>(pos), n, false);
+        }
+    }
+    return n;
+}
+
+template <tape_element T>
+size_t typed_vector_tape<T>::move_n(size_t n, direction dir) const {
+    auto moved = std::min(n, dir == direction::right ? v.size() - 1 - pos : pos);
+    dir == direction::right ? pos += moved : pos -= moved;
+    return moved;
+}
+
+#define INSTANTIATE_VECTOR_TAPE(T) template class typed_vector_tape<T>;
+FOR_EACH_TAPE_ELEMENT(INSTANTIATE_VECTOR_TAPE)
@@ -4,26 +4,46 @@
 #include "basic_tape.h"
 #include <vector>
 
-class vector_tape : public basic_tape {
+/**
+ * Tape which stores its elements in RAM.
+ */
+template <tape_element T>
+class typed_vector_tape : public typed_tape<T> {
 public:
-    explicit vector_tape(size_t size);
-    explicit vector_tape(std::vector<int> content);
+    explicit typed_vector_tape(size_t size);
+    explicit typed_vector_tape(std::vector<T> content);
 
-    int read() const override;
-    std::optional<int> read_safe() const override;
+    T read() const override;
+    std::optional<T> read_safe() const override;
 
-    void write(int data) override;
+    void write(T data) override;
 
     bool move_left() const override;
     bool move_right() const override;
 
     void rewind() const override;
 
+    size_t read_n(std::span<T> out, direction dir) const override;
+    size_t read_safe_n(std::span<std::optional<T>> out, direction dir) const override;
+    size_t write_n(std::span<T const> data, direction dir) override;
+    size_t move_n(size_t n, direction dir) const override;
+
 private:
-    mutable std::vector<int> v;
+    /**
+     * @return number of elements which can be accessed by a bulk operation of `n` elements starting from the head
+     */
+    size_t available(size_t n, direction dir) const;
+
+    mutable std::vector<T> v;
     mutable std::vector<bool> empty;
     mutable size_t pos = 0;
 };
 
+#define YADRO_TATLIN_TEST_TASK_EXTERN_VECTOR_TAPE(T) extern template class typed_vector_tape<T>;
+FOR_EACH_TAPE_ELEMENT(YADRO_TATLIN_TEST_TASK_EXTERN_VECTOR_TAPE)
+#undef YADRO_TATLIN_TEST_TASK_EXTERN_VECTOR_TAPE
+
+using vector_tape = typed_vector_tape<int>;
+
 
 #endif //YADRO_TATLIN_TEST_TASK_VECTOR_TAPE_H